@@ -5,6 +5,7 @@
 #include <WiFiUdp.h>
 #include "EGR425_Phase1_weather_bitmap_images.h"
 #include "WiFi.h"
+#include "../include/Scheduler.h"
 
 ////////////////////////////////////////////////////////////////////
 // Variables
@@ -19,8 +20,12 @@ String wifiPassword = "";
 
 
 // Time variables
-unsigned long lastTime = 0;
 unsigned long timerDelay = 5000; // 5000; 5 minutes (300,000ms) or 5 seconds (5,000ms)
+const unsigned long inputPollMs = 20;
+
+// loop() work runs as scheduled tasks
+Scheduler scheduler;
+int weatherTask;
 
 // LCD variables
 int sWidth;
@@ -83,6 +88,8 @@ void drawWeatherDisplay();
 void drawZipCodeDisplay();
 void drawFetchingDisplay();
 int splitName(String name);
+void refreshWeather();
+void pollInput();
 
 ///////////////////////////////////////////////////////////////
 // Put your setup code here, to run once
@@ -123,6 +130,11 @@ void setup()
 
     // timestamp
     timeClient.begin();
+
+    // fetch now, then every timerDelay; WiFi stays up, so no light sleep
+    scheduler.after(0, refreshWeather);
+    weatherTask = scheduler.every(timerDelay, refreshWeather);
+    scheduler.every(inputPollMs, pollInput);
 }
 
 ///////////////////////////////////////////////////////////////
@@ -130,32 +142,39 @@ void setup()
 ///////////////////////////////////////////////////////////////
 void loop()
 {
-    M5.update();
+    scheduler.run();
+}
 
-    // Only execute every so often
-    if ((millis() - lastTime) > timerDelay)
+///////////////////////////////////////////////////////////////
+// Every timerDelay: fetch the weather and update the time stamp
+///////////////////////////////////////////////////////////////
+void refreshWeather()
+{
+    if (WiFi.status() == WL_CONNECTED)
     {
-        if (WiFi.status() == WL_CONNECTED)
-        {
 
-            // timestamp updating
-            timeStampProcessing();
+        // timestamp updating
+        timeStampProcessing();
 
-            // get weather details, and update the screen
-            fetchWeatherDetails();
-            if (screen == S_WEATHER)
-            {
-                drawWeatherDisplay();
-            }
-        }
-        else
+        // get weather details, and update the screen
+        fetchWeatherDetails();
+        if (screen == S_WEATHER)
         {
-            Serial.println("WiFi Disconnected");
+            drawWeatherDisplay();
         }
-
-        // Update the last time to NOW
-        lastTime = millis();
     }
+    else
+    {
+        Serial.println("WiFi Disconnected");
+    }
+}
+
+///////////////////////////////////////////////////////////////
+// Every inputPollMs: buttons and touch
+///////////////////////////////////////////////////////////////
+void pollInput()
+{
+    M5.update();
 
     if (screen == S_LOADING)
     {
@@ -332,7 +351,7 @@ void fetchWeatherDetails()
     if (screen == S_LOADING)
     {
         drawWeatherDisplay();
-        lastTime = millis();
+        scheduler.postpone(weatherTask, timerDelay);
         screen = S_WEATHER;
     }
 }
@@ -0,0 +1,86 @@
+#include "../include/TextField.h"
+#include "../include/GlyphCache.h"
+
+//////////////////////////////////////////////////////////////////////
+// Creates a field at the given position. Nothing is drawn until the
+// first call to update().
+//////////////////////////////////////////////////////////////////////
+TextField::TextField(int x, int y, uint8_t textSize, uint16_t color, uint16_t bgColor, BackgroundSampler sampler)
+    : x(x), y(y), textSize(textSize), color(color), bgColor(bgColor), sampler(sampler), shownLen(0), valid(false)
+{
+    shown[0] = '\0';
+}
+
+void TextField::setPosition(int newX, int newY)
+{
+    if (newX != x || newY != y)
+    {
+        x = newX;
+        y = newY;
+        invalidate();
+    }
+}
+
+void TextField::setColors(uint16_t newColor, uint16_t newBgColor)
+{
+    if (newColor != color || newBgColor != bgColor)
+    {
+        color = newColor;
+        bgColor = newBgColor;
+        invalidate();
+    }
+}
+
+void TextField::invalidate()
+{
+    valid = false;
+    shownLen = 0;
+    shown[0] = '\0';
+}
+
+//////////////////////////////////////////////////////////////////////
+// Compares the new text against what is on screen one character cell
+// at a time (the GLCD font is fixed width, so cell i is always at the
+// same x). Only cells whose character changed are repainted; cells
+// past the end of a shorter string are cleared.
+//////////////////////////////////////////////////////////////////////
+int TextField::update(const char *text)
+{
+    int newLen = strnlen(text, MAX_CHARS);
+    int maxLen = newLen > shownLen ? newLen : shownLen;
+    int cellsPainted = 0;
+
+    for (int i = 0; i < maxLen; i++)
+    {
+        if (i < newLen)
+        {
+            if (!valid || i >= shownLen || shown[i] != text[i])
+            {
+                drawCell(i, text[i]);
+                cellsPainted++;
+            }
+        }
+        else
+        {
+            clearCell(i);
+            cellsPainted++;
+        }
+    }
+
+    memcpy(shown, text, newLen);
+    shown[newLen] = '\0';
+    shownLen = newLen;
+    valid = true;
+
+    return cellsPainted * glyphWidth() * glyphHeight();
+}
+
+void TextField::clearCell(int index)
+{
+    GlyphCache::blit(x + index * glyphWidth(), y, nullptr, textSize, color, bgColor, sampler);
+}
+
+void TextField::drawCell(int index, char c)
+{
+    GlyphCache::drawChar(x + index * glyphWidth(), y, c, textSize, color, bgColor, sampler);
+}
@@ -6,6 +6,8 @@
 #include "WiFi.h"
 #include "EGR425_Phase1_weather_bitmap_images.h"
 #include "../include/I2C_RW.h"
+#include "../include/TextField.h"
+#include "../include/Scheduler.h"
 
 ////////////////////////////////////////////////////////////////////
 // Variables
@@ -20,8 +22,13 @@ String wifiNetworkName = "CBU-LancerArmsWest";
 String wifiPassword = "";
 
 // Time variables
-unsigned long lastTime = 0;
 unsigned long timerDelay = 5000; // 5000; 5 minutes (300,000ms) or 5 seconds (5,000ms)
+const unsigned long inputPollMs = 20;
+const unsigned long screenLightMs = 200;
+
+// loop() work runs as scheduled tasks
+Scheduler scheduler;
+int weatherTask;
 
 // LCD variables
 int sWidth;
@@ -70,6 +77,21 @@ float newSensorHum;
 bool redrawAPI;
 bool redrawSensor;
 
+// on-screen text fields that only repaint the glyphs that changed
+uint16_t weatherBackgroundAt(int x, int y);
+TextField tempLoField(0, 0, 3, TFT_BLUE, TFT_CYAN, weatherBackgroundAt);
+TextField tempNowField(0, 0, 10, TFT_DARKGREY, TFT_CYAN, weatherBackgroundAt);
+TextField tempHiField(0, 0, 3, TFT_RED, TFT_CYAN, weatherBackgroundAt);
+TextField weatherUpdatedField(0, 0, 2, TFT_BLACK, TFT_CYAN, weatherBackgroundAt);
+TextField sensorTempField(0, 0, 4, TFT_PINK, TFT_BLACK);
+TextField sensorHumField(0, 0, 4, TFT_ORANGE, TFT_BLACK);
+TextField sensorUpdatedField(0, 0, 2, TFT_DARKGREY, TFT_BLACK);
+
+// what the weather screen was last fully drawn with
+String shownWeatherIcon;
+String shownCityName;
+const uint16_t *shownWeatherBitmap;
+
 // mode variable
 enum Unit
 {
@@ -117,11 +139,16 @@ double toCelcius(double kelvinTemp);
 void drawWeatherImage(String iconId, int resizeMult);
 void fetchWeatherDetails();
 void drawWeatherDisplay();
+void updateWeatherDisplay();
 void drawZipCodeDisplay();
 void drawFetchingDisplay();
 void drawSensorDisplay();
+void updateSensorDisplay();
 int splitName(String name);
 void readSht40Data();
+void refreshWeather();
+void adjustScreenLight();
+void pollInput();
 
 ///////////////////////////////////////////////////////////////
 // Put your setup code here, to run once
@@ -170,6 +197,12 @@ void setup()
 
     I2C_RW::writeReg8Addr16DataWithProof(vcnlRegPsConfig, 2, 0x0800, " proximity sensor", true);
     I2C_RW::writeReg8Addr16DataWithProof(vcnlRegAlsConfig, 2, 0x0000, " ambient light sensor", true);
+
+    // fetch now, then every timerDelay; WiFi stays up, so no light sleep
+    scheduler.after(0, refreshWeather);
+    weatherTask = scheduler.every(timerDelay, refreshWeather);
+    scheduler.every(screenLightMs, adjustScreenLight);
+    scheduler.every(inputPollMs, pollInput);
 }
 
 ///////////////////////////////////////////////////////////////
@@ -177,48 +210,53 @@ void setup()
 ///////////////////////////////////////////////////////////////
 void loop()
 {
-    M5.update();
+    scheduler.run();
+}
 
-    // Only execute every so often
-    if ((millis() - lastTime) > timerDelay)
+///////////////////////////////////////////////////////////////
+// Every timerDelay: fetch the weather and read the SHT40
+///////////////////////////////////////////////////////////////
+void refreshWeather()
+{
+    // API things (aka S_WEATHER)
+    if (WiFi.status() == WL_CONNECTED)
     {
-        // API things (aka S_WEATHER)
-        if (WiFi.status() == WL_CONNECTED)
-        {
-            // timestamp updating
-            timeStampProcessing();
+        // timestamp updating
+        timeStampProcessing();
 
-            // get weather details, and update the screen
-            fetchWeatherDetails();
-            if (screen == S_WEATHER && redrawAPI)
-            {
-                // the API values have changed so update them!
-                drawWeatherDisplay();
-            }
-        }
-        else
+        // get weather details, and update the screen
+        fetchWeatherDetails();
+        if (screen == S_WEATHER && redrawAPI)
         {
-            Serial.println("WiFi Disconnected");
+            // the API values have changed so update them!
+            updateWeatherDisplay();
         }
+    }
+    else
+    {
+        Serial.println("WiFi Disconnected");
+    }
 
-        // Sensor things (aka S_SENSOR)
-        readSht40Data(); // check local sensor readings
+    // Sensor things (aka S_SENSOR)
+    readSht40Data(); // check local sensor readings
 
-        if (screen == S_SENSOR && redrawSensor)
-        {
-            // the sensor values have changed so update them!
-            drawSensorDisplay();
-        }
-
-        // Update the last time to NOW
-        lastTime = millis();
+    if (screen == S_SENSOR && redrawSensor)
+    {
+        // the sensor values have changed so update them!
+        updateSensorDisplay();
     }
+}
 
+///////////////////////////////////////////////////////////////
+// Every screenLightMs: screen off when something is close, and
+// backlight from the ambient light
+///////////////////////////////////////////////////////////////
+void adjustScreenLight()
+{
     if (screen == S_LOADING)
     {
         return;
     }
-    // anything below here will not be executed if loading
 
     // checking if the VCNL4040 sensor is too close to an object (proximity)
     u16_t proxData = I2C_RW::readReg8Addr16Data(vcnlRegProx, 2, " to get proximity", false);
@@ -244,7 +282,20 @@ void loop()
     long screenVoltage = ((highScreenVolt - lowScreenVolt) * 1.0 / (highAmbientLight - lowAmbientLight) * 1.0) * 1.0 * ambientData + lowScreenVolt;
     Serial.printf("\tSetLcdVoltage: %d \t\t ambient data: %d \n", screenVoltage, ambientData);
     M5.Axp.SetLcdVoltage(screenVoltage);
+}
 
+///////////////////////////////////////////////////////////////
+// Every inputPollMs: buttons and touch
+///////////////////////////////////////////////////////////////
+void pollInput()
+{
+    M5.update();
+
+    if (screen == S_LOADING)
+    {
+        return;
+    }
+    // anything below here will not be executed if loading
 
     // M5 buttons
     if (M5.BtnA.wasPressed())   
@@ -255,11 +306,11 @@ void loop()
         // update the screen with the new units
         if (screen == S_WEATHER)
         {
-            drawWeatherDisplay();
+            updateWeatherDisplay();
         }
         else if (screen == S_SENSOR)
         {
-            drawSensorDisplay();
+            updateSensorDisplay();
         }
     }
 
@@ -449,7 +500,7 @@ void fetchWeatherDetails()
     if (screen == S_LOADING)
     {
         drawWeatherDisplay();
-        lastTime = millis();
+        scheduler.postpone(weatherTask, timerDelay);
         screen = S_WEATHER;
     }
 }
@@ -481,17 +532,20 @@ void drawWeatherDisplay()
     //////////////////////////////////////////////////////////////////
     // Draw background - light blue if day time and navy blue of night
     //////////////////////////////////////////////////////////////////
+    bool isDay = strWeatherIcon.indexOf("d") >= 0;
     uint16_t primaryTextColor;
-    if (strWeatherIcon.indexOf("d") >= 0)
+    uint16_t backgroundColor;
+    if (isDay)
     {
-        M5.Lcd.fillScreen(TFT_CYAN);
+        backgroundColor = TFT_CYAN;
         primaryTextColor = TFT_BLACK;
     }
     else
     {
-        M5.Lcd.fillScreen(TFT_NAVY);
+        backgroundColor = TFT_NAVY;
         primaryTextColor = TFT_LIGHTGREY;
     }
+    M5.Lcd.fillScreen(backgroundColor);
 
     //////////////////////////////////////////////////////////////////
     // Draw the icon on the right side of the screen - the built in
@@ -500,11 +554,71 @@ void drawWeatherDisplay()
     //////////////////////////////////////////////////////////////////
     // M5.Lcd.drawBitmap(0, 0, 100, 100, myBitmap, TFT_BLACK);
     drawWeatherImage(strWeatherIcon, 2);
+    shownWeatherIcon = strWeatherIcon;
+    shownWeatherBitmap = getWeatherBitmap(strWeatherIcon);
+    shownCityName = cityName;
 
     //////////////////////////////////////////////////////////////////
-    // Draw the temperatures and city name
+    // Lay out the temperature fields (LO, now, HI stacked on top of
+    // each other); their text is drawn by updateWeatherDisplay()
     //////////////////////////////////////////////////////////////////
     int pad = 10;
+    tempLoField.setPosition(pad, pad);
+    tempLoField.setColors(isDay ? TFT_BLUE : TFT_CYAN, backgroundColor);
+    tempLoField.invalidate();
+
+    tempNowField.setPosition(pad, tempLoField.getY() + tempLoField.height());
+    tempNowField.setColors(isDay ? TFT_DARKGREY : TFT_YELLOW, backgroundColor);
+    tempNowField.invalidate();
+
+    tempHiField.setPosition(pad, tempNowField.getY() + tempNowField.height());
+    tempHiField.setColors(TFT_RED, backgroundColor);
+    tempHiField.invalidate();
+
+    //////////////////////////////////////////////////////////////////
+    // Draw the city name (static until the zip code changes)
+    //////////////////////////////////////////////////////////////////
+    M5.Lcd.setCursor(pad, tempHiField.getY() + tempHiField.height());
+    M5.Lcd.setTextColor(primaryTextColor);
+    M5.Lcd.setTextSize(3);
+
+    String tempName = cityName;
+    int spaceIndex;
+    while (tempName.length() >= 15)
+    {
+        spaceIndex = splitName(tempName);
+        M5.Lcd.printf("%s\n", tempName.substring(0, spaceIndex).c_str());
+        M5.Lcd.setCursor(pad, M5.Lcd.getCursorY());
+
+        tempName = tempName.substring(spaceIndex + 1);
+    }
+
+    M5.Lcd.printf("%s\n", tempName.c_str());
+
+    M5.Lcd.setCursor(pad, M5.Lcd.getCursorY());
+    M5.Lcd.setTextColor(primaryTextColor);
+    M5.Lcd.setTextSize(2);
+    M5.Lcd.print("Last updated:\n");
+    weatherUpdatedField.setPosition(0, M5.Lcd.getCursorY());
+    weatherUpdatedField.setColors(primaryTextColor, backgroundColor);
+    weatherUpdatedField.invalidate();
+
+    updateWeatherDisplay();
+}
+
+/////////////////////////////////////////////////////////////////
+// Refresh the temperatures and timestamp on the weather screen.
+// Only the glyphs that changed are repainted; if the icon or city
+// changed since the last full draw, the whole screen is redrawn.
+/////////////////////////////////////////////////////////////////
+void updateWeatherDisplay()
+{
+    if (strWeatherIcon != shownWeatherIcon || cityName != shownCityName)
+    {
+        drawWeatherDisplay();
+        return;
+    }
+
     // displaying variables
     char units = 'F';
     double tMin = tempMin;
@@ -526,56 +640,40 @@ void drawWeatherDisplay()
         tNow = toCelcius(tempNow);
     }
 
-    M5.Lcd.setCursor(pad, pad);
-    if (strWeatherIcon.indexOf("d") >= 0)
-    {
-        M5.Lcd.setTextColor(TFT_BLUE);
-    }
-    else
-    {
-        M5.Lcd.setTextColor(TFT_CYAN);
-    }
+    char text[TextField::MAX_CHARS + 1];
+    snprintf(text, sizeof(text), "LO:%0.f%c", tMin, units);
+    tempLoField.update(text);
 
-    M5.Lcd.setTextSize(3);
-    M5.Lcd.printf("LO:%0.f%c\n", tMin, units);
+    snprintf(text, sizeof(text), "%0.f%c", tNow, units);
+    tempNowField.update(text);
 
-    M5.Lcd.setCursor(pad, M5.Lcd.getCursorY());
-    if (strWeatherIcon.indexOf("d") >= 0)
-    {
-        M5.Lcd.setTextColor(TFT_DARKGREY);
-    }
-    else
-    {
-        M5.Lcd.setTextColor(TFT_YELLOW);
-    }
-    M5.Lcd.setTextSize(10);
-    M5.Lcd.printf("%0.f%c\n", tNow, units);
+    snprintf(text, sizeof(text), "HI:%0.f%c", tMax, units);
+    tempHiField.update(text);
 
-    M5.Lcd.setCursor(pad, M5.Lcd.getCursorY());
-    M5.Lcd.setTextColor(TFT_RED);
-    M5.Lcd.setTextSize(3);
-    M5.Lcd.printf("HI:%0.f%c\n", tMax, units);
+    snprintf(text, sizeof(text), " %02d:%02d:%02d %s", hours, minutes, seconds, amPm.c_str());
+    weatherUpdatedField.update(text);
+}
 
-    M5.Lcd.setCursor(pad, M5.Lcd.getCursorY());
-    M5.Lcd.setTextColor(primaryTextColor);
+/////////////////////////////////////////////////////////////////
+// Returns the color of the weather screen at (x, y): the weather
+// icon pixel if there is one there, otherwise the day/night
+// background. Text fields blend their glyphs against this.
+/////////////////////////////////////////////////////////////////
+uint16_t weatherBackgroundAt(int x, int y)
+{
+    int resizeMult = 2;
+    int yOffset = (-(resizeMult * imgSqDim - M5.Lcd.height()) / 2) - 60;
+    int xOffset = sWidth - (imgSqDim * resizeMult * .8) - 20;
 
-    String tempName = cityName;
-    int spaceIndex;
-    while (tempName.length() >= 15)
+    int imgX = x - xOffset;
+    int imgY = y - yOffset;
+    if (imgX >= 0 && imgY >= 0 && imgX < imgSqDim * resizeMult && imgY < imgSqDim * resizeMult)
     {
-        spaceIndex = splitName(tempName);
-        M5.Lcd.printf("%s\n", tempName.substring(0, spaceIndex).c_str());
-        M5.Lcd.setCursor(pad, M5.Lcd.getCursorY());
-
-        tempName = tempName.substring(spaceIndex + 1);
+        uint16_t pixel = shownWeatherBitmap[(imgY / resizeMult) * imgSqDim + (imgX / resizeMult)];
+        if (pixel != 0)
+            return pixel;
     }
-
-    M5.Lcd.printf("%s\n", tempName.c_str());
-
-    M5.Lcd.setCursor(pad, M5.Lcd.getCursorY());
-    M5.Lcd.setTextColor(primaryTextColor);
-    M5.Lcd.setTextSize(2);
-    M5.Lcd.printf("Last updated:\n %02d:%02d:%02d %s\n", hours, minutes, seconds, amPm);
+    return shownWeatherIcon.indexOf("d") >= 0 ? TFT_CYAN : TFT_NAVY;
 }
 
 int splitName(String name)
@@ -652,19 +750,6 @@ void drawFetchingDisplay()
 void drawSensorDisplay()
 {
     int pad = 10;
-    char units;
-    float sensorT;
-
-    if (unit == U_FAHRENHEIT)
-    {
-        units = 'F';
-        sensorT = toFahrenheit(sensorTemp);
-    }
-    else if (unit == U_CELSIUS)
-    {
-        units = 'C';
-        sensorT = toCelcius(sensorTemp);
-    }
 
     M5.Lcd.fillScreen(TFT_BLACK);
     M5.Lcd.setTextColor(TFT_WHITE);
@@ -674,27 +759,55 @@ void drawSensorDisplay()
     M5.Lcd.print("Live Local Readings:\n");
     M5.Lcd.setCursor(pad, M5.Lcd.getCursorY() + 30);
 
+    // the readings go right after their labels
     M5.Lcd.setTextSize(3);
     M5.Lcd.print("Temperature:");
+    sensorTempField.setPosition(M5.Lcd.getCursorX(), M5.Lcd.getCursorY());
+    sensorTempField.invalidate();
 
-    M5.Lcd.setTextColor(TFT_PINK);
-    M5.Lcd.setTextSize(4);
-    M5.Lcd.printf("%0.f%c\n", sensorT, units);
-
-    M5.Lcd.setCursor(pad, M5.Lcd.getCursorY() + 40);
+    M5.Lcd.setCursor(pad, sensorTempField.getY() + sensorTempField.height() + 40);
 
     M5.Lcd.setTextColor(TFT_WHITE);
     M5.Lcd.setTextSize(3);
     M5.Lcd.print("Humidity:");
+    sensorHumField.setPosition(M5.Lcd.getCursorX(), M5.Lcd.getCursorY());
+    sensorHumField.invalidate();
 
-    M5.Lcd.setTextColor(TFT_ORANGE);
-    M5.Lcd.setTextSize(4);
-    M5.Lcd.printf("%0.f%%", sensorHum);
+    sensorUpdatedField.setPosition(pad, sHeight - 20);
+    sensorUpdatedField.invalidate();
 
-    M5.Lcd.setCursor(pad, sHeight - 20);
-    M5.Lcd.setTextColor(TFT_DARKGREY);
-    M5.Lcd.setTextSize(2);
-    M5.Lcd.printf("Last updated: %02d:%02d:%02d %s", hours, minutes, seconds, amPm);
+    updateSensorDisplay();
+}
+
+/////////////////////////////////////////////////////////////////
+// Refresh the readings on the sensor screen, repainting only the
+// glyphs that changed.
+/////////////////////////////////////////////////////////////////
+void updateSensorDisplay()
+{
+    char units;
+    float sensorT;
+
+    if (unit == U_FAHRENHEIT)
+    {
+        units = 'F';
+        sensorT = toFahrenheit(sensorTemp);
+    }
+    else if (unit == U_CELSIUS)
+    {
+        units = 'C';
+        sensorT = toCelcius(sensorTemp);
+    }
+
+    char text[TextField::MAX_CHARS + 1];
+    snprintf(text, sizeof(text), "%0.f%c", sensorT, units);
+    sensorTempField.update(text);
+
+    snprintf(text, sizeof(text), "%0.f%%", sensorHum);
+    sensorHumField.update(text);
+
+    snprintf(text, sizeof(text), "Last updated: %02d:%02d:%02d %s", hours, minutes, seconds, amPm.c_str());
+    sensorUpdatedField.update(text);
 }
 
 /////////////////////////////////////////////////////////////////
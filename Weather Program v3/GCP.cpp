@@ -1,5 +1,4 @@
 #include <M5Core2.h>
-#include <ArduinoJson.h>
 #include <HTTPClient.h>
 #include "WiFi.h"
 #include "FS.h"                 // SD Card ESP32
@@ -8,6 +7,15 @@
 #include <WiFiUdp.h>            // Time Protocol Libraries
 #include <Adafruit_VCNL4040.h>  // Sensor libraries
 #include "Adafruit_SHT4x.h"     // Sensor libraries
+#include "../include/GlyphCache.h"  // anti-aliased digits
+#include "../include/ImuFifo.h"     // batched accelerometer samples
+#include "../include/Scheduler.h"   // loop() tasks
+#include "../include/HalNet.h"      // HTTP requests
+#include "../include/TelemetryBuffer.h" // samples waiting for upload
+#include "../include/CloudProtocol.h"  // requests to the cloud functions
+#include "../include/FlashLog.h"     // samples kept while offline
+#include "../include/HttpWorker.h"   // average requests in the background
+#include "../include/AverageResult.h" // ...parsed as they stream in
 
 // Firestore URL addresses
 const String URL_GCF_UPLOAD = "https://us-west2-egr-425-380621.cloudfunctions.net/upload";
@@ -25,26 +33,67 @@ WiFiUDP ntpUDP;
 NTPClient timeClient(ntpUDP);
 
 // Time variables
-unsigned long lastTime = 0;
-unsigned long timerDelayMs = 5000; 
-
-// Cloud Function Response Variable
-static String jsonAverageResponse;
-
-// Device Details Structure
-struct deviceDetails {
-    int prox;
-    int ambientLight;
-    int whiteLight;
-    double rHum;
-    double temp;
-    double accX;
-    double accY;
-    double accZ;
+unsigned long sampleDelayMs = 1000;   // read the sensors
+unsigned long screenDelayMs = 5000;   // refresh the upload screen
+const unsigned long inputPollMs = 20;
+
+// loop() work runs as scheduled tasks
+Scheduler scheduler;
+enum AppEvent
+{
+    EVENT_AVERAGE_DONE
 };
 
+// Accelerometer: 50 Hz samples from the IMU FIFO, averaged over each
+// upload period
+ImuFifo imuFifo;
+bool imuFifoRunning = false;
+const uint16_t imuSampleHz = 50;
+const uint8_t imuWatermark = 25; // drain twice a second
+int32_t accSum[3] = {0, 0, 0};
+int accSamples = 0;
+
+// Cloud Function Response Variable: the average answer is parsed
+// straight off the socket into averageResult, no text is kept
+AverageResultParser averageParser;
+static AverageResult averageResult;
+
+// Average requests run in their own task, so sampling and uploads go
+// on during the round trip; the waiting screen spins until the
+// answer's event comes in (or BtnA cancels it)
+HttpWorker averageRequest(scheduler, EVENT_AVERAGE_DONE);
+const unsigned long spinnerMs = 100;
+int spinnerTask = Scheduler::NO_TASK;
+int spinnerFrame = 0;
+
+// Device Details Structure: deviceDetails, in CloudProtocol.h
+
 // Device variables
 static deviceDetails thisDeviceDetails;
+
+// Telemetry: samples are buffered and uploaded together once there
+// are batchMaxSamples of them or the oldest is batchMaxAgeMs old
+const int batchMaxSamples = 30;
+const unsigned long batchMaxAgeMs = 30000;
+const int telemetryCapacity = 120;
+TelemetryBuffer<deviceDetails, telemetryCapacity> telemetry;
+static TelemetrySample uploadBatch[batchMaxSamples];
+
+// Batches that can't be uploaded go to the "telemetry" flash
+// partition (partitions.csv) and are sent from there once the link
+// is back, so a WiFi outage or a reset doesn't lose them
+HalFlash telemetryFlash;
+FlashLog<TelemetrySample> telemetryLog(telemetryFlash);
+bool telemetryLogReady = false;
+const unsigned long logDrainMs = 2000;
+const unsigned long logDrainMaxMs = 60000; // backoff while the function is down
+unsigned long logDrainPeriodMs = logDrainMs;
+int logDrainTask;
+
+// Batches the upload function turned down (a 4xx): sending them again
+// won't help, so they are dropped instead of blocking the ones after
+unsigned long rejectedBatches = 0;
+unsigned long rejectedSamples = 0;
 static String userId = "raz"; // TODO update
 
 // Sreen variables
@@ -76,25 +125,35 @@ int sHeight;
 ////////////////////////////////////////////////////////////////////
 // Method header declarations
 ////////////////////////////////////////////////////////////////////
-int httpGetWithHeaders(String serverURL, String *headerKeys, String *headerVals, int numHeaders);
-bool gcfGetWithHeader(String serverUrl, String userId, time_t time, deviceDetails *details);
-String generateM5DetailsHeader(String userId, time_t time, deviceDetails *details);
+int gcfPostBatch(String serverUrl, String userId, const TelemetrySample *samples, int numSamples);
+bool batchRejected(int resCode);
+void countRejectedBatch(int resCode, int numSamples);
 bool gcfGetWithReqHeader(String serverUrl, String userId, int duration, String dataType);
-String generateReqDetailsHeader(String userId, int duration, String dataType);
 double convertFintoC(double f);
 double convertCintoF(double c);
 void drawUploadDisplay(deviceDetails details, String userId);
 void drawFetchDisplay();
 void drawWaitingResultsDisplay();
-void drawResultsDisplay();
+void drawSpinner();
+void drawRequestFailed(int resCode);
+void drawResultsDisplay(const AverageResult &result);
 void drawSelectionBox(int row, int column);
 void drawIntroScreen();
+void collectImuSamples();
+void pollInput();
+void takeSample();
+void uploadTelemetry();
+void drainTelemetryLog();
+void refreshUploadScreen();
+void showAverageResponse();
+void stopSpinner();
 
 void setup()
 {
     // Initialize the device
     M5.begin();
     M5.IMU.Init();
+    imuFifoRunning = imuFifo.begin(imuSampleHz, imuWatermark);
     
     // Set screen orientation and get height/width
     sWidth = M5.Lcd.width();
@@ -128,9 +187,6 @@ void setup()
     selectedDataType = "";
     selectedAction = "";
 
-    // Initialize Cloud Function Variable
-    jsonAverageResponse = "";
-
     // Connect to WiFi
     WiFi.begin(wifiNetworkName.c_str(), wifiPassword.c_str());
     Serial.printf("Connecting");
@@ -145,10 +201,39 @@ void setup()
     // Init time connection
     timeClient.begin();
     timeClient.setTimeOffset(0);   
+
+    // Offline log in flash
+    telemetryLogReady = telemetryFlash.begin("telemetry") && telemetryLog.begin();
+    if (telemetryLogReady) {
+        Serial.printf("Telemetry log: %d samples waiting\n", telemetryLog.pending());
+    } else {
+        Serial.println("No telemetry partition, samples are only buffered in RAM");
+    }
+
+    // WiFi stays up, so no light sleep; the FIFO is drained at its
+    // watermark, sensors are read every sampleDelayMs and uploaded in
+    // batches, and the offline log is drained in the background
+    scheduler.every(inputPollMs, pollInput);
+    scheduler.every(1000UL * imuWatermark / imuSampleHz, collectImuSamples);
+    scheduler.every(sampleDelayMs, takeSample);
+    scheduler.every(screenDelayMs, refreshUploadScreen);
+    logDrainTask = scheduler.every(logDrainMs, drainTelemetryLog);
+    scheduler.onEvent(EVENT_AVERAGE_DONE, showAverageResponse);
+    if (!averageRequest.begin("average")) {
+        Serial.println("Could not start the average request task");
+    }
 }
 
 
 void loop()
+{
+    scheduler.run();
+}
+
+////////////////////////////////////////////////////////////////////
+// Every inputPollMs: buttons and screen changes
+////////////////////////////////////////////////////////////////////
+void pollInput()
 {
     M5.update();
 
@@ -221,208 +306,277 @@ void loop()
                 drawWaitingResultsDisplay();
                 screen = S_WAITING;
                 
-                // get the average data from Firestore w selected values
-                jsonAverageResponse = ""; // clear the old average response data
-                gcfGetWithReqHeader(URL_GFC_AVERAGE, selectedUserId, selectedTimeDurationOption, selectedDataType); 
+                // get the average data from Firestore w selected values;
+                // the answer comes back as EVENT_AVERAGE_DONE
+                if (gcfGetWithReqHeader(URL_GFC_AVERAGE, selectedUserId, selectedTimeDurationOption, selectedDataType)) {
+                    spinnerFrame = 0;
+                    spinnerTask = scheduler.every(spinnerMs, drawSpinner);
+                } else {
+                    drawRequestFailed(0);
+                    screen = S_RESULTS;
+                }
                 selectedUserId = "";
                 selectedTimeDurationOption = -1;
                 selectedDataType = ""; 
             }
         }
     } else if (screen == S_WAITING) {
-        if (jsonAverageResponse != "") {
-            // there is now data in the response JSON
-            drawResultsDisplay();
-            screen = S_RESULTS;
+        if (M5.BtnA.wasPressed()) {
+            // cancel: the answer is dropped whenever it comes
+            averageRequest.cancel();
+            stopSpinner();
+            M5.Lcd.clear(TFT_BLACK);
+            drawFetchDisplay();
+            screen = S_FETCH;
         }
     } else if (screen == S_RESULTS) {
         if (M5.BtnA.wasPressed()) { 
             drawUploadDisplay(thisDeviceDetails, userId);
             screen = S_UPLOAD;
         }
-    }   
-
-    // read and send the device's measured values to Firestore every 5 seconds if connected to wifi
-    if (((millis() - lastTime) > timerDelayMs)) {
-        // refresh the screen
-        if (screen == S_UPLOAD) {
-            drawUploadDisplay(thisDeviceDetails, userId);
-        }
-        // Delay: Update the last time to NOW
-        lastTime = millis();
-
-        // Read Sensor Values
-        // Read VCNL4040 Sensors
-        uint16_t prox = vcnl4040.getProximity();
-        uint16_t ambientLight = vcnl4040.getLux();
-        uint16_t whiteLight = vcnl4040.getWhiteLight();
-
-        // Read SHT40 Sensors
-        sensors_event_t rHum, temp;
-        sht4.getEvent(&rHum, &temp); // populate temp and humidity objects with fresh data
-
-        // Read M5's Internal Accelerometer (MPU 6886)
-        float accX;
-        float accY;
-        float accZ;
-        M5.IMU.getAccelData(&accX, &accY, &accZ);
-        accX *= 9.8;
-        accY *= 9.8;
-        accZ *= 9.8;
-        
-        // Get current time as timestamp of last update
-        timeClient.update();
-        unsigned long epochTime = timeClient.getEpochTime();
-        unsigned long long epochMillis = ((unsigned long long)epochTime)*1000;
-        struct tm *ptm = gmtime ((time_t *)&epochTime);
-        
-        // Device details
-        thisDeviceDetails.prox = prox;
-        thisDeviceDetails.ambientLight = ambientLight;
-        thisDeviceDetails.whiteLight = whiteLight;
-        thisDeviceDetails.temp = temp.temperature;
-        thisDeviceDetails.rHum = rHum.relative_humidity;
-        thisDeviceDetails.accX = accX;
-        thisDeviceDetails.accY = accY;
-        thisDeviceDetails.accZ = accZ;
-
-        // Post data to Firestore
-        gcfGetWithHeader(URL_GCF_UPLOAD, userId, epochTime, &thisDeviceDetails);
     }
 }
 
 ////////////////////////////////////////////////////////////////////
-// This method takes in a user ID, time and structure describing
-// device details and makes a GET request with the data. 
+// Every screenDelayMs: show the latest values
 ////////////////////////////////////////////////////////////////////
-bool gcfGetWithHeader(String serverUrl, String userId, time_t time, deviceDetails *details) {
-    // Allocate arrays for headers
-	const int numHeaders = 1;
-    String headerKeys [numHeaders] = {"M5-Details"};
-    String headerVals [numHeaders];
+void refreshUploadScreen()
+{
+    if (screen == S_UPLOAD) {
+        drawUploadDisplay(thisDeviceDetails, userId);
+    }
+}
 
-    // Add formatted JSON string to header
-    headerVals[0] = generateM5DetailsHeader(userId, time, details);
+////////////////////////////////////////////////////////////////////
+// Every sampleDelayMs: read the sensors into the telemetry buffer,
+// and upload the buffer when a batch is ready
+////////////////////////////////////////////////////////////////////
+void takeSample()
+{
+    // Read Sensor Values
+    // Read VCNL4040 Sensors
+    uint16_t prox = vcnl4040.getProximity();
+    uint16_t ambientLight = vcnl4040.getLux();
+    uint16_t whiteLight = vcnl4040.getWhiteLight();
+
+    // Read SHT40 Sensors
+    sensors_event_t rHum, temp;
+    sht4.getEvent(&rHum, &temp); // populate temp and humidity objects with fresh data
+
+    // Read M5's Internal Accelerometer (MPU 6886): the mean of the
+    // FIFO samples since the last sample
+    float accX;
+    float accY;
+    float accZ;
+    collectImuSamples(); // whatever came in since the last drain
+    if (accSamples > 0) {
+        accX = ImuFifo::toG(accSum[0] / accSamples);
+        accY = ImuFifo::toG(accSum[1] / accSamples);
+        accZ = ImuFifo::toG(accSum[2] / accSamples);
+        accSum[0] = accSum[1] = accSum[2] = 0;
+        accSamples = 0;
+    } else {
+        M5.IMU.getAccelData(&accX, &accY, &accZ);
+    }
+    accX *= 9.8;
+    accY *= 9.8;
+    accZ *= 9.8;
     
-    // Attempt to post the file
-    Serial.println("Attempting post data.");
-    int resCode = httpGetWithHeaders(serverUrl, headerKeys, headerVals, numHeaders);
+    // Get current time as timestamp of last update
+    timeClient.update();
+    unsigned long epochTime = timeClient.getEpochTime();
+    unsigned long long epochMillis = ((unsigned long long)epochTime)*1000;
+    struct tm *ptm = gmtime ((time_t *)&epochTime);
     
-    // Return true if received 200 (OK) response
-    return (resCode == 200);
+    // Device details
+    thisDeviceDetails.prox = prox;
+    thisDeviceDetails.ambientLight = ambientLight;
+    thisDeviceDetails.whiteLight = whiteLight;
+    thisDeviceDetails.temp = temp.temperature;
+    thisDeviceDetails.rHum = rHum.relative_humidity;
+    thisDeviceDetails.accX = accX;
+    thisDeviceDetails.accY = accY;
+    thisDeviceDetails.accZ = accZ;
+    thisDeviceDetails.timeCaptured = epochTime;
+
+    // Buffer it; the upload happens once per batch
+    telemetry.push(thisDeviceDetails, millis());
+    if (telemetry.shouldFlush(batchMaxSamples, batchMaxAgeMs, millis())) {
+        uploadTelemetry();
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
-// Generates the JSON header with sensor details and user data and serializes to a String.
+// Send the oldest batch of buffered samples, or move it to the
+// offline log if that fails (but not if it was rejected)
 ////////////////////////////////////////////////////////////////////
-String generateM5DetailsHeader(String userId, time_t time, deviceDetails *details) {
-    // Allocate M5-Details Header JSON object
-    StaticJsonDocument<650> objHeaderM5Details; //DynamicJsonDocument  objHeaderGD(600);
-    
-    // Add VCNL details
-    JsonObject objVcnlDetails = objHeaderM5Details.createNestedObject("vcnlDetails");
-    objVcnlDetails["prox"] = details->prox;
-    objVcnlDetails["al"] = details->ambientLight;
-    objVcnlDetails["rwl"] = details->whiteLight;
-
-    // Add SHT details
-    JsonObject objShtDetails = objHeaderM5Details.createNestedObject("shtDetails");
-    objShtDetails["temp"] = details->temp;
-    objShtDetails["rHum"] = details->rHum;
-
-    // Add M5 Sensor details
-    JsonObject objM5Details = objHeaderM5Details.createNestedObject("m5Details");
-    objM5Details["ax"] = details->accX;
-    objM5Details["ay"] = details->accY;
-    objM5Details["az"] = details->accZ;
-
-    // Add Other details
-    JsonObject objOtherDetails = objHeaderM5Details.createNestedObject("otherDetails");
-    objOtherDetails["timeCaptured"] = time;
-    objOtherDetails["userId"] = userId;
-
-    // Convert JSON object to a String which can be sent in the header
-    size_t jsonSize = measureJson(objHeaderM5Details) + 1;
-    char cHeaderM5Details [jsonSize];
-    serializeJson(objHeaderM5Details, cHeaderM5Details, jsonSize);
-    String strHeaderM5Details = cHeaderM5Details;
-    //Serial.println(strHeaderM5Details.c_str()); // Debug print
-
-    // Return the header as a String
-    return strHeaderM5Details;
+void uploadTelemetry() {
+    int numSamples = min(telemetry.size(), batchMaxSamples);
+    for (int i = 0; i < numSamples; i++) {
+        uploadBatch[i] = toTelemetrySample(telemetry.peek(i));
+    }
+
+    int resCode = WiFi.status() == WL_CONNECTED ? gcfPostBatch(URL_GCF_UPLOAD, userId, uploadBatch, numSamples) : -1;
+    if (resCode == 200 || batchRejected(resCode)) {
+        if (resCode != 200) {
+            countRejectedBatch(resCode, numSamples);
+        }
+        telemetry.pop(numSamples);
+        return;
+    }
+
+    if (telemetryLogReady) {
+        int saved = 0;
+        while (saved < numSamples && telemetryLog.append(uploadBatch[saved])) {
+            saved++;
+        }
+        telemetry.pop(saved);
+        Serial.printf("Upload failed, %d samples saved to flash (%d waiting)\n", saved, telemetryLog.pending());
+    } else {
+        // They stay in RAM and go with the next batch
+        Serial.printf("Upload failed, %d samples kept (%u dropped so far)\n", telemetry.size(), telemetry.droppedRecords());
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
-// This method makes a GET request with the averaging query request header parameters
+// Every logDrainMs: upload a batch from the offline log, if there is
+// anything in it and the link is up. A rejected batch is dropped like
+// a sent one; after a transport error or a 5xx the period doubles (up
+// to logDrainMaxMs) until a batch goes through.
 ////////////////////////////////////////////////////////////////////
-bool gcfGetWithReqHeader(String serverUrl, String userId, int duration, String dataType) {
-    // Allocate arrays for headers
-	const int numHeaders = 1;
-    String headerKeys [numHeaders] = {"Req-Details"};
-    String headerVals [numHeaders];
+void drainTelemetryLog() {
+    if (!telemetryLogReady || telemetryLog.pending() == 0 || WiFi.status() != WL_CONNECTED) {
+        return;
+    }
 
-    // Add formatted JSON string to header
-    headerVals[0] = generateReqDetailsHeader(userId, duration, dataType);
-    
-    // Attempt to post the file
-    Serial.println("Attempting to get average data.");
-    int resCode = httpGetWithHeaders(serverUrl, headerKeys, headerVals, numHeaders);
-    
-    // Return true if received 200 (OK) response
-    return (resCode == 200);
+    int numSamples = telemetryLog.read(uploadBatch, batchMaxSamples);
+    if (numSamples == 0) {
+        return;
+    }
+    int resCode = gcfPostBatch(URL_GCF_UPLOAD, userId, uploadBatch, numSamples);
+    if (resCode == 200 || batchRejected(resCode)) {
+        if (resCode != 200) {
+            countRejectedBatch(resCode, numSamples);
+        }
+        telemetryLog.consume(numSamples);
+        if (logDrainPeriodMs != logDrainMs) {
+            logDrainPeriodMs = logDrainMs;
+            scheduler.setPeriod(logDrainTask, logDrainPeriodMs);
+        }
+    } else if (logDrainPeriodMs < logDrainMaxMs) {
+        logDrainPeriodMs = min(logDrainPeriodMs * 2, logDrainMaxMs);
+        scheduler.setPeriod(logDrainTask, logDrainPeriodMs);
+        Serial.printf("Retrying the offline log in %lu ms\n", logDrainPeriodMs);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////
-// Generates the JSON header with request details and serializes to a String.
+// A 4xx means the function won't take this batch (malformed, or a
+// record version it doesn't know); only timeouts and rate limits are
+// worth another try. Transport errors (negative) and 5xx are retried.
 ////////////////////////////////////////////////////////////////////
-String generateReqDetailsHeader(String userId, int duration, String dataType) {
-    // Allocate Req-Details Header JSON object
-    StaticJsonDocument<650> objHeaderReqDetails; //DynamicJsonDocument  objHeaderGD(600);
-
-    objHeaderReqDetails["userId"] = userId;
-    objHeaderReqDetails["timeDuration"] = duration;
-    objHeaderReqDetails["dataType"] = dataType;
-
-    // Convert JSON object to a String which can be sent in the header
-    size_t jsonSize = measureJson(objHeaderReqDetails) + 1;
-    char cHeaderReqDetails [jsonSize];
-    serializeJson(objHeaderReqDetails, cHeaderReqDetails, jsonSize);
-    String strHeaderReqDetails = cHeaderReqDetails;
-    // Serial.println(strHeaderReqDetails.c_str()); // Debug print
-
-    // Return the header as a String
-    return strHeaderReqDetails;
+bool batchRejected(int resCode) {
+    return resCode >= 400 && resCode < 500 && resCode != 408 && resCode != 429;
+}
+
+void countRejectedBatch(int resCode, int numSamples) {
+    rejectedBatches++;
+    rejectedSamples += numSamples;
+    Serial.printf("Batch of %d samples rejected (HTTP %d), dropped; %lu batches (%lu samples) so far\n",
+                  numSamples, resCode, rejectedBatches, rejectedSamples);
 }
 
 ////////////////////////////////////////////////////////////////////
-// This method takes in a serverURL and array of headers and makes
-// a GET request with the headers attached and then returns the response.
+// This method POSTs numSamples samples as one binary batch
+// (include/TelemetryRecord.h): about 17 bytes per sample instead of
+// ~200 bytes of JSON. Returns the HTTP status code (negative for a
+// transport error).
 ////////////////////////////////////////////////////////////////////
-int httpGetWithHeaders(String serverURL, String *headerKeys, String *headerVals, int numHeaders) {
-    // Make GET request to serverURL
-    HTTPClient http;
-    http.begin(serverURL.c_str());
-    
-	////////////////////////////////////////////////////////////////////
-	// Add all the headers supplied via parameter
-	////////////////////////////////////////////////////////////////////
-    for (int i = 0; i < numHeaders; i++)
-        http.addHeader(headerKeys[i].c_str(), headerVals[i].c_str());
+int gcfPostBatch(String serverUrl, String userId, const TelemetrySample *samples, int numSamples) {
+    // Encode the batch
+    static uint8_t body[TelemetryEncoder::HEADER_SIZE + 255 + batchMaxSamples * TelemetryEncoder::MAX_RECORD_SIZE];
+    TelemetryEncoder encoder(body, sizeof(body));
+    encoder.begin(userId.c_str());
+    for (int i = 0; i < numSamples; i++) {
+        encoder.add(samples[i]);
+    }
+    size_t bodyLength = encoder.finish();
+    if (bodyLength == 0) {
+        Serial.println("Batch does not fit in the upload buffer.");
+        return -1;
+    }
+
+    // Attempt to post the batch
+    Serial.printf("Attempting post of %d samples (%u bytes).\n", numSamples, (unsigned)bodyLength);
+    const char *headerKeys[1] = {"Content-Type"};
+    const char *headerVals[1] = {"application/octet-stream"};
+    char response[128];
+    int resCode = HalHttp::request("POST", serverUrl.c_str(), headerKeys, headerVals, 1,
+                                   body, bodyLength, response, sizeof(response));
+    Serial.printf("HTTP%scode: %d\n%s\n\n", resCode > 0 ? " " : " ERROR ", resCode, response);
+
+    return resCode;
+}
+
+////////////////////////////////////////////////////////////////////
+// This method starts a GET request with the averaging query request
+// header parameters in the averageRequest task. Returns false if it
+// couldn't be started; the answer arrives as EVENT_AVERAGE_DONE.
+////////////////////////////////////////////////////////////////////
+bool gcfGetWithReqHeader(String serverUrl, String userId, int duration, String dataType) {
+    // Allocate arrays for headers
+	const int numHeaders = 1;
+    const char *headerKeys[numHeaders] = {"Req-Details"};
+    const char *headerVals[numHeaders];
+
+    // Add formatted JSON string to header (same encoder as
+    // tools/cloud_loadgen.cpp, CloudProtocol.h)
+    char reqDetails[128];
+    formatReqDetails(reqDetails, sizeof(reqDetails), userId.c_str(), duration, dataType.c_str());
+    headerVals[0] = reqDetails;
     
-    // Post the headers (NO FILE)
-    int httpResCode = http.GET();
-    String httpResString = http.getString();
+    // Hand the request to the worker task (it copies everything); the
+    // body goes to averageParser
+    Serial.println("Attempting to get average data.");
+    return averageRequest.get(serverUrl.c_str(), headerKeys, headerVals, numHeaders, &averageParser);
+}
+
+////////////////////////////////////////////////////////////////////
+// EVENT_AVERAGE_DONE: the average request is back (if it wasn't
+// cancelled in the meantime, done() is false then)
+////////////////////////////////////////////////////////////////////
+void showAverageResponse() {
+    if (!averageRequest.done() || screen != S_WAITING) {
+        return;
+    }
+    stopSpinner();
 
-    // Print the response code and message
-    Serial.printf("HTTP%scode: %d\n%s\n\n", httpResCode > 0 ? " " : " ERROR ", httpResCode, httpResString.c_str());
+    int resCode = averageRequest.code();
+    Serial.printf("HTTP%scode: %d (%u ms)\n\n", resCode > 0 ? " " : " ERROR ", resCode, averageRequest.elapsedMs());
 
-    if (serverURL == URL_GFC_AVERAGE) {
-        jsonAverageResponse = httpResString;
+    if (resCode == 200 && averageParser.result(&averageResult)) {
+        drawResultsDisplay(averageResult);
+    } else {
+        drawRequestFailed(resCode);
     }
+    screen = S_RESULTS;
+}
+
+/////////////////////////////////////////////////////////////////
+// Drain the IMU FIFO (only touches the bus once the watermark is
+// reached) and add the new samples to the upload average
+/////////////////////////////////////////////////////////////////
+void collectImuSamples() {
+    if (!imuFifoRunning)
+        return;
 
-    // Free resources and return response code
-    http.end();
-    return httpResCode;
+    imuFifo.poll();
+    ImuSample sample;
+    while (imuFifo.read(&sample)) {
+        for (int axis = 0; axis < 3; axis++)
+            accSum[axis] += sample.accel[axis];
+        accSamples++;
+    }
 }
 
 /////////////////////////////////////////////////////////////////
@@ -607,41 +761,57 @@ void drawWaitingResultsDisplay() {
     M5.Lcd.setTextSize(2);
     M5.Lcd.setCursor(10, (sHeight / 2) - 10);
     M5.Lcd.print("Waiting for results");
+
+    //button
+    M5.Lcd.setTextColor(TFT_DARKCYAN);
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setCursor(10+10, 40+10+70+70+40);
+    M5.Lcd.print("cancel");
 }
 
-void drawResultsDisplay(){
-     
-    String dataType;
-    float averageData;
-    float minData;
-    float maxData;
-    String timeRange;
-    int numDataPoints;
-    float rateDataCollected;    
-        
-    StaticJsonDocument<1024> objAverageResDetails; //DynamicJsonDocument
-    DeserializationError error = deserializeJson(objAverageResDetails, jsonAverageResponse);
-    if (!error) {
-        String dT = objAverageResDetails["dataType"];
-        float aD = objAverageResDetails["averageData"];
-        float minD = objAverageResDetails["minData"];
-        float maxD = objAverageResDetails["maxData"];
-        String tR = objAverageResDetails["timeRange"];
-        int nDP = objAverageResDetails["numDataPoints"];
-        float rDC = objAverageResDetails["rateDataCollect"];
-
-        dataType = dT;
-        averageData = aD;
-        minData = minD;
-        maxData = maxD;
-        timeRange = tR;
-        numDataPoints = nDP;
-        rateDataCollected = rDC;
-    } else {
-        screen = S_WAITING;
-        return;
+// Every spinnerMs while waiting: one dot of eight lit, going round
+void drawSpinner() {
+    const int dots = 8;
+    const int radius = 14;
+    int cx = sWidth / 2;
+    int cy = (sHeight / 2) + 40;
+
+    for (int i = 0; i < dots; i++) {
+        float angle = i * 2 * PI / dots;
+        int x = cx + (int)(radius * cos(angle));
+        int y = cy + (int)(radius * sin(angle));
+        M5.Lcd.fillCircle(x, y, 3, i == spinnerFrame ? TFT_WHITE : TFT_DARKGREY);
     }
-    
+    spinnerFrame = (spinnerFrame + 1) % dots;
+}
+
+void stopSpinner() {
+    scheduler.cancel(spinnerTask);
+    spinnerTask = Scheduler::NO_TASK;
+}
+
+// The average request failed (resCode 0: it couldn't be sent)
+void drawRequestFailed(int resCode) {
+    M5.Lcd.fillScreen(TFT_BLACK);
+    M5.Lcd.setTextColor(TFT_RED);
+
+    M5.Lcd.setTextSize(2);
+    M5.Lcd.setCursor(10, (sHeight / 2) - 10);
+    M5.Lcd.print("Request failed");
+    M5.Lcd.setTextColor(TFT_WHITE);
+    M5.Lcd.setCursor(10, (sHeight / 2) + 20);
+    if (resCode != 0) {
+        M5.Lcd.printf("HTTP code %d", resCode);
+    }
+
+    //button
+    M5.Lcd.setTextColor(TFT_DARKCYAN);
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setCursor(10+10, 40+10+70+70+40);
+    M5.Lcd.print("upload data");
+}
+
+void drawResultsDisplay(const AverageResult &result){
     int pad = 10;
 
     M5.Lcd.fillScreen(TFT_BLACK);
@@ -651,45 +821,45 @@ void drawResultsDisplay(){
     M5.Lcd.setCursor(pad, pad);
     M5.Lcd.print("Average ");
     M5.Lcd.setTextColor(TFT_GREEN);
-    M5.Lcd.print(dataType);
+    M5.Lcd.print(dataTypeName(result.dataType));
     M5.Lcd.setTextColor(TFT_WHITE);
     M5.Lcd.print(" Readings");
 
     M5.Lcd.setCursor(pad, M5.Lcd.getCursorY() + 40);
     M5.Lcd.print("Average value: ");
-    M5.Lcd.setTextColor(TFT_PINK);
-    M5.Lcd.printf("%0.2f%", averageData);
+    char value[16];
+    snprintf(value, sizeof(value), "%0.2f", result.average);
+    M5.Lcd.setCursor(GlyphCache::drawString(M5.Lcd.getCursorX(), M5.Lcd.getCursorY(), value, 2, TFT_PINK, TFT_BLACK), M5.Lcd.getCursorY());
 
     M5.Lcd.setTextColor(TFT_WHITE);
     M5.Lcd.setCursor(pad, M5.Lcd.getCursorY() + 40);
     M5.Lcd.print("Number of Data Points: ");
     M5.Lcd.setTextColor(TFT_CYAN);
-    M5.Lcd.printf("%d", numDataPoints);
+    M5.Lcd.printf("%d", (int)result.count);
 
     M5.Lcd.setCursor(pad, M5.Lcd.getCursorY() + 40);
     M5.Lcd.setTextColor(TFT_WHITE);
     M5.Lcd.print("Data Col. Rate: ");
     M5.Lcd.setTextColor(TFT_CYAN);
-    M5.Lcd.printf("%0.3f", rateDataCollected);
+    M5.Lcd.printf("%0.3f", result.rate);
 
     M5.Lcd.setCursor(pad, M5.Lcd.getCursorY() + 40);
     M5.Lcd.setTextColor(TFT_WHITE);
     M5.Lcd.print("Min: ");
-    M5.Lcd.setTextColor(TFT_YELLOW);
-    M5.Lcd.printf("%0.2f", minData);
+    snprintf(value, sizeof(value), "%0.2f", result.min);
+    M5.Lcd.setCursor(GlyphCache::drawString(M5.Lcd.getCursorX(), M5.Lcd.getCursorY(), value, 2, TFT_YELLOW, TFT_BLACK), M5.Lcd.getCursorY());
 
     M5.Lcd.print(" ");
 
-    M5.Lcd.setTextColor(TFT_WHITE);
     M5.Lcd.print("Max:");
-    M5.Lcd.setTextColor(TFT_YELLOW);
-    M5.Lcd.printf("%0.2f", maxData);
+    snprintf(value, sizeof(value), "%0.2f", result.max);
+    M5.Lcd.setCursor(GlyphCache::drawString(M5.Lcd.getCursorX(), M5.Lcd.getCursorY(), value, 2, TFT_YELLOW, TFT_BLACK), M5.Lcd.getCursorY());
 
     M5.Lcd.setCursor(pad + 10, M5.Lcd.getCursorY() + 44);
     M5.Lcd.setTextColor(TFT_WHITE);
     M5.Lcd.setTextSize(1);
-    M5.Lcd.print(timeRange);
-    Serial.println("timerange: " + timeRange);
+    M5.Lcd.print(result.timeRange);
+    Serial.printf("timerange: %s\n", result.timeRange);
 
     //button
     M5.Lcd.setTextColor(TFT_DARKCYAN);
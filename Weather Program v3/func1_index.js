@@ -2,7 +2,7 @@
 // Imports
 //////////////////////////////////////////////////////////////
 const functions = require('@google-cloud/functions-framework');
-const {Firestore} = require('@google-cloud/firestore');
+const {Firestore, FieldValue} = require('@google-cloud/firestore');
 const fs = require("fs"); // File System
 
 //////////////////////////////////////////////////////////////
@@ -15,6 +15,29 @@ const fs = require("fs"); // File System
 //////////////////////////////////////////////////////////////
 const gcsBucketName = "raztaz";
 const gfsCollectionName = "m5_data";
+const maxBatchWrites = 500; // Firestore limit per commit
+
+// Per-minute aggregate buckets for the average function
+// (func2_index.js reads them), one per user, metric and minute:
+// m5_data/aggregates/<userId>/<metric>/minutes/<minute>
+const bucketSeconds = 60;
+const metricFields = [
+	"vcnlDetails.prox", "vcnlDetails.al", "vcnlDetails.rwl",
+	"shtDetails.temp", "shtDetails.rHum",
+	"m5Details.ax", "m5Details.ay", "m5Details.az"
+].map((field) => field.split("."));
+
+// Users already in the registry document (m5_data/users, which the
+// average function reads for "all"), so it is written once per user
+// per instance rather than on every upload
+const registeredUsers = new Set();
+
+//////////////////////////////////////////////////////////////
+// One Firestore client per instance, created when the module loads:
+// every request on a warm instance reuses its gRPC channel and auth
+// token instead of setting them up again
+//////////////////////////////////////////////////////////////
+const firestore = new Firestore();
 
 //////////////////////////////////////////////////////////////
 // TODO 1: Create cloud function and ensure function entry
@@ -29,6 +52,32 @@ const gfsCollectionName = "m5_data";
 // Function that is triggered when HTTP request is made
 //////////////////////////////////////////////////////////////
 functions.http('upload', async (req, res) => {
+	if (req.query && req.query.warmup !== undefined) {
+		await warmUp(res);
+		return;
+	}
+
+	///////////////////////////////////////////////////////////////
+	// Batched uploads: a binary body (include/TelemetryRecord.h) or
+	// a JSON body with many samples
+	///////////////////////////////////////////////////////////////
+	if (req.is('application/octet-stream')) {
+		let batch;
+		try {
+			batch = decodeTelemetry(req.rawBody || req.body);
+		} catch (e) {
+			console.error(`Could NOT decode the binary batch: ${e.message}`);
+			res.status(400).send("Malformed request.");
+			return;
+		}
+		await uploadBatch(batch.userId, batch.samples, res);
+		return;
+	}
+	if (req.body && Array.isArray(req.body.samples)) {
+		await uploadBatch(req.body.userId, req.body.samples, res);
+		return;
+	}
+
  	///////////////////////////////////////////////////////////////
 	// Get the M5-Details header (a String, but originally a JSON
     // object that was serialized to a String), which has M5Core2
@@ -52,11 +101,13 @@ functions.http('upload', async (req, res) => {
 				let message = 'Could NOT parse JSON details in header';
 				console.error(message);
 				res.status(400).send("Malformed request.");
+				return;
 			}
 	} catch(e) {
 		let message = 'Could NOT parse JSON details from header.';
 		console.error(message);
 		res.status(400).send("Malformed request.");
+		return;
 	}
 
 	//////////////////////////////////////////////////////////////
@@ -79,8 +130,8 @@ functions.http('upload', async (req, res) => {
 	//
 	// TODO 5: Go to IAM and add permissions for Firestore and
 	// Cloud Storage for your cloud function's service account.
+	// (firestore is created once, at module scope)
 	///////////////////////////////////////////////////////////////
-	const firestore = new Firestore();
 	// const storage = new Storage();
 
 	///////////////////////////////////////////////////////////////
@@ -93,8 +144,8 @@ functions.http('upload', async (req, res) => {
 		const docRef = firestore.collection(gfsCollectionName).doc("users").collection(userId).doc();
 		console.log(`Doc ref obtained: ${docRef.path}`);
 
-		// Make entry into Firestore DB
-		await docRef.set(objDetails);
+		// Make entry into Firestore DB (and its aggregate buckets)
+		await writeSamples(firestore, userId, [objDetails], timeNow, () => docRef);
 		message = `GFS STATUS: M5 Details successfully uploaded to Firestore collection ${gfsCollectionName}`;
 		console.log(message);
 		//res.status(200).send(message);
@@ -119,7 +170,6 @@ functions.http('upload', async (req, res) => {
 	// upload to Google Storage
 	///////////////////////////////////////////////////////////////
 	// Option 1: Just create dummy file as proof of concept
-	f// // Option 1: Just create dummy file as proof of concept
 	// fs.writeFile(fsFileName, strHeaderM5, function (err) {
 	// 	if (err) throw err;
 	// 	console.log(`${fsFileName} created successfully.`);
@@ -151,6 +201,12 @@ functions.http('upload', async (req, res) => {
 	// }
 	
 
+	// The details were written
+	if (message != "") {
+		res.status(200).send(message);
+		return;
+	}
+
 	///////////////////////////////////////////////////////////////
 	// If made it here, we did not have a successful run; return
 	// a generic error message to the client.
@@ -159,6 +215,219 @@ functions.http('upload', async (req, res) => {
 
 });
 
+//////////////////////////////////////////////////////////////
+// A warm-up request (?warmup, sent after a deploy or on a schedule)
+// makes one tiny read so the instance has its channel open and its
+// token fetched before real requests arrive
+//////////////////////////////////////////////////////////////
+async function warmUp(res) {
+	try {
+		await firestore.collection(gfsCollectionName).doc("users").get();
+		res.status(204).send();
+	} catch (e) {
+		res.status(500).send(`Warm-up failed: ${e}`);
+	}
+}
+
+//////////////////////////////////////////////////////////////
+// Writes a batch of samples, where each sample has the same layout
+// as the M5-Details header, in a few commits instead of one request
+// and one write per sample.
+//////////////////////////////////////////////////////////////
+async function uploadBatch(userId, samples, res) {
+	// Check that every sample has the essential components
+	const isSample = (s) => s && s.vcnlDetails && s.shtDetails && s.m5Details && s.otherDetails;
+	if (typeof userId !== "string" || userId == "" || !samples.every(isSample)) {
+		console.error('Could NOT parse the samples in the batch');
+		res.status(400).send("Malformed request.");
+		return;
+	}
+
+	const timeNow = Date.now();
+	try {
+		await writeSamples(firestore, userId, samples, timeNow);
+	} catch (e) {
+		let eMessage = `GFS ERROR: Could NOT write batch to ${gfsCollectionName}: ${e}`;
+		console.log(eMessage);
+		res.status(500).send(eMessage);
+		return;
+	}
+
+	let message = `GFS STATUS: ${samples.length} samples from ${userId} uploaded to Firestore collection ${gfsCollectionName}`;
+	console.log(message);
+	res.status(200).send(message);
+}
+
+//////////////////////////////////////////////////////////////
+// Writes samples and folds them into their per-minute aggregate
+// buckets (count, sum, sum of squares, min, max). Each chunk is one
+// transaction, so the buckets always match the samples, even when
+// two uploads for the same user and minute race. A chunk stays
+// under maxBatchWrites sample + bucket writes. newDocRef picks the
+// sample documents (default: auto IDs in the user's collection).
+//////////////////////////////////////////////////////////////
+async function writeSamples(firestore, userId, samples, timeNow, newDocRef) {
+	const userRef = firestore.collection(gfsCollectionName).doc("users").collection(userId);
+	newDocRef = newDocRef || (() => userRef.doc());
+
+	let chunk = [];
+	let bucketKeys = new Set();
+	for (const sample of samples) {
+		const keys = sampleValues(sample).map((v) => `${v.metric}/${v.minute}`);
+		const newKeys = keys.filter((k) => !bucketKeys.has(k));
+		if (chunk.length > 0 && chunk.length + 1 + bucketKeys.size + newKeys.length > maxBatchWrites) {
+			await writeChunk(firestore, userId, chunk, timeNow, newDocRef);
+			chunk = [];
+			bucketKeys = new Set();
+		}
+		chunk.push(sample);
+		keys.forEach((k) => bucketKeys.add(k));
+	}
+	if (chunk.length > 0) {
+		await writeChunk(firestore, userId, chunk, timeNow, newDocRef);
+	}
+
+	// The samples are stored by now, so a failed registry write must not
+	// fail the upload: the device would send the batch again and count
+	// it twice. It is tried again on this user's next upload (the
+	// average function reads a single user without the registry)
+	if (!registeredUsers.has(userId)) {
+		try {
+			await firestore.collection(gfsCollectionName).doc("users")
+				.set({userIds: FieldValue.arrayUnion(userId)}, {merge: true});
+			registeredUsers.add(userId);
+		} catch (e) {
+			console.error(`GFS ERROR: Could NOT add ${userId} to the user registry: ${e}`);
+		}
+	}
+}
+
+async function writeChunk(firestore, userId, samples, timeNow, newDocRef) {
+	// Sum up the chunk per bucket first
+	const buckets = new Map();
+	for (const sample of samples) {
+		for (const {metric, minute, value} of sampleValues(sample)) {
+			const key = `${metric}/${minute}`;
+			if (!buckets.has(key)) {
+				buckets.set(key, {metric, minute, count: 0, sum: 0, sumSq: 0, min: value, max: value});
+			}
+			const b = buckets.get(key);
+			b.count++;
+			b.sum += value;
+			b.sumSq += value * value;
+			b.min = Math.min(b.min, value);
+			b.max = Math.max(b.max, value);
+		}
+	}
+	const added = [...buckets.values()];
+	const refs = added.map((b) => firestore.collection(gfsCollectionName).doc("aggregates").collection(userId)
+		.doc(b.metric).collection("minutes").doc(String(b.minute)));
+
+	await firestore.runTransaction(async (t) => {
+		// Reads have to come before the writes
+		const stored = refs.length > 0 ? await t.getAll(...refs) : [];
+		stored.forEach((snapshot, i) => {
+			const b = added[i];
+			const old = snapshot.exists ? snapshot.data() : null;
+			t.set(refs[i], {
+				metric: b.metric,
+				minute: b.minute,
+				count: b.count + (old ? old.count : 0),
+				sum: b.sum + (old ? old.sum : 0),
+				sumSq: b.sumSq + (old ? old.sumSq : 0),
+				min: old ? Math.min(old.min, b.min) : b.min,
+				max: old ? Math.max(old.max, b.max) : b.max
+			});
+		});
+		for (const sample of samples) {
+			sample.otherDetails.userId = userId;
+			sample.otherDetails["cloudUploadTime"] = timeNow;
+			t.set(newDocRef(), sample);
+		}
+	});
+}
+
+// The numeric metrics of a sample, with the minute they go into
+function sampleValues(sample) {
+	const minute = Math.floor(sample.otherDetails.timeCaptured / bucketSeconds) * bucketSeconds;
+	const values = [];
+	for (const [group, metric] of metricFields) {
+		const value = sample[group][metric];
+		if (typeof value === "number" && isFinite(value)) {
+			values.push({metric, minute, value});
+		}
+	}
+	return values;
+}
+
+//////////////////////////////////////////////////////////////
+// Decodes a binary batch from the M5 (see include/TelemetryRecord.h
+// for the layout) into {userId, samples}, with the samples in the
+// M5-Details JSON layout. Throws on anything malformed.
+//////////////////////////////////////////////////////////////
+function decodeTelemetry(buf) {
+	if (!Buffer.isBuffer(buf) || buf.length < 10 || buf[0] != 0x4D || buf[1] != 0x35) {
+		throw new Error("not a telemetry batch");
+	}
+	const version = buf[2];
+	if (version != 1) {
+		throw new Error(`unsupported version ${version}`);
+	}
+	const count = buf.readUInt16LE(3);
+	const userIdLength = buf[5];
+	if (buf.length < 10 + userIdLength) {
+		throw new Error("truncated header");
+	}
+	let pos = 6;
+	const userId = buf.toString("utf8", pos, pos + userIdLength);
+	pos += userIdLength;
+	let time = buf.readUInt32LE(pos);
+	pos += 4;
+
+	const samples = [];
+	for (let i = 0; i < count; i++) {
+		// Zigzag varint time delta
+		let zigzag = 0;
+		for (let shift = 0; ; shift += 7) {
+			if (pos >= buf.length || shift > 35) {
+				throw new Error("truncated record");
+			}
+			const b = buf[pos++];
+			zigzag += (b & 0x7F) * 2 ** shift;
+			if (b < 0x80) {
+				break;
+			}
+		}
+		time += zigzag % 2 ? -(zigzag + 1) / 2 : zigzag / 2;
+
+		if (pos + 16 > buf.length) {
+			throw new Error("truncated record");
+		}
+		samples.push({
+			vcnlDetails: {
+				prox: buf.readUInt16LE(pos),
+				al: buf.readUInt16LE(pos + 2),
+				rwl: buf.readUInt16LE(pos + 4)
+			},
+			shtDetails: {
+				temp: buf.readInt16LE(pos + 6) / 100,
+				rHum: buf.readUInt16LE(pos + 8) / 100
+			},
+			m5Details: {
+				ax: buf.readInt16LE(pos + 10) / 100,
+				ay: buf.readInt16LE(pos + 12) / 100,
+				az: buf.readInt16LE(pos + 14) / 100
+			},
+			otherDetails: {
+				timeCaptured: time,
+				userId: userId
+			}
+		});
+		pos += 16;
+	}
+	return {userId, samples};
+}
+
 /*
 ///////////////////////////////////////////////////////////////
 // "Pretty" JSON Model Example
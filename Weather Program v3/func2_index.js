@@ -5,10 +5,40 @@ const {Firestore} = require('@google-cloud/firestore');
 // Function variables
 const gfsCollectionName = "m5_data";
 
+// The users "all" covers are listed in the registry document
+// m5_data/users ({userIds: [...]}, kept by the upload function),
+// plus these, who uploaded before there was a registry
+const defaultUsers = ["raz", "taz"];
+
+// Metric registry: the field each dataType is read from. The
+// aggregate buckets the upload function (func1_index.js) writes are
+// named after the field's last part:
+// m5_data/aggregates/<userId>/<metric>/minutes/<minute>
+const bucketSeconds = 60;
+const metricFields = {
+	prox: "vcnlDetails.prox",
+	al: "vcnlDetails.al",
+	als: "vcnlDetails.al", // the device's older name for it
+	rwl: "vcnlDetails.rwl",
+	temp: "shtDetails.temp",
+	rHum: "shtDetails.rHum",
+	ax: "m5Details.ax",
+	ay: "m5Details.ay",
+	az: "m5Details.az"
+};
+
+// One Firestore client per instance, as in the upload function
+const firestore = new Firestore();
+
 //////////////////////////////////////////////////////////////
 // Function that is triggered when HTTP request is made
 //////////////////////////////////////////////////////////////
 functions.http('average', async (req, res) => {
+	if (req.query && req.query.warmup !== undefined) {
+		await warmUp(res);
+		return;
+	}
+
 	// Get the request details header 
 	const strHeaderM5 = req.get('Req-Details');
 	
@@ -25,17 +55,24 @@ functions.http('average', async (req, res) => {
 				let message = 'Could NOT parse JSON details in header';
 				console.error(message);
 				res.status(400).send("Malformed request.");
+				return;
 			}
 	} catch(e) {
 		let message = 'Could NOT parse JSON details from header.';
 		console.error(message);
 		res.status(400).send("Malformed request.");
+		return;
 	}
 
 	// Parse request info from the HTTP custom header 
 	const userId = reqDetails.userId;
 	const timeDuration = reqDetails.timeDuration;
 	const dataType = reqDetails.dataType;
+	const field = metricFields[dataType];
+	if (field === undefined) {
+		res.status(400).send(`Unknown dataType ${dataType}`);
+		return;
+	}
 
 	// time range to calculate the average from
     const timeCurr = Date.now() / 1000; // UTC epoch in seconds
@@ -43,141 +80,46 @@ functions.http('average', async (req, res) => {
 
 	console.log("timecurr: " + timeCurr);
 	console.log("timestart: " + timeStart);
-	
-	// Firestore client
-	const firestore = new Firestore(); 
 
 	// Get the details from Google Firestore
 	try {
+		// Which users to combine. A single user is queried whether or
+		// not the registry lists them; no data gives a 204 below
+		const userIds = userId == "all" ? await readUserRegistry(firestore) : [userId];
 
 		// returning variables
 		// a. Data type (e.g., ax, temp, rHum) (variable already exists)
 		let stringTimeCurr = toPrettyTimeString(timeCurr); // b. Range of actual data (e.g., 4/14/2025 1:20:05pm – 4/14/2025 1:20:32pm)
 		let stringTimeStart = toPrettyTimeString(timeStart); // b. Range of actual data (e.g., 4/14/2025 1:20:05pm – 4/14/2025 1:20:32pm)
 
-		var numOccurences = 0; // c. Number of data points found within the timeDuration
-		var rateOfDataCollection = 0; // d. Rate of data collection (data points per second...just (c)/(b)) will be overridden later
-
-		var maxValue = -10000.0; // extremely low number so that the max will get overridden 
-		var minValue = 10000.0; // extremely high number so that the min will get overridden 
-		
-		var totalValues = 0.0; 
-		var averagedValue = 0.0;
-
-        if (userId == "raz" || userId == "taz") {
-            const userRef = firestore.collection(gfsCollectionName).doc("users").collection(userId);
-            const snapshots = await userRef.where('otherDetails.timeCaptured', '>=', timeStart).get();
-            
-            if (snapshots.empty) {
-                console.log('No matching documents.');
-				res.status(204).send("No matching documents");
-                return;
-            }
-
-            snapshots.forEach(doc => {
-				numOccurences++; // increment counter
-				let snapshotValue = -1;
-				
-				// check for the data type requested
-				if (dataType == "ax" || dataType == "ay" || dataType == "az") {
-					snapshotValue = doc.data()['m5Details'][dataType];
-				} else if (dataType == "rHum" || dataType == "temp") {
-					snapshotValue = doc.data()['shtDetails'][dataType];
-				} else if (dataType == "als" || dataType == "prox" || dataType == "rwl") {
-					snapshotValue = doc.data()['vcnlDetails'][dataType];
-				}
-
-				if (snapshotValue < minValue) {
-					minValue = snapshotValue; // replace the minValue with the new smaller value
-				} 
-				if (snapshotValue > maxValue) {
-					maxValue = snapshotValue; // replace the maxValue with the new larger value
-				}
-
-				totalValues += snapshotValue; // add to the total for the averaging
-            });
-
-			averagedValue = totalValues / numOccurences;
-			rateOfDataCollection = numOccurences / timeDuration;
-        } else if (userId == "all") {
-			// go through Tabby's data
-			const tazUserRef = firestore.collection(gfsCollectionName).doc("users").collection("taz"); 
-            const tazSnapshots = await tazUserRef.where('otherDetails.timeCaptured', '>=', timeStart).get();
-            
-            if (tazSnapshots.empty) {
-                console.log('No matching documents.');
-				res.status(204).send("No matching documents");
-                return;
-            }
-
-            tazSnapshots.forEach(doc => {
-				numOccurences++; // increment counter
-				let snapshotValue = -1;
-				
-				// check for the data type requested
-				if (dataType == "ax" || dataType == "ay" || dataType == "az") {
-					snapshotValue = doc.data()['m5Details'][dataType];
-				} else if (dataType == "rHum" || dataType == "temp") {
-					snapshotValue = doc.data()['shtDetails'][dataType];
-				} else if (dataType == "als" || dataType == "prox" || dataType == "rwl") {
-					snapshotValue = doc.data()['vcnlDetails'][dataType];
-				}
-
-				if (snapshotValue < minValue) {
-					minValue = snapshotValue; // replace the minValue with the new smaller value
-				} 
-				if (snapshotValue > maxValue) {
-					maxValue = snapshotValue; // replace the maxValue with the new larger value
-				}
-
-				totalValues += snapshotValue; // add to the total for the averaging
-            });
-
-			// go through Sarah's data
-			const razUserRef = firestore.collection(gfsCollectionName).doc("users").collection("raz"); 
-            const razSnapshots = await razUserRef.where('otherDetails.timeCaptured', '>=', timeStart).get();
-            
-            if (razSnapshots.empty) {
-                console.log('No matching documents.');
-				res.status(204).send("No matching documents");
-                return;
-            }
-
-            razSnapshots.forEach(doc => {
-				numOccurences++; // increment counter
-				let snapshotValue = -1;
-				
-				// check for the data type requested
-				if (dataType == "ax" || dataType == "ay" || dataType == "az") {
-					snapshotValue = doc.data()['m5Details'][dataType];
-				} else if (dataType == "rHum" || dataType == "temp") {
-					snapshotValue = doc.data()['shtDetails'][dataType];
-				} else if (dataType == "als" || dataType == "prox" || dataType == "rwl") {
-					snapshotValue = doc.data()['vcnlDetails'][dataType];
-				}
-
-				if (snapshotValue < minValue) {
-					minValue = snapshotValue; // replace the minValue with the new smaller value
-				} 
-				if (snapshotValue > maxValue) {
-					maxValue = snapshotValue; // replace the maxValue with the new larger value
-				}
-
-				totalValues += snapshotValue; // add to the total for the averaging
-            });
-
-			averagedValue = totalValues / numOccurences;
-			rateOfDataCollection = numOccurences / timeDuration;
-		} else {
-			res.status(404).message("couldn't find userID");
+		// Every user's queries run at once, so this takes as long as
+		// the slowest user instead of the sum of them
+		const queryStart = process.hrtime.bigint();
+		const perUser = await Promise.all(userIds.map((id) => windowStats(firestore, id, field, timeStart)));
+		const stats = perUser.reduce(combineStats, emptyStats());
+		const queryTimeMs = Number(process.hrtime.bigint() - queryStart) / 1e6;
+		console.log(`Query time: ${queryTimeMs.toFixed(1)} ms for ${userIds.length} user(s), ${stats.count} data points`);
+		res.set('Server-Timing', `firestore;dur=${queryTimeMs.toFixed(1)}`);
+
+		if (stats.count == 0) {
+			console.log('No matching documents.');
+			res.status(204).send("No matching documents");
 			return;
 		}
 
+		let numOccurences = stats.count; // c. Number of data points found within the timeDuration
+		let rateOfDataCollection = numOccurences / timeDuration; // d. Rate of data collection (data points per second...just (c)/(b))
+		let averagedValue = stats.sum / stats.count;
+		let variance = Math.max(0, stats.sumSq / stats.count - averagedValue * averagedValue);
+
 		let responseObj = {'dataType' : dataType, 'averageData' : averagedValue, 
-		'minData' : minValue, 'maxData' : maxValue, 'timeRange' : `${stringTimeStart} - ${stringTimeCurr}`, 
-		'numDataPoints' : numOccurences, 'rateDataCollect' : rateOfDataCollection};
+		'minData' : stats.min, 'maxData' : stats.max, 'stdDevData' : Math.sqrt(variance),
+		'timeRange' : `${stringTimeStart} - ${stringTimeCurr}`, 
+		'numDataPoints' : numOccurences, 'rateDataCollect' : rateOfDataCollection,
+		'queryTimeMs' : queryTimeMs};
 
 		res.status(200).send(responseObj);
+		return;
 
 	} catch (e) {
 		let eMessage = `GFS ERROR: Could NOT get details from ${gfsCollectionName}: ${e}`;
@@ -189,6 +131,82 @@ functions.http('average', async (req, res) => {
 
 });
 
+// ?warmup: see warmUp() in the upload function (func1_index.js)
+async function warmUp(res) {
+	try {
+		await firestore.collection(gfsCollectionName).doc("users").get();
+		res.status(204).send();
+	} catch (e) {
+		res.status(500).send(`Warm-up failed: ${e}`);
+	}
+}
+
+//////////////////////////////////////////////////////////////
+// Count, sum, sum of squares, min and max of one user's field (from
+// metricFields) since timeStart. Whole minutes come from the aggregate buckets the
+// upload function keeps (one document per minute instead of one per
+// sample); only the partial first minute is read from the samples.
+// Both queries return just the fields used (select()) and are
+// reduced as the documents stream in.
+//////////////////////////////////////////////////////////////
+async function windowStats(firestore, userId, field, timeStart) {
+	const metric = field.slice(field.lastIndexOf(".") + 1);
+
+	// The first whole minute in the window
+	const firstBucket = Math.ceil(timeStart / bucketSeconds) * bucketSeconds;
+
+	const buckets = firestore.collection(gfsCollectionName).doc("aggregates").collection(userId)
+		.doc(metric).collection("minutes")
+		.where('minute', '>=', firstBucket)
+		.select('count', 'sum', 'sumSq', 'min', 'max');
+	const head = firestore.collection(gfsCollectionName).doc("users").collection(userId)
+		.where('otherDetails.timeCaptured', '>=', timeStart)
+		.where('otherDetails.timeCaptured', '<', firstBucket)
+		.select(field);
+
+	const [bucketStats, headStats] = await Promise.all([
+		reduceQuery(buckets, (stats, doc) => combineStats(stats, doc.data())),
+		reduceQuery(head, (stats, doc) => {
+			const value = doc.get(field);
+			if (typeof value !== "number") {
+				return stats;
+			}
+			return combineStats(stats, {count: 1, sum: value, sumSq: value * value, min: value, max: value});
+		})
+	]);
+	return combineStats(bucketStats, headStats);
+}
+
+// Folds a query's documents into stats as they arrive
+async function reduceQuery(query, reducer) {
+	let stats = emptyStats();
+	for await (const doc of query.stream()) {
+		stats = reducer(stats, doc);
+	}
+	return stats;
+}
+
+// The user IDs in the registry document, and the default users
+async function readUserRegistry(firestore) {
+	const registry = await firestore.collection(gfsCollectionName).doc("users").get();
+	const userIds = registry.exists ? registry.get("userIds") : undefined;
+	return [...new Set(defaultUsers.concat(Array.isArray(userIds) ? userIds : []))];
+}
+
+function emptyStats() {
+	return {count: 0, sum: 0, sumSq: 0, min: Infinity, max: -Infinity};
+}
+
+function combineStats(a, b) {
+	return {
+		count: a.count + b.count,
+		sum: a.sum + b.sum,
+		sumSq: a.sumSq + b.sumSq,
+		min: Math.min(a.min, b.min),
+		max: Math.max(a.max, b.max)
+	};
+}
+
 function toPrettyTimeString(seconds) {
 	let d = new Date(0);
 	d.setUTCSeconds(seconds);
@@ -0,0 +1,207 @@
+#include "../include/MoleBoard.h"
+
+// Hole sprite geometry: the hole ellipse is 25x12 around its center
+// and a mole pokes 30px above it
+const int HOLE_RAD = 25;
+const int MOLE_WIDTH = 30;
+const int MOLE_HEIGHT = 25;
+const int HOLE_SPRITE_W = 2 * HOLE_RAD + 1;
+const int HOLE_SPRITE_H = 30 + HOLE_RAD / 2 + 1;
+const int HOLE_SPRITE_CX = HOLE_RAD;
+const int HOLE_SPRITE_CY = 30;
+
+MoleBoard::MoleBoard() : holeSprite(&M5.Lcd), moleSprite(&M5.Lcd), spritesReady(false), shownTurns(-1)
+{
+    for (int i = 0; i < 6; i++)
+        dieSprites[i] = nullptr;
+    for (int i = 0; i < NUM_HOLES; i++)
+        shownMoles[i] = false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Rasterize the hole, mole and die faces once. Sprites land in PSRAM
+// when it is available.
+//////////////////////////////////////////////////////////////////////
+void MoleBoard::begin()
+{
+    sWidth = M5.Lcd.width();
+    sHeight = M5.Lcd.height();
+
+    spritesReady = holeSprite.createSprite(HOLE_SPRITE_W, HOLE_SPRITE_H) != nullptr &&
+                   moleSprite.createSprite(HOLE_SPRITE_W, HOLE_SPRITE_H) != nullptr;
+    for (int i = 0; i < 6 && spritesReady; i++)
+    {
+        dieSprites[i] = new TFT_eSprite(&M5.Lcd);
+        spritesReady = dieSprites[i]->createSprite(DIE_SIZE, DIE_SIZE) != nullptr;
+    }
+
+    if (!spritesReady)
+    {
+        Serial.println("MoleBoard: not enough memory for sprites, drawing primitives");
+        return;
+    }
+
+    holeSprite.fillSprite(BOARD_COLOR);
+    renderHole(holeSprite, HOLE_SPRITE_CX, HOLE_SPRITE_CY);
+
+    moleSprite.fillSprite(BOARD_COLOR);
+    drawMole(moleSprite, HOLE_SPRITE_CX, HOLE_SPRITE_CY);
+
+    for (int i = 0; i < 6; i++)
+    {
+        dieSprites[i]->fillSprite(BOARD_COLOR);
+        renderDie(*dieSprites[i], i + 1, 0, 0);
+    }
+}
+
+void MoleBoard::drawFull(const char *title, const bool moles[], int turnsRemaining)
+{
+    M5.Lcd.fillScreen(BOARD_COLOR);
+
+    // title
+    int pad = 10;
+    M5.Lcd.setCursor(pad, pad);
+    M5.Lcd.setTextColor(TFT_WHITE);
+    M5.Lcd.setTextSize(3);
+    M5.Lcd.println(title);
+
+    for (int i = 0; i < NUM_HOLES; i++)
+    {
+        drawHole(i, moles[i]);
+        shownMoles[i] = moles[i];
+    }
+    drawTurns(turnsRemaining);
+}
+
+int MoleBoard::update(const bool moles[], int turnsRemaining)
+{
+    int holesDrawn = 0;
+    for (int i = 0; i < NUM_HOLES; i++)
+    {
+        if (moles[i] != shownMoles[i])
+        {
+            drawHole(i, moles[i]);
+            shownMoles[i] = moles[i];
+            holesDrawn++;
+        }
+    }
+
+    if (turnsRemaining != shownTurns)
+        drawTurns(turnsRemaining);
+
+    return holesDrawn;
+}
+
+void MoleBoard::clearSidebar()
+{
+    // starts just right of the last column of holes
+    int x = sidebarX() - 35;
+    M5.Lcd.fillRect(x, 0, sWidth - x, sHeight, BOARD_COLOR);
+}
+
+void MoleBoard::drawDie(int face, int x, int y)
+{
+    if (face < 1 || face > 6)
+        return;
+
+    if (spritesReady)
+        dieSprites[face - 1]->pushSprite(x, y);
+    else
+        renderDie(M5.Lcd, face, x, y);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Holes 0-2 are the top row and 3-5 the bottom row
+//////////////////////////////////////////////////////////////////////
+void MoleBoard::holeCenter(int hole, int *x, int *y) const
+{
+    int column = hole % 3;
+    *x = ((column * 2) + 1) * (sWidth / 9);
+    *y = hole < 3 ? 80 : 160;
+}
+
+void MoleBoard::drawHole(int hole, bool moleUp)
+{
+    int x, y;
+    holeCenter(hole, &x, &y);
+
+    if (spritesReady)
+    {
+        TFT_eSprite &sprite = moleUp ? moleSprite : holeSprite;
+        sprite.pushSprite(x - HOLE_SPRITE_CX, y - HOLE_SPRITE_CY);
+        return;
+    }
+
+    M5.Lcd.fillRect(x - HOLE_SPRITE_CX, y - HOLE_SPRITE_CY, HOLE_SPRITE_W, HOLE_SPRITE_H, BOARD_COLOR);
+    if (moleUp)
+        drawMole(M5.Lcd, x, y);
+    else
+        renderHole(M5.Lcd, x, y);
+}
+
+void MoleBoard::drawTurns(int turnsRemaining)
+{
+    // opaque text so the old number is overwritten in place
+    M5.Lcd.setTextSize(2);
+    M5.Lcd.setTextColor(TFT_WHITE, BOARD_COLOR);
+    M5.Lcd.setCursor(10, sHeight - 20);
+    M5.Lcd.printf("Turns Left:  %-2d", turnsRemaining);
+    M5.Lcd.setTextColor(TFT_WHITE);
+    shownTurns = turnsRemaining;
+}
+
+void MoleBoard::renderHole(TFT_eSPI &target, int xCenter, int yCenter)
+{
+    target.fillEllipse(xCenter, yCenter, HOLE_RAD, HOLE_RAD / 2, TFT_MAROON);
+}
+
+void MoleBoard::drawMole(TFT_eSPI &target, int xCenter, int yCenter)
+{
+    renderHole(target, xCenter, yCenter);
+    target.fillRect(xCenter - 15, yCenter - 20, MOLE_WIDTH, MOLE_HEIGHT, TFT_DARKGREY);
+    target.fillRoundRect(xCenter - 15, yCenter - 30, MOLE_WIDTH, MOLE_HEIGHT, 15, TFT_DARKGREY);
+    target.fillTriangle(xCenter - 6, yCenter - 15, xCenter + 6, yCenter - 15, xCenter, yCenter - 29, TFT_LIGHTGREY);
+    target.fillEllipse(xCenter, yCenter - 15, 6, 3, TFT_LIGHTGREY);
+    target.fillCircle(xCenter, yCenter - 27, 2, TFT_MAGENTA);
+    target.fillCircle(xCenter + 10, yCenter - 20, 2, TFT_BLACK);
+    target.fillCircle(xCenter - 10, yCenter - 20, 2, TFT_BLACK);
+    target.drawLine(xCenter - 2, yCenter - 16, xCenter + 2, yCenter - 16, TFT_BLACK);
+}
+
+//////////////////////////////////////////////////////////////////////
+// White rounded die with the pips for the face on a 3x3 grid
+//////////////////////////////////////////////////////////////////////
+void MoleBoard::renderDie(TFT_eSPI &target, int face, int x, int y)
+{
+    const int lo = 17;
+    const int mid = 35;
+    const int hi = 52;
+    const int pipRad = 4;
+
+    target.fillRoundRect(x, y, DIE_SIZE, DIE_SIZE, 10, TFT_WHITE);
+
+    // middle pip on odd faces
+    if (face % 2 == 1)
+        target.fillCircle(x + mid, y + mid, pipRad, TFT_BLACK);
+
+    // top left + bottom right
+    if (face >= 2)
+    {
+        target.fillCircle(x + lo, y + lo, pipRad, TFT_BLACK);
+        target.fillCircle(x + hi, y + hi, pipRad, TFT_BLACK);
+    }
+
+    // top right + bottom left
+    if (face >= 4)
+    {
+        target.fillCircle(x + hi, y + lo, pipRad, TFT_BLACK);
+        target.fillCircle(x + lo, y + hi, pipRad, TFT_BLACK);
+    }
+
+    // middle left + middle right
+    if (face == 6)
+    {
+        target.fillCircle(x + lo, y + mid, pipRad, TFT_BLACK);
+        target.fillCircle(x + hi, y + mid, pipRad, TFT_BLACK);
+    }
+}
@@ -7,6 +7,10 @@
 #include <BLEServer.h>
 #include <BLE2902.h>
 #include <M5Core2.h>
+#include "../include/MoleBoard.h"
+#include "../include/Animation.h"
+#include "../include/Scheduler.h"
+#include "../include/HalNet.h"
 
 ///////////////////////////////////////////////////////////////
 // Variables
@@ -14,6 +18,7 @@
 static BLEServer *bleServer;
 static BLEService *bleService;
 static BLECharacteristic *bleCharacteristic;
+static HalBleLink bleLink; // the rolls go through the characteristic value
 bool deviceConnected = false;
 bool previouslyConnected = false;
 
@@ -22,8 +27,11 @@ int sWidth;
 int sHeight;
 
 // Time variables
-unsigned long lastTime = 0;
 unsigned long timerDelay = 600; // 5000; 5 minutes (300,000ms) or 5 seconds (5,000ms)
+const unsigned long gameTickMs = 20;
+
+// loop() work runs as scheduled tasks
+Scheduler scheduler;
 
 
 // buttons
@@ -41,6 +49,11 @@ int whackerDiceRolls;
 int popperDieRoll;
 
 bool moles[DICE_DIGITS]; // true if mole is up at INDEX
+MoleBoard board;         // sprite renderer for the game screen
+Timeline rollAnimation;  // dice roll shown after this player rolls
+const unsigned long ROLL_FRAME_MS = 80; // tumbling faces
+const int ROLL_FRAMES = 8;
+const unsigned long ROLL_HOLD_MS = 1000; // rolled faces stay up this long
 
 enum Player
 {
@@ -89,7 +102,13 @@ void serverWriteToBLE(int rollToWrite);
 // drawing methods
 void drawDie(int die);
 void drawDice(int die1, int die2);
+void startRollAnimation();
+void playGame();
+void drawRollFrame(int frame);
+void drawRolledFaces(int unused);
+void drawRollFinished(int unused);
 void drawGameDisplay();
+void updateGameDisplay();
 void drawWaitingText();
 void drawRollDie();
 void drawIntroScreen();
@@ -127,6 +146,7 @@ void setup()
     M5.Lcd.setTextSize(3);
     sWidth = M5.Lcd.width();
     sHeight = M5.Lcd.height();
+    board.begin();
 
     M5.Buttons.addHandler(buttonAction, E_TOUCH);
 
@@ -149,12 +169,24 @@ void setup()
     drawScreenTextWithBackground("Initializing BLE...", TFT_CYAN);
     broadcastBleServer();
     drawScreenTextWithBackground("Broadcasting as BLE server named:\n\n" + bleDeviceName, TFT_BLUE);
+
+    // the BLE link stays up, so no light sleep
+    scheduler.every(gameTickMs, playGame);
 }
 
 ///////////////////////////////////////////////////////////////
 // Put your main code here, to run repeatedly
 ///////////////////////////////////////////////////////////////
 void loop()
+{
+    scheduler.run();
+}
+
+///////////////////////////////////////////////////////////////
+// Every gameTickMs: connection, buttons, the other player's
+// moves over BLE and the roll animation
+///////////////////////////////////////////////////////////////
+void playGame()
 {
     // not connected to a device yet
     if (thisDeviceGameState == CONNECTING && !deviceConnected)
@@ -173,6 +205,7 @@ void loop()
     if (deviceConnected)
     {
         M5.update();
+        rollAnimation.update(millis());
 
         // choose your role and join the game!
         if (thisDeviceGameState == SETUP)
@@ -203,11 +236,8 @@ void loop()
                         moleWhack(whackerDiceRolls);
 
                         // update the UI
-                        drawGameDisplay();
-                        drawDice(whackerDiceRolls / 10, whackerDiceRolls % 10);
-                        delay(1000);
-                        drawGameDisplay();
-                        drawWaitingText();
+                        updateGameDisplay();
+                        startRollAnimation();
 
                         // Serial.println("you as the WHACKER rolled a " + String(whackerDiceRolls));
                     }
@@ -225,7 +255,8 @@ void loop()
                     {
                         // popper made a move!
                         molePop(popperDieRoll);
-                        drawGameDisplay();
+                        rollAnimation.finish(); // show our roll before their move
+                        updateGameDisplay();
                         isMyTurn = true;
                         drawRollDie();
                     }
@@ -245,11 +276,8 @@ void loop()
                         molePop(popperDieRoll);
 
                         // update the UI
-                        drawGameDisplay();
-                        drawDie(popperDieRoll);
-                        delay(1000);
-                        drawGameDisplay();
-                        drawWaitingText();
+                        updateGameDisplay();
+                        startRollAnimation();
 
                         // Serial.println("you as the POPPER rolled a " + String(popperDieRoll));
                     }
@@ -266,7 +294,8 @@ void loop()
                     {
                         // whacker made a move!
                         moleWhack(whackerDiceRolls);
-                        drawGameDisplay();
+                        rollAnimation.finish(); // show our roll before their move
+                        updateGameDisplay();
                         isMyTurn = true;
                         drawRollDie();
                     }
@@ -282,7 +311,7 @@ void loop()
                 break;
             }
 
-            if (gameOver())
+            if (gameOver() && !rollAnimation.isRunning())
             {
                 thisDeviceGameState = ENDGAME;
                 drawEndGameScreen();
@@ -296,8 +325,6 @@ void loop()
         thisDeviceGameState = ERROR;
         drawScreenTextWithBackground("uh oh, somebody went too far into the hole. dig again by resetting the device!", RED);
     }
-    
-    lastTime = millis();
 }
 
 void gameSetUp()
@@ -427,9 +454,9 @@ bool gameOver()
 
 int serverReadFromBLE()
 {
-    std::string readValue = bleCharacteristic->getValue();
-    String valStr = readValue.c_str();
-    int val = valStr.toInt();
+    char value[16];
+    bleLink.read(value, sizeof(value));
+    int val = atoi(value);
 
     // Serial.printf("\t%d read from BLE\n", val);
 
@@ -438,8 +465,9 @@ int serverReadFromBLE()
 
 void serverWriteToBLE(int rollToWrite)
 {
-    String newRoll = String(rollToWrite);
-    bleCharacteristic->setValue(newRoll.c_str());
+    char newRoll[16];
+    snprintf(newRoll, sizeof(newRoll), "%d", rollToWrite);
+    bleLink.write(newRoll);
 
     // Serial.printf("\t %d written to BLE\n", newRoll);
     return;
@@ -470,6 +498,7 @@ void broadcastBleServer()
                                                              BLECharacteristic::PROPERTY_NOTIFY |
                                                              BLECharacteristic::PROPERTY_INDICATE);
     bleCharacteristic->setValue("Hello BLE World from Dr. Dan!");
+    bleLink.attach(bleCharacteristic);
     bleService->start();
 
     // Start broadcasting (advertising) BLE service
@@ -485,224 +514,67 @@ void broadcastBleServer()
 
 void drawGameDisplay()
 {
-    // background and text color
-    uint16_t primaryTextColor;
-    M5.Lcd.fillScreen(TFT_DARKGREEN);
-    primaryTextColor = TFT_WHITE;
-
-    // variables
-    int pad = 10;
-    int xOffset = sWidth / 11;
-    int halfXOffset = xOffset / 2;
-    int holeRad = 25;
-    int moleWidth = 30;
-    int moleHeight = 25;
-    int triWidth = sWidth / 11;
-    int vSpace = 10;
-
-    // title
-    M5.Lcd.setCursor(pad, pad);
-    M5.Lcd.setTextColor(primaryTextColor);
-    M5.Lcd.setTextSize(3);
-    M5.Lcd.println(thisDevicePlayer == WHACKER ? "Whacker" : "Popper");
-    M5.Lcd.setTextSize(2);
-    M5.Lcd.setCursor(pad, sHeight - 20);
-    M5.Lcd.println("Turns Left:  " + String(turnsRemaining));
-
-    // draw buttons and numbers
-    for (int i = 0; i < DICE_DIGITS / 2; i++)
-    {
-        xOffset = ((i * 2) + 1) * (sWidth / 9);
-        int yOffset = 80; // offset for the text
-
-        // if(die == i+1){
-        if (moles[i])
-        {
-            M5.Lcd.fillEllipse(xOffset, yOffset, holeRad, holeRad / 2, TFT_MAROON);
-            M5.Lcd.fillRect(xOffset - 15, yOffset - 20, moleWidth, moleHeight, TFT_DARKGREY);
-            M5.Lcd.fillRoundRect(xOffset - 15, yOffset - 30, moleWidth, moleHeight, 15, TFT_DARKGREY);
-            M5.Lcd.fillTriangle(xOffset - 6, yOffset - 15, xOffset + 6, yOffset - 15, xOffset, yOffset - 29, TFT_LIGHTGREY);
-            M5.Lcd.fillEllipse(xOffset, yOffset - 15, 6, 3, TFT_LIGHTGREY);
-            M5.Lcd.fillCircle(xOffset, yOffset - 27, 2, TFT_MAGENTA);
-            M5.Lcd.fillCircle(xOffset + 10, yOffset - 20, 2, TFT_BLACK);
-            M5.Lcd.fillCircle(xOffset - 10, yOffset - 20, 2, TFT_BLACK);
-            M5.Lcd.drawLine(xOffset - 2, yOffset - 16, xOffset + 2, yOffset - 16, TFT_BLACK);
-        }
-        else
-        {
-            // draw the up arrow
-            M5.Lcd.fillEllipse(xOffset, yOffset, holeRad, holeRad / 2, TFT_MAROON);
-        }
-
-        yOffset = (yOffset * 2); //+ vSpace;
+    board.drawFull(thisDevicePlayer == WHACKER ? "Whacker" : "Popper", moles, turnsRemaining);
+}
 
-        // if(die == (i+1)+3){
-        if (moles[i + 3])
-        {
-            M5.Lcd.fillEllipse(xOffset, yOffset, holeRad, holeRad / 2, TFT_MAROON);
-            M5.Lcd.fillRect(xOffset - 15, yOffset - 20, moleWidth, moleHeight, TFT_DARKGREY);
-            M5.Lcd.fillRoundRect(xOffset - 15, yOffset - 30, moleWidth, moleHeight, 15, TFT_DARKGREY);
-            M5.Lcd.fillTriangle(xOffset - 6, yOffset - 15, xOffset + 6, yOffset - 15, xOffset, yOffset - 29, TFT_LIGHTGREY);
-            M5.Lcd.fillEllipse(xOffset, yOffset - 15, 6, 3, TFT_LIGHTGREY);
-            M5.Lcd.fillCircle(xOffset, yOffset - 27, 2, TFT_MAGENTA);
-            M5.Lcd.fillCircle(xOffset + 10, yOffset - 20, 2, TFT_BLACK);
-            M5.Lcd.fillCircle(xOffset - 10, yOffset - 20, 2, TFT_BLACK);
-            M5.Lcd.drawLine(xOffset - 2, yOffset - 16, xOffset + 2, yOffset - 16, TFT_BLACK);
-        }
-        else
-        {
-            // draw the down arrow
-            M5.Lcd.fillEllipse(xOffset, yOffset, holeRad, holeRad / 2, TFT_MAROON);
-        }
-    }
+///////////////////////////////////////////////////////////////
+// Redraw only the holes/turns that changed since the last call
+// and clear the dice and side text
+///////////////////////////////////////////////////////////////
+void updateGameDisplay()
+{
+    board.update(moles, turnsRemaining);
+    board.clearSidebar();
 }
 
 void drawDie(int die)
 {
-
-    switch (die)
-    {
-    case 1:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 75, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 110, 4, TFT_BLACK); // y = 75 + 35
-        break;
-
-    case 2:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 75, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 92, 4, TFT_BLACK);  // left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 127, 4, TFT_BLACK); // right
-        break;
-    case 3:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 75, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 92, 4, TFT_BLACK);  // left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 110, 4, TFT_BLACK); // middle
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 127, 4, TFT_BLACK); // right
-        break;
-    case 4:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 75, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 92, 4, TFT_BLACK);  // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 127, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 92, 4, TFT_BLACK);  // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 127, 4, TFT_BLACK); // bottom left
-        break;
-    case 5:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 75, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 92, 4, TFT_BLACK);  // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 127, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 110, 4, TFT_BLACK); // middle
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 92, 4, TFT_BLACK);  // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 127, 4, TFT_BLACK); // bottom left
-        break;
-    case 6:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 75, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 92, 4, TFT_BLACK);  // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 127, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 109, 4, TFT_BLACK); // middle left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 109, 4, TFT_BLACK); // middle right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 92, 4, TFT_BLACK);  // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 127, 4, TFT_BLACK); // bottom left
-        break;
-    default:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 100, 75, 75, 10, TFT_WHITE);
-        break;
-    }
+    board.drawDie(die, board.sidebarX(), 75);
 }
 
 void drawDice(int die1, int die2)
 {
+    board.drawDie(die1, board.sidebarX(), 25);
+    board.drawDie(die2, board.sidebarX(), 125);
+}
 
-    switch (die1)
-    {
-    case 1:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 25, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 59, 4, TFT_BLACK); // y = 75 + 35
-        break;
-
-    case 2:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 25, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 42, 4, TFT_BLACK); // left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 76, 4, TFT_BLACK); // right
-        break;
-    case 3:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 25, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 42, 4, TFT_BLACK); // left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 59, 4, TFT_BLACK); // middle
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 76, 4, TFT_BLACK); // right
-        break;
-    case 4:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 25, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 42, 4, TFT_BLACK); // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 76, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 42, 4, TFT_BLACK); // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 76, 4, TFT_BLACK); // bottom left
-        break;
-    case 5:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 25, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 42, 4, TFT_BLACK); // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 76, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 59, 4, TFT_BLACK); // middle
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 42, 4, TFT_BLACK); // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 76, 4, TFT_BLACK); // bottom left
-        break;
-    case 6:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 25, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 42, 4, TFT_BLACK); // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 72, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 59, 4, TFT_BLACK); // middle left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 59, 4, TFT_BLACK); // middle right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 42, 4, TFT_BLACK); // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 72, 4, TFT_BLACK); // bottom left
-        break;
-    default:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 25, 70, 70, 10, TFT_WHITE);
-        break;
-    }
-    switch (die2)
+///////////////////////////////////////////////////////////////
+// Queue the roll animation: a few random faces, then the real
+// roll held for a second, then the waiting text. Runs from loop()
+// so BLE reads carry on while the dice tumble.
+///////////////////////////////////////////////////////////////
+void startRollAnimation()
+{
+    rollAnimation.clear();
+    for (int i = 0; i < ROLL_FRAMES; i++)
     {
-    case 1:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 125, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 159, 4, TFT_BLACK); // y = 75 + 35
-        break;
-
-    case 2:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 125, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 142, 4, TFT_BLACK); // left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 176, 4, TFT_BLACK); // right
-        break;
-    case 3:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 125, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 142, 4, TFT_BLACK); // left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 159, 4, TFT_BLACK); // middle
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 176, 4, TFT_BLACK); // right
-        break;
-    case 4:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 125, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 142, 4, TFT_BLACK); // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 176, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 142, 4, TFT_BLACK); // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 176, 4, TFT_BLACK); // bottom left
-        break;
-    case 5:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 125, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 142, 4, TFT_BLACK); // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 176, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 35, 159, 4, TFT_BLACK); // middle
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 142, 4, TFT_BLACK); // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 176, 4, TFT_BLACK); // bottom left
-        break;
-    case 6:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 125, 70, 70, 10, TFT_WHITE);
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 142, 4, TFT_BLACK); // top left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 172, 4, TFT_BLACK); // bottom right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 159, 4, TFT_BLACK); // middle left
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 159, 4, TFT_BLACK); // middle right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 52, 142, 4, TFT_BLACK); // top right
-        M5.Lcd.fillCircle((sWidth * 0.75) + 17, 172, 4, TFT_BLACK); // bottom left
-        break;
-    default:
-        M5.Lcd.fillRoundRect(sWidth * 0.75, 125, 70, 70, 10, TFT_WHITE);
-        break;
+        rollAnimation.add(i * ROLL_FRAME_MS, drawRollFrame, i, true);
     }
+    rollAnimation.add(ROLL_FRAMES * ROLL_FRAME_MS, drawRolledFaces);
+    rollAnimation.add(ROLL_FRAMES * ROLL_FRAME_MS + ROLL_HOLD_MS, drawRollFinished);
+    rollAnimation.start(millis());
+}
+
+void drawRollFrame(int frame)
+{
+    if (thisDevicePlayer == WHACKER)
+        drawDice(dieRoll(), dieRoll());
+    else
+        drawDie(dieRoll());
+}
+
+void drawRolledFaces(int unused)
+{
+    if (thisDevicePlayer == WHACKER)
+        drawDice(whackerDiceRolls / 10, whackerDiceRolls % 10);
+    else
+        drawDie(popperDieRoll);
+}
+
+void drawRollFinished(int unused)
+{
+    board.clearSidebar();
+    drawWaitingText();
 }
 
 void drawWaitingText() {
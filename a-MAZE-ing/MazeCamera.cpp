@@ -0,0 +1,138 @@
+#include "../include/MazeCamera.h"
+
+// ILI9342C commands
+const uint8_t ILI_VSCRDEF = 0x33;  // vertical scrolling definition
+const uint8_t ILI_VSCRSADD = 0x37; // vertical scrolling start address
+
+MazeCamera::MazeCamera(TileDrawer drawer, uint16_t outsideColor)
+    : drawer(drawer), outsideColor(outsideColor), mazeWidth(0), mazeHeight(0), left(0), top(0), scrollOffset(0)
+{
+}
+
+void MazeCamera::begin(int newMazeWidth, int newMazeHeight, int focusCol, int focusRow)
+{
+    mazeWidth = newMazeWidth;
+    mazeHeight = newMazeHeight;
+    left = clampLeft(focusCol - VIEW_COLS / 2);
+    top = clampTop(focusRow - VIEW_ROWS / 2);
+
+#if MAZE_CAMERA_HW_SCROLL
+    // scroll the whole panel: no fixed areas at the top or bottom
+    int lines = VIEW_ROWS * TILE_SIZE;
+    M5.Lcd.writecommand(ILI_VSCRDEF);
+    M5.Lcd.writedata(0);
+    M5.Lcd.writedata(0);
+    M5.Lcd.writedata(lines >> 8);
+    M5.Lcd.writedata(lines & 0xFF);
+    M5.Lcd.writedata(0);
+    M5.Lcd.writedata(0);
+#endif
+    setScroll(0);
+    redrawAll();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Move the view one tile at a time until (col, row) is at least
+// MARGIN tiles from the edge. Rows come in with a hardware scroll
+// and one strip of tiles; columns need the whole view redrawn.
+//////////////////////////////////////////////////////////////////////
+bool MazeCamera::follow(int col, int row)
+{
+    int newLeft = left;
+    if (col < left + MARGIN)
+        newLeft = clampLeft(col - MARGIN);
+    else if (col > left + VIEW_COLS - 1 - MARGIN)
+        newLeft = clampLeft(col - (VIEW_COLS - 1 - MARGIN));
+
+    int newTop = top;
+    if (row < top + MARGIN)
+        newTop = clampTop(row - MARGIN);
+    else if (row > top + VIEW_ROWS - 1 - MARGIN)
+        newTop = clampTop(row - (VIEW_ROWS - 1 - MARGIN));
+
+    if (newLeft == left && newTop == top)
+        return false;
+
+    int lines = VIEW_ROWS * TILE_SIZE;
+    if (!MAZE_CAMERA_HW_SCROLL || newLeft != left || abs(newTop - top) >= VIEW_ROWS)
+    {
+        left = newLeft;
+        top = newTop;
+        redrawAll();
+        return true;
+    }
+
+    while (top < newTop)
+    {
+        // the old top row's frame memory becomes the new bottom row
+        top++;
+        setScroll((scrollOffset + TILE_SIZE) % lines);
+        drawRow(top + VIEW_ROWS - 1);
+    }
+    while (top > newTop)
+    {
+        top--;
+        setScroll((scrollOffset + lines - TILE_SIZE) % lines);
+        drawRow(top);
+    }
+    return true;
+}
+
+void MazeCamera::end()
+{
+    setScroll(0);
+}
+
+void MazeCamera::drawCell(int col, int row)
+{
+    if (!isVisible(col, row))
+        return;
+
+    if (col < 0 || row < 0 || col >= mazeWidth || row >= mazeHeight)
+        M5.Lcd.fillRect(screenX(col), screenY(row), TILE_SIZE, TILE_SIZE, outsideColor);
+    else
+        drawer(col, row, screenX(col), screenY(row));
+}
+
+void MazeCamera::redrawAll()
+{
+    for (int row = top; row < top + VIEW_ROWS; row++)
+    {
+        drawRow(row);
+    }
+}
+
+void MazeCamera::drawRow(int row)
+{
+    for (int col = left; col < left + VIEW_COLS; col++)
+    {
+        drawCell(col, row);
+    }
+}
+
+// Mazes smaller than the view stay in the top-left corner
+int MazeCamera::clampLeft(int value) const
+{
+    int maxLeft = mazeWidth - VIEW_COLS;
+    if (value > maxLeft)
+        value = maxLeft;
+    return value < 0 ? 0 : value;
+}
+
+int MazeCamera::clampTop(int value) const
+{
+    int maxTop = mazeHeight - VIEW_ROWS;
+    if (value > maxTop)
+        value = maxTop;
+    return value < 0 ? 0 : value;
+}
+
+void MazeCamera::setScroll(int offset)
+{
+    scrollOffset = offset;
+#if MAZE_CAMERA_HW_SCROLL
+    M5.Lcd.writecommand(ILI_VSCRSADD);
+    M5.Lcd.writedata(offset >> 8);
+    M5.Lcd.writedata(offset & 0xFF);
+#endif
+}
@@ -0,0 +1,148 @@
+#include "../include/TileAtlas.h"
+
+// Hat sprite background; never used by the hat itself
+const uint16_t HAT_TRANSPARENT = TFT_BLACK;
+
+TileAtlas::TileAtlas() : hatSprite(&M5.Lcd), spritesReady(false), floorColor(TFT_GREENYELLOW), wallColor(TFT_DARKGREEN)
+{
+    for (int i = 0; i < NUM_WALL_CONFIGS * NUM_FLOORS; i++)
+        tiles[i] = nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Render all wall/floor combinations and the hat
+//////////////////////////////////////////////////////////////////////
+void TileAtlas::begin(uint16_t newFloorColor, uint16_t newWallColor)
+{
+    floorColor = newFloorColor;
+    wallColor = newWallColor;
+
+    spritesReady = hatSprite.createSprite(2 * HAT_RADIUS + 1, 2 * HAT_RADIUS + 1) != nullptr;
+    for (int i = 0; i < NUM_WALL_CONFIGS * NUM_FLOORS && spritesReady; i++)
+    {
+        tiles[i] = new TFT_eSprite(&M5.Lcd);
+        spritesReady = tiles[i]->createSprite(TILE_SIZE, TILE_SIZE) != nullptr;
+    }
+
+    if (!spritesReady)
+    {
+        Serial.println("TileAtlas: not enough memory for sprites, drawing primitives");
+        return;
+    }
+
+    for (int floor = 0; floor < NUM_FLOORS; floor++)
+    {
+        for (int walls = 0; walls < NUM_WALL_CONFIGS; walls++)
+        {
+            renderTile(*tiles[floor * NUM_WALL_CONFIGS + walls], 0, 0, walls, floor);
+        }
+    }
+
+    hatSprite.fillSprite(HAT_TRANSPARENT);
+    drawHat(hatSprite, HAT_RADIUS, HAT_RADIUS);
+}
+
+void TileAtlas::drawTile(int x, int y, uint8_t walls, int floor)
+{
+    walls &= NUM_WALL_CONFIGS - 1;
+    if (floor < 0 || floor >= NUM_FLOORS)
+        floor = WALKABLE;
+
+    if (spritesReady)
+        tiles[floor * NUM_WALL_CONFIGS + walls]->pushSprite(x, y);
+    else
+        renderTile(M5.Lcd, x, y, walls, floor);
+}
+
+void TileAtlas::drawHat(int xCenter, int yCenter)
+{
+    if (spritesReady)
+        hatSprite.pushSprite(xCenter - HAT_RADIUS, yCenter - HAT_RADIUS, HAT_TRANSPARENT);
+    else
+        drawHat(M5.Lcd, xCenter, yCenter);
+}
+
+//////////////////////////////////////////////////////////////////////
+// One tile: floor, the walls that are closed, then what sits on the
+// floor. Matches what drawMaze() used to draw for each grid cell.
+//////////////////////////////////////////////////////////////////////
+void TileAtlas::renderTile(TFT_eSPI &target, int x, int y, uint8_t walls, int floor)
+{
+    int xCenter = x + TILE_SIZE / 2;
+    int yCenter = y + TILE_SIZE / 2;
+
+    target.fillRect(x, y, TILE_SIZE, TILE_SIZE, floorColor);
+
+    // draw walls, if there are any
+    if (!(walls & OPEN_LEFT))
+        target.fillRect(x, y, HALF_WALL, TILE_SIZE, wallColor);
+    if (!(walls & OPEN_ABOVE))
+        target.fillRect(x, y, TILE_SIZE, HALF_WALL, wallColor);
+    if (!(walls & OPEN_RIGHT))
+        target.fillRect(x + HALF_WALL + FLOOR_SIZE, y, HALF_WALL, TILE_SIZE, wallColor);
+    if (!(walls & OPEN_BELOW))
+        target.fillRect(x, y + HALF_WALL + FLOOR_SIZE, TILE_SIZE, HALF_WALL, wallColor);
+
+    switch (floor)
+    {
+    case FLOWER:
+        drawFlowerBud(target, xCenter, yCenter, TFT_MAGENTA);
+        break;
+    case ICE:
+        drawIceBlock(target, xCenter, yCenter);
+        break;
+    case BLOOMED:
+        drawFlower(target, xCenter, yCenter, TFT_MAGENTA, TFT_YELLOW);
+        break;
+    case STARTTILE:
+    case END_FLOOR:
+        target.fillRect(x + HALF_WALL, y + HALF_WALL, FLOOR_SIZE, FLOOR_SIZE, target.alphaBlend(128, TFT_PURPLE, TFT_WHITE));
+        target.setTextColor(TFT_WHITE);
+        target.setTextSize(1);
+        if (floor == STARTTILE)
+            target.drawString("Start", x + HALF_WALL, y + HALF_WALL + 11, 1);
+        else
+            target.drawString("End", x + HALF_WALL + 7, y + HALF_WALL + 11, 1);
+        break;
+    default:
+        break;
+    }
+}
+
+void TileAtlas::drawFlower(TFT_eSPI &target, int xCenter, int yCenter, uint32_t petalColor, uint32_t centerColor)
+{
+    target.fillCircle(xCenter, yCenter - 5, 3, petalColor);
+    target.fillCircle(xCenter + 3, yCenter + 5, 3, petalColor);
+    target.fillCircle(xCenter + 5, yCenter - 2, 3, petalColor);
+    target.fillCircle(xCenter - 5, yCenter - 2, 3, petalColor);
+    target.fillCircle(xCenter - 3, yCenter + 5, 3, petalColor);
+    target.fillCircle(xCenter, yCenter, 2, centerColor);
+}
+
+void TileAtlas::drawFlowerBud(TFT_eSPI &target, int xCenter, int yCenter, uint32_t color)
+{
+    target.fillCircle(xCenter, yCenter, 8, TFT_DARKGREEN);
+    target.fillEllipse(xCenter, yCenter - 3, 2, 4, color);
+    target.fillEllipse(xCenter, yCenter + 3, 2, 4, color);
+    target.fillEllipse(xCenter + 3, yCenter, 4, 2, color);
+    target.fillEllipse(xCenter - 3, yCenter, 4, 2, color);
+}
+
+void TileAtlas::drawIceBlock(TFT_eSPI &target, int xCenter, int yCenter)
+{
+    int width = 20;
+    int height = 20;
+    int topLeftCornerX = xCenter - (width / 2);
+    int topRightCornerX = xCenter + (width / 2);
+    int topLeftCornerY = yCenter - (height / 2);
+    target.fillRoundRect(topLeftCornerX, topLeftCornerY, width, height, 2, TFT_CYAN);
+    target.fillCircle(topRightCornerX - 5, topLeftCornerY + 5, 2, TFT_WHITE);
+    target.fillEllipse(topRightCornerX - 5, topLeftCornerY + 12, 2, 4, TFT_WHITE);
+}
+
+void TileAtlas::drawHat(TFT_eSPI &target, int xCenter, int yCenter)
+{
+    target.fillCircle(xCenter, yCenter, HAT_RADIUS, TFT_MAROON);
+    target.fillCircle(xCenter, yCenter, 6, TFT_ORANGE);
+    target.fillCircle(xCenter, yCenter, 5, TFT_MAROON);
+}
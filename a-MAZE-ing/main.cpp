@@ -1,6 +1,19 @@
 #include <M5Core2.h>
+#include <LittleFS.h>
+#include <EEPROM.h>             // tilt calibration
 #include <Adafruit_VCNL4040.h> // Sensor libraries
 #include "Adafruit_SHT4x.h"    // Sensor libraries
+#include "../include/Maze.h"
+#include "../include/MazeLevels.h"
+#include "../include/MazeGrid.h"
+#include "../include/MazeGenerator.h"
+#include "../include/MazeAnalysis.h"
+#include "../include/TileAtlas.h"
+#include "../include/MazeCamera.h"
+#include "../include/HatPhysics.h"
+#include "../include/ImuFifo.h"
+#include "../include/TiltFilter.h"
+#include "../include/Scheduler.h"
 
 // Initialize library objects (sensors and Time protocols)
 Adafruit_VCNL4040 vcnl4040 = Adafruit_VCNL4040();
@@ -11,8 +24,20 @@ int sWidth;  // 320
 int sHeight; // 240
 
 // Time variables
-unsigned long lastTime = 0;
-unsigned long timerDelayMs;
+unsigned long timerDelayMs; // how often the ice/flower sensors are read
+
+// everything in loop() runs from the scheduler
+Scheduler scheduler;
+enum AppEvent
+{
+    EVENT_PHYSICS_TICK,
+    EVENT_TOUCH
+};
+const int touchIntPin = 39;              // FT6336U touch controller INT
+const unsigned long inputPollMs = 20;     // in the maze
+const unsigned long menuInputPollMs = 50; // other screens (light sleep in between)
+int inputTask;
+int sensorTask;
 unsigned long mazeStartTime;
 unsigned long mazeEndTime;
 
@@ -47,40 +72,6 @@ Button bottomRightButton(235, 210, 80, 30, "bottom-right");
 Button bottomLeftButton(0, 210, 160, 30, "bottom-left");
 
 // maze things
-// floor types
-enum FloorType
-{
-    FLOWER,
-    ICE,
-    WALKABLE,
-    BLOOMED,
-    STARTTILE
-};
-
-// floor tile struct
-struct FloorTile
-{
-    int x;
-    int y;
-    // false means there is a wall, true means you can move to this position (no wall!)
-    bool left;
-    bool right;
-    bool above;
-    bool below;
-    FloorType floor;
-
-    FloorTile(int xCoor, int yCoor)
-    {
-        x = xCoor;
-        y = yCoor;
-        left = false;
-        right = false;
-        above = false;
-        below = false;
-        floor = WALKABLE;
-    }
-};
-
 // maze levels
 enum MazeLevel
 {
@@ -93,10 +84,6 @@ static MazeLevel mazeMap = EASY; // default to the easy map
 static MazeLevel mazeSpeed = EASY; // default easy speed
 
 // maze variables
-// maze size
-const int width = 8;
-const int height = 6;
-
 const int halfWall = 5;
 const int floorLength = 30;
 const int floorTileLength = 40;
@@ -104,22 +91,13 @@ const int floorTileLength = 40;
 const uint32_t floorColor = TFT_GREENYELLOW;
 const uint32_t wallColor = TFT_DARKGREEN;
 
-// maze array sample positions FloorType[height][width]
-/**
- * 00 01 02 03
- * 10 11 12 13
- * 20 21 22 23
- * 30 31 32 33
- *
- */
-FloorTile mazeFloorPlan[height][width] = {
-    {FloorTile(0, 0), FloorTile(0, 1), FloorTile(0, 2), FloorTile(0, 3), FloorTile(0, 4), FloorTile(0, 5), FloorTile(0, 6), FloorTile(0, 7)},
-    {FloorTile(1, 0), FloorTile(1, 1), FloorTile(1, 2), FloorTile(1, 3), FloorTile(1, 4), FloorTile(1, 5), FloorTile(1, 6), FloorTile(1, 7)},
-    {FloorTile(2, 0), FloorTile(2, 1), FloorTile(2, 2), FloorTile(2, 3), FloorTile(2, 4), FloorTile(2, 5), FloorTile(2, 6), FloorTile(2, 7)},
-    {FloorTile(3, 0), FloorTile(3, 1), FloorTile(3, 2), FloorTile(3, 3), FloorTile(3, 4), FloorTile(3, 5), FloorTile(3, 6), FloorTile(3, 7)},
-    {FloorTile(4, 0), FloorTile(4, 1), FloorTile(4, 2), FloorTile(4, 3), FloorTile(4, 4), FloorTile(4, 5), FloorTile(4, 6), FloorTile(4, 7)},
-    {FloorTile(5, 0), FloorTile(5, 1), FloorTile(5, 2), FloorTile(5, 3), FloorTile(5, 4), FloorTile(5, 5), FloorTile(5, 6), FloorTile(5, 7)},
-};
+// pre-rendered tiles and hat, and the view onto the maze
+TileAtlas tileAtlas;
+void drawMazeTile(int col, int row, int x, int y);
+MazeCamera camera(drawMazeTile, wallColor);
+
+// the maze: one byte per cell (walls + floor), see MazeGrid.h
+MazeGrid maze;
 
 int startX;
 int startY;
@@ -138,19 +116,72 @@ struct Hat
 
 static Hat hat;
 
+// hat movement: fixed physics steps counted by a hardware timer, the
+// hat is drawn in between at the display rate
+HatPhysics hatPhysics;
+const int physicsHz = 100;
+const unsigned long physicsPeriodUs = 1000000 / physicsHz;
+const uint32_t maxPhysicsCatchUp = 5; // steps run at most per loop()
+const unsigned long frameMs = 16;     // ~60 fps
+hw_timer_t *physicsTimer = nullptr;
+volatile uint32_t physicsTicks = 0;
+volatile unsigned long physicsTickUs = 0;
+uint32_t physicsTicksDone = 0;
+// tilt comes from the IMU FIFO: 500 Hz samples, drained 5 at a time,
+// through the accel + gyro filter
+ImuFifo imuFifo;
+bool imuFifoRunning = false;
+const uint16_t imuSampleHz = 500;
+const uint8_t imuWatermark = 5;
+TiltFilter tiltFilter;
+const float tiltDeadZone = 0.05;     // g
+const float tiltFullScale = 0.6;     // g
+const int tiltCalibrationAddress = 0; // EEPROM
+const unsigned long tiltCalibrationMs = 1000;
+
+int drawnHatX; // maze pixels of the hat on screen
+int drawnHatY;
+
 // maze objective variables
 float iceMeltTemp;
 const int bloomBrightness = 4000;
 int numFlowersToBloom;
 int numFlowersBloomed;
 
+// levels can be replaced from LittleFS
+bool levelFilesMounted = false;
+
+// distance fields for hints and par time, rebuilt for every level
+MazeAnalysis mazeAnalysis;
+const unsigned long hintMs = 1500;       // how long a hint arrow stays up
+const uint32_t hintColor = TFT_MAGENTA;
+const unsigned long flowerParMs = 3000;  // par allowance to bloom a flower
+const unsigned long iceParMs = 10000;    // and to melt an ice block
+bool hintShown = false;
+int hintCol;
+int hintRow;
+int hintTask = Scheduler::NO_TASK;
+unsigned long parTimeMs; // 0 if unknown
+
+// random levels
+MazeGenerator mazeGenerator;
+bool randomMaze = false; // generate the level instead of loading it
+uint32_t mazeSeed = 0;   // 0 picks a new seed every game
+const uint8_t randomMazeWidth[] = {8, 12, 16, 24}; // per MazeLevel
+const uint8_t randomMazeHeight[] = {6, 9, 12, 18};
+const uint8_t randomMazeFlowers[] = {5, 6, 6, 7}; // like the built-in levels
+const uint8_t randomMazeIce[] = {3, 4, 5, 6};
+const uint16_t randomMazeFlowerDistance = 3;
+
 ////////////////////////////////////////////////////////////////////
 // Method header declarations
 ////////////////////////////////////////////////////////////////////
 void onTap(Event &e);
 void onDoubleTap(Event &e);
 void initMazeVariables();
-void makeMazeMap();
+bool loadMazeLevel(MazeLevel level);
+bool generateMazeLevel(MazeLevel level);
+void drawRandomMazeToggle();
 void drawMaze();
 void drawStartScreen();
 void drawLevelButtons();
@@ -159,18 +190,51 @@ void drawFlower(int xCenter, int yCenter, uint32_t petalColor, uint32_t centerCo
 void drawFlowerBud(int xCenter, int yCenter, uint32_t color);
 void drawIceBlock(int xCenter, int yCenter);
 void drawHowToPlayScreen();
-void drawHat(int xCenter, int yCenter);
-int convertCoor(int coor);
+void drawHatOnTile(int col, int row);
+void drawHatAt(int px, int py);
+void eraseHat();
+void updateHatPhysics();
+void drawMovingHat();
+void readTilt(float *accX, float *accY);
+void calibrateTilt();
+void showHint();
+void clearHint();
+void pollInput();
+void drawFrame();
+void checkObstacles();
+void updateLightSleep();
+void startMazeTasks();
+void stopMazeTasks();
+void drawTile(int col, int row);
 void drawTileCover();
 void drawEndTile();
-void drawStartTile();
 void drawSensorScreen();
 
+// Hardware timer tick: count it and let the scheduler run the physics
+void IRAM_ATTR onPhysicsTimer()
+{
+    physicsTicks++;
+    physicsTickUs = micros();
+    scheduler.post(EVENT_PHYSICS_TICK);
+}
+
 void setup()
 {
     // Initialize the device
     M5.begin();
     M5.IMU.Init();
+    imuFifoRunning = imuFifo.begin(imuSampleHz, imuWatermark);
+    if (!imuFifoRunning)
+    {
+        Serial.println("IMU FIFO not available, reading samples one at a time");
+    }
+    // saved tilt calibration (ignored until one has been saved)
+    tiltFilter.setResponse(tiltDeadZone, tiltFullScale);
+    EEPROM.begin(sizeof(TiltCalibration));
+    TiltCalibration savedCalibration;
+    EEPROM.get(tiltCalibrationAddress, savedCalibration);
+    tiltFilter.setCalibration(savedCalibration);
+
     M5.Buttons.addHandler(onTap, E_TOUCH);
     bottomRightButton.addHandler(onDoubleTap, E_DBLTAP);
     M5.Spk.begin();
@@ -196,183 +260,200 @@ void setup()
     sht4.setPrecision(SHT4X_HIGH_PRECISION);
     sht4.setHeater(SHT4X_NO_HEATER);
 
+    // Levels in LittleFS (/levels/<name>.maze) replace the built-in ones
+    levelFilesMounted = LittleFS.begin();
+    if (!levelFilesMounted)
+    {
+        Serial.println("No LittleFS, using the built-in levels");
+    }
+
     // Set up some variables for use in drawing
     sWidth = M5.Lcd.width();
     sHeight = M5.Lcd.height();
+    tileAtlas.begin(floorColor, wallColor);
+
+    // physics tick: 80 MHz APB / 80 = 1 us per timer count. It only
+    // runs in the maze (startMazeTasks)
+    physicsTimer = timerBegin(0, 80, true);
+    timerAttachInterrupt(physicsTimer, &onPhysicsTimer, true);
+    timerAlarmWrite(physicsTimer, physicsPeriodUs, true);
+
+    // seeds typed into the serial monitor are read from a scheduler
+    // task, which mustn't wait for more input
+    Serial.setTimeout(0);
+
+    // tasks and events instead of polling in loop(); on some screens
+    // the chip light-sleeps between polls and a touch wakes it
+    // (updateLightSleep())
+    inputTask = scheduler.every(menuInputPollMs, pollInput);
+    sensorTask = scheduler.every(300, checkObstacles);
+    scheduler.every(frameMs, drawFrame);
+    scheduler.onEvent(EVENT_PHYSICS_TICK, updateHatPhysics);
+    scheduler.onEvent(EVENT_TOUCH, pollInput);
+    scheduler.attachPinEvent(touchIntPin, FALLING, EVENT_TOUCH, true);
 
     screenState = START;
+    updateLightSleep();
 
     drawStartScreen();
 }
 
 void loop()
+{
+    scheduler.run();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Touch and buttons: every inputPollMs, and right away on a touch
+//////////////////////////////////////////////////////////////////////
+void pollInput()
 {
     M5.update();
 
-    if (screenState == MAZE)
+    // a seed typed into the serial monitor makes random mazes repeatable.
+    // The monitor sends the whole line at once and Serial has no
+    // timeout (setup()), so this never waits; the line ending is
+    // trimmed off and anything but digits is ignored
+    if (screenState == START && Serial.available())
+    {
+        String line = Serial.readStringUntil('\n');
+        line.trim();
+        char *end;
+        unsigned long seed = strtoul(line.c_str(), &end, 10);
+        if (line.length() > 0 && isdigit((unsigned char)line[0]) && *end == '\0')
+        {
+            mazeSeed = seed;
+            Serial.printf("Maze seed set to %u\n", mazeSeed);
+        }
+    }
+
+    // calibrate the tilt from the how-to-play screen
+    if (screenState == INSTRUCTIONS && M5.BtnB.wasPressed())
+    {
+        calibrateTilt();
+    }
+
+    //~ ~ ~ ~ ~ ~ ~ ~ ~ ~ hint arrow on B ~ ~ ~ ~ ~ ~ ~ ~ ~ ~
+    if (screenState == MAZE && M5.BtnB.wasPressed())
+    {
+        showHint();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Every frameMs in the maze: draw the hat and check for the finish
+//////////////////////////////////////////////////////////////////////
+void drawFrame()
+{
+    if (screenState != MAZE)
+        return;
+
+    drawMovingHat();
+
+    if (currentX == endX && currentY == endY && numFlowersBloomed >= numFlowersToBloom)
+    {
+        mazeEndTime = millis();
+        screenState = END;
+        stopMazeTasks();
+        camera.end();
+        drawEndScreen();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Every timerDelayMs in the maze: melt ice / bloom flowers under the
+// hat
+//////////////////////////////////////////////////////////////////////
+void checkObstacles()
+{
+    if (screenState != MAZE)
+        return;
+
+    //~ ~ ~ ~ ~ ~ ~ ~ ~ ~ check for ice tile ~ ~ ~ ~ ~ ~ ~ ~ ~ ~
+    if (maze.floor(currentX, currentY) == ICE)
     {
-        if (((millis() - lastTime) > timerDelayMs))
+        sensors_event_t rHum, temp;
+        sht4.getEvent(&rHum, &temp);
+
+        if (iceMeltTemp == 0)
+        {
+            // set the melting temp to 2 C higher than current
+            iceMeltTemp = temp.temperature + 2.0;
+        }
+        else if (temp.temperature >= iceMeltTemp)
+        {
+            // melt the ice!
+            M5.Spk.DingDong();
+            maze.setFloor(currentX, currentY, WALKABLE);
+            drawTileCover();
+            drawHatOnTile(currentX, currentY);
+            // reset the iceMeltTemp to frozen for the next ice tile
+            iceMeltTemp = 0;
+        }
+    }
+    else
+        //~ ~ ~ ~ ~ ~ ~ ~ ~ ~ check for flower tile ~ ~ ~ ~ ~ ~ ~ ~ ~ ~
+        if (maze.floor(currentX, currentY) == FLOWER)
         {
-            //~ ~ ~ ~ ~ ~ ~ ~ ~ ~ check for ice tile ~ ~ ~ ~ ~ ~ ~ ~ ~ ~
-            if (mazeFloorPlan[currentY][currentX].floor == ICE)
+            uint16_t whiteLight = vcnl4040.getWhiteLight();
+
+            if (whiteLight >= bloomBrightness)
             {
-                sensors_event_t rHum, temp;
-                sht4.getEvent(&rHum, &temp);
+                // bloom the flower
+                maze.setFloor(currentX, currentY, BLOOMED);
+                numFlowersBloomed++;
+                M5.Spk.DingDong();
 
-                if (iceMeltTemp == 0)
-                {
-                    // set the melting temp to 2 C higher than current
-                    iceMeltTemp = temp.temperature + 2.0;
-                }
-                else if (temp.temperature >= iceMeltTemp)
+                if (numFlowersBloomed == numFlowersToBloom)
                 {
-                    // melt the ice!
-                    M5.Spk.DingDong();
-                    drawTileCover();
-                    drawHat(convertCoor(currentX), convertCoor(currentY));
-                    mazeFloorPlan[currentY][currentX].floor = WALKABLE;
-                    // reset the iceMeltTemp to frozen for the next ice tile
-                    iceMeltTemp = 0;
+                    drawEndTile();
                 }
             }
-            else
-                //~ ~ ~ ~ ~ ~ ~ ~ ~ ~ check for flower tile ~ ~ ~ ~ ~ ~ ~ ~ ~ ~
-                if (mazeFloorPlan[currentY][currentX].floor == FLOWER)
-                {
-                    uint16_t whiteLight = vcnl4040.getWhiteLight();
-
-                    if (whiteLight >= bloomBrightness)
-                    {
-                        // bloom the flower
-                        mazeFloorPlan[currentY][currentX].floor = BLOOMED;
-                        numFlowersBloomed++;
-                        M5.Spk.DingDong();
-
-                        if (numFlowersBloomed == numFlowersToBloom)
-                        {
-                            drawEndTile();
-                        }
-                    }
-                }
-                else
-                    //~ ~ ~ ~ ~ ~ ~ ~ ~ ~ check for tilting movement ~ ~ ~ ~ ~ ~ ~ ~ ~ ~
-                    if (mazeFloorPlan[currentY][currentX].floor == WALKABLE ||
-                        mazeFloorPlan[currentY][currentX].floor == BLOOMED ||
-                        mazeFloorPlan[currentY][currentX].floor == STARTTILE)
-                    {
-                        float accX; // postive val: tilt to the left    negative val: tilt to the right
-                        float accY; // positive val: tilt down          negative val: tilt up
-                        float accZ; // don't need this data
-                        M5.IMU.getAccelData(&accX, &accY, &accZ);
-                        accX *= 9.8;
-                        accY *= 9.8;
-
-                        // figure out which way the device is tilting the most
-                        if (abs(accX) > 1 || abs(accY) > 1)
-                        { // only if it's tilted at least a little
-                            if (abs(accX) > abs(accY))
-                            {
-                                // tilt left/right
-                                if (accX > 0)
-                                {
-                                    // tilt left
-                                    if (mazeFloorPlan[currentY][currentX].left)
-                                    {
-                                        // draw tile over current hat position
-                                        drawTileCover();
-
-                                        // move the hat to the left
-                                        hat.x = hat.x - 1;
-                                        // update the current tile
-                                        currentX -= 1;
-
-                                        // draw the hat in its new position
-                                        drawHat(convertCoor(hat.x), convertCoor(hat.y));
-                                    }
-                                }
-                                else
-                                {
-                                    // tilt right
-                                    if (mazeFloorPlan[currentY][currentX].right)
-                                    {
-                                        // draw tile over current hat position
-                                        drawTileCover();
-
-                                        // move the hat to the right
-                                        hat.x = hat.x + 1;
-                                        // update the current tile
-                                        currentX += 1;
-
-                                        // draw the hat in its new position
-                                        drawHat(convertCoor(hat.x), convertCoor(hat.y));
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                // tilt up/down
-                                if (accY > 0)
-                                {
-                                    // tilt down
-                                    if (mazeFloorPlan[currentY][currentX].below)
-                                    {
-                                        // draw tile over current hat position
-                                        drawTileCover();
-
-                                        // move the hat down
-                                        hat.y = hat.y + 1;
-                                        // update the current tile
-                                        currentY += 1;
-
-                                        // draw the hat in its new position
-                                        drawHat(convertCoor(hat.x), convertCoor(hat.y));
-                                    }
-                                }
-                                else
-                                {
-                                    // tilt up
-                                    if (mazeFloorPlan[currentY][currentX].above)
-                                    {
-                                        // draw tile over current hat position
-                                        drawTileCover();
-
-                                        // move the hat up
-                                        hat.y = hat.y - 1;
-                                        // update the current tile
-                                        currentY -= 1;
-
-                                        // draw the hat in its new position
-                                        drawHat(convertCoor(hat.x), convertCoor(hat.y));
-                                    }
-                                }
-                            }
-                        }
-                        // Delay: Update the last time to NOW
-                        lastTime = millis();
-                    }
         }
+}
 
-        if (currentX == endX && currentY == endY && numFlowersBloomed >= numFlowersToBloom)
-        {
-            mazeEndTime = millis();
-            screenState = END;
-            drawEndScreen();
-        }
-    }
+//////////////////////////////////////////////////////////////////////
+// Light sleep between polls on the how-to-play and end screens. Not on
+// the start screen: the UART doesn't receive while the chip sleeps, and
+// seeds are typed there (pollInput()). Not in the maze either, where
+// the physics timer has to keep going.
+//////////////////////////////////////////////////////////////////////
+void updateLightSleep()
+{
+    scheduler.setLightSleep(screenState == INSTRUCTIONS || screenState == END);
 }
 
-void initMazeVariables()
+//////////////////////////////////////////////////////////////////////
+// Entering/leaving the maze: the physics timer and fast input polling
+// only run in the maze
+//////////////////////////////////////////////////////////////////////
+void startMazeTasks()
 {
-    // set up the maze walls
-    makeMazeMap();
+    scheduler.setPeriod(sensorTask, timerDelayMs);
+    scheduler.setPeriod(inputTask, inputPollMs);
+    updateLightSleep();
+    physicsTicksDone = physicsTicks;
+    timerAlarmEnable(physicsTimer);
+}
 
-    // Set up the starting and ending tiles of the maze
-    startX = 3;
-    startY = 0;
-    mazeFloorPlan[startY][startX].floor = STARTTILE;
+void stopMazeTasks()
+{
+    timerAlarmDisable(physicsTimer);
+    clearHint();
+    scheduler.setPeriod(inputTask, menuInputPollMs);
+    updateLightSleep();
+}
 
-    endX = 4;
-    endY = 5;
+void initMazeVariables()
+{
+    // set up the maze walls, floors, start/end and flower count
+    bool loaded = randomMaze ? generateMazeLevel(mazeMap) : loadMazeLevel(mazeMap);
+    if (!loaded)
+    {
+        loadMazeLevel(EASY);
+    }
+    maze.setFloor(startX, startY, STARTTILE);
+    hintShown = false;
 
     // Set up the hat at the starting point
     hat.x = startX;
@@ -380,7 +461,7 @@ void initMazeVariables()
 
     // set the current x and y values at the starting point
     currentX = startX;
-    currentY = currentY;
+    currentY = startY;
 
     // set the maze speed
     switch (mazeSpeed)
@@ -402,25 +483,29 @@ void initMazeVariables()
         break;
     }
 
-    // set the number of flowers to bloom 
-    switch (mazeMap)
+    // at full tilt the hat still crosses about a tile per timerDelayMs,
+    // and gets to that speed in about a third of a second
+    q16 maxSpeed = (q16)(((int64_t)floorTileLength << 16) * 1000 / ((int64_t)timerDelayMs * physicsHz));
+    hatPhysics.setTuning(maxSpeed, maxSpeed / 16, Q16_ONE / 32);
+    hatPhysics.reset(startX, startY);
+
+    // par: the shortest route at full speed, plus time for each flower
+    // and ice block
+    parTimeMs = 0;
+    if (mazeAnalysis.parSteps() != MazeAnalysis::UNREACHABLE)
     {
-    case EASY:
-        numFlowersToBloom = 5;
-        break;
-    case MEDIUM:
-        numFlowersToBloom = 6; 
-        break;
-    case HARD:
-        numFlowersToBloom = 6;
-        break;
-    case EXTREME:
-        numFlowersToBloom = 7;
-        break;
-    default:
-        numFlowersToBloom = 5;
-        break;
+        int iceTiles = 0;
+        for (int row = 0; row < maze.height(); row++)
+        {
+            for (int col = 0; col < maze.width(); col++)
+            {
+                if (maze.floor(col, row) == ICE)
+                    iceTiles++;
+            }
+        }
+        parTimeMs = mazeAnalysis.parSteps() * timerDelayMs + numFlowersToBloom * flowerParMs + iceTiles * iceParMs;
     }
+    physicsTicksDone = physicsTicks; // don't catch up on ticks from the menus
 
     // set maze objective variables to default
     iceMeltTemp = 0;
@@ -431,50 +516,8 @@ void initMazeVariables()
 
 void drawMaze()
 {
-    M5.Lcd.clear(floorColor);
-
-    for (int row = 0; row < height; row++)
-    {
-        for (int col = 0; col < width; col++)
-        {
-
-            // draw walls, if there are any
-            if (!mazeFloorPlan[row][col].left)
-            {
-                M5.Lcd.fillRect(col * floorTileLength, row * floorTileLength, halfWall, floorTileLength, wallColor);
-            }
-            if (!mazeFloorPlan[row][col].above)
-            {
-                M5.Lcd.fillRect(col * floorTileLength, row * floorTileLength, floorTileLength, halfWall, wallColor);
-            }
-            if (!mazeFloorPlan[row][col].right)
-            {
-                M5.Lcd.fillRect((col * floorTileLength) + halfWall + floorLength, row * floorTileLength, halfWall, floorTileLength, wallColor);
-            }
-            if (!mazeFloorPlan[row][col].below)
-            {
-                M5.Lcd.fillRect(col * floorTileLength, (row * floorTileLength) + halfWall + floorLength, floorTileLength, halfWall, wallColor);
-            }
-
-            // draw start tile, if applicable
-            if (mazeFloorPlan[row][col].floor == STARTTILE)
-            {
-                drawStartTile();
-            }
-
-            // draw flower bud tiles, if applicable
-            if (mazeFloorPlan[row][col].floor == FLOWER)
-            {
-                drawFlowerBud(convertCoor(col), convertCoor(row), TFT_MAGENTA);
-            }
-
-            // draw ice tiles, if applicable
-            if (mazeFloorPlan[row][col].floor == ICE)
-            {
-                drawIceBlock(convertCoor(col), convertCoor(row));
-            }
-        }
-    }
+    // only the part of the maze around the hat is drawn
+    camera.begin(maze.width(), maze.height(), hat.x, hat.y);
 }
 
 void drawStartScreen()
@@ -501,6 +544,7 @@ void drawStartScreen()
     M5.Lcd.print("how to play");
 
     drawLevelButtons();
+    drawRandomMazeToggle();
 }
 
 void drawLevelButtons()
@@ -524,6 +568,14 @@ void drawLevelButtons()
     M5.Lcd.print("Extreme");
 }
 
+void drawRandomMazeToggle()
+{
+    M5.Lcd.setCursor(10, 225);
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setTextColor(randomMaze ? buttonSelectedColor : buttonUnselectedColor, TFT_BLACK);
+    M5.Lcd.print(randomMaze ? "random maze: on " : "random maze: off");
+}
+
 void drawHowToPlayScreen()
 {
     M5.Lcd.clear(TFT_BLACK);
@@ -560,6 +612,9 @@ void drawHowToPlayScreen()
     M5.Lcd.setTextSize(1);
     M5.Lcd.setTextColor(TFT_MAGENTA);
     M5.Lcd.print("back to start");
+
+    M5.Lcd.setCursor(200, 30);
+    M5.Lcd.print("B: calibrate tilt");
 }
 
 void drawEndScreen()
@@ -597,88 +652,285 @@ void drawEndScreen()
     else if (mazeMap == EXTREME) mapLevel += "Extreme";
     M5.Lcd.println(mapLevel);
 
+    if (parTimeMs > 0)
+    {
+        M5.Lcd.setCursor(sWidth / 5 + 15, (sHeight / 2) + 50);
+        unsigned long parSeconds = (parTimeMs + 999) / 1000;
+        String par = "Par: " + (String)(parSeconds / 60) + ":";
+        if (parSeconds % 60 < 10)
+            par += "0";
+        par += (String)(parSeconds % 60);
+        if (mazeEndTime - mazeStartTime <= parTimeMs)
+        {
+            M5.Lcd.setTextColor(TFT_YELLOW);
+            par += " beat it!";
+        }
+        M5.Lcd.println(par);
+    }
+
     M5.Lcd.setCursor(130, 220);
     M5.Lcd.setTextColor(TFT_MAGENTA);
     M5.Lcd.print("Exit");
 }
 void drawFlower(int xCenter, int yCenter, uint32_t petalColor, uint32_t centerColor)
 {
-    M5.Lcd.fillCircle(xCenter, yCenter - 5, 3, petalColor);
-    M5.Lcd.fillCircle(xCenter + 3, yCenter + 5, 3, petalColor);
-    M5.Lcd.fillCircle(xCenter + 5, yCenter - 2, 3, petalColor);
-    M5.Lcd.fillCircle(xCenter - 5, yCenter - 2, 3, petalColor);
-    M5.Lcd.fillCircle(xCenter - 3, yCenter + 5, 3, petalColor);
-    M5.Lcd.fillCircle(xCenter, yCenter, 2, centerColor);
+    TileAtlas::drawFlower(M5.Lcd, xCenter, yCenter, petalColor, centerColor);
 }
 
 void drawFlowerBud(int xCenter, int yCenter, uint32_t color)
 {
-    M5.Lcd.fillCircle(xCenter, yCenter, 8, TFT_DARKGREEN);
-    M5.Lcd.fillEllipse(xCenter, yCenter - 3, 2, 4, color);
-    M5.Lcd.fillEllipse(xCenter, yCenter + 3, 2, 4, color);
-    M5.Lcd.fillEllipse(xCenter + 3, yCenter, 4, 2, color);
-    M5.Lcd.fillEllipse(xCenter - 3, yCenter, 4, 2, color);
+    TileAtlas::drawFlowerBud(M5.Lcd, xCenter, yCenter, color);
 }
 
 void drawIceBlock(int xCenter, int yCenter)
 {
-    int width = 20;
-    int height = 20;
-    int topLeftCornerX = xCenter - (width / 2);
-    int topRightCornerX = xCenter + (width / 2);
-    int topLeftCornerY = yCenter - (height / 2);
-    int topRightCornerY = yCenter + (height / 2);
-    M5.Lcd.fillRoundRect(topLeftCornerX, topLeftCornerY, width, height, 2, TFT_CYAN);
-    M5.Lcd.fillCircle(topRightCornerX - 5, topLeftCornerY + 5, 2, TFT_WHITE);
-    M5.Lcd.fillEllipse(topRightCornerX - 5, topLeftCornerY + 12, 2, 4, TFT_WHITE);
+    TileAtlas::drawIceBlock(M5.Lcd, xCenter, yCenter);
+}
+
+// Draw the hat in the middle of a maze cell
+void drawHatOnTile(int col, int row)
+{
+    drawHatAt(col * floorTileLength + floorTileLength / 2, row * floorTileLength + floorTileLength / 2);
 }
 
-void drawHat(int xCenter, int yCenter)
+//////////////////////////////////////////////////////////////////////
+// Draw the hat centred on maze pixel (px, py), scrolling first if its
+// cell is near the edge of the view. While the view is scrolled the
+// frame memory wraps, so a hat over the wrap line is drawn twice and
+// each copy is clipped to its half.
+//////////////////////////////////////////////////////////////////////
+void drawHatAt(int px, int py)
 {
-    M5.Lcd.fillCircle(xCenter, yCenter, 10, TFT_MAROON);
-    M5.Lcd.fillCircle(xCenter, yCenter, 6, TFT_ORANGE);
-    M5.Lcd.fillCircle(xCenter, yCenter, 5, TFT_MAROON);
+    int col = px / floorTileLength;
+    int row = py / floorTileLength;
+    camera.follow(col, row);
+
+    int x = camera.screenX(col) + px - col * floorTileLength;
+    int y = camera.screenY(row) + py - row * floorTileLength;
+    int lines = MazeCamera::VIEW_ROWS * MazeCamera::TILE_SIZE;
+    tileAtlas.drawHat(x, y);
+    if (y + TileAtlas::HAT_RADIUS >= lines)
+    {
+        tileAtlas.drawHat(x, y - lines);
+    }
+    else if (y - TileAtlas::HAT_RADIUS < 0)
+    {
+        tileAtlas.drawHat(x, y + lines);
+    }
+
+    drawnHatX = px;
+    drawnHatY = py;
 }
 
-int convertCoor(int coor)
+// Redraw the tiles under the hat (up to 4 while it is between cells)
+void eraseHat()
 {
-    return (coor * 40) + 20;
+    int r = TileAtlas::HAT_RADIUS;
+    for (int row = (drawnHatY - r) / floorTileLength; row <= (drawnHatY + r) / floorTileLength; row++)
+    {
+        for (int col = (drawnHatX - r) / floorTileLength; col <= (drawnHatX + r) / floorTileLength; col++)
+        {
+            drawTile(col, row);
+        }
+    }
 }
 
-void drawTileCover()
+//////////////////////////////////////////////////////////////////////
+// Run the physics steps the timer has counted since the last call.
+// The IMU is read once per call, not once per step. After a long
+// stall only a few steps are run so the hat doesn't jump.
+//////////////////////////////////////////////////////////////////////
+void updateHatPhysics()
 {
-    int topLeftCornerX = (currentX * floorTileLength + (floorTileLength / 2)) - (floorLength / 2);
-    int topLeftCornerY = (currentY * floorTileLength + (floorTileLength / 2)) - (floorLength / 2);
-    M5.Lcd.fillRect(topLeftCornerX, topLeftCornerY, floorLength, floorLength, floorColor);
+    if (screenState != MAZE)
+        return;
 
-    if (mazeFloorPlan[currentY][currentX].floor == BLOOMED)
+    uint32_t ticks = physicsTicks;
+    uint32_t pending = ticks - physicsTicksDone;
+    if (pending == 0)
     {
-        drawFlower(convertCoor(currentX), convertCoor(currentY), TFT_MAGENTA, TFT_YELLOW);
+        return;
     }
-    else if (mazeFloorPlan[currentY][currentX].floor == STARTTILE)
+    physicsTicksDone = ticks;
+    if (pending > maxPhysicsCatchUp)
     {
-        drawStartTile();
+        pending = maxPhysicsCatchUp;
     }
+
+    float accX; // postive val: tilt to the left    negative val: tilt to the right
+    float accY; // positive val: tilt down          negative val: tilt up
+    readTilt(&accX, &accY);
+    q16 tiltX = floatToQ16(-accX);
+    q16 tiltY = floatToQ16(accY);
+
+    for (uint32_t i = 0; i < pending; i++)
+    {
+        hatPhysics.step(maze, tiltX, tiltY);
+    }
+
+    // the tile the hat is on drives the ice/flower/end checks
+    hat.x = currentX = hatPhysics.col();
+    hat.y = currentY = hatPhysics.row();
 }
 
-void drawEndTile()
+//////////////////////////////////////////////////////////////////////
+// Point an arrow from the hat's tile into the next tile on the way to
+// the nearest flower bud (or the end once enough have bloomed). The
+// arrow is cleared after hintMs, or sooner if the hat moves over it.
+//////////////////////////////////////////////////////////////////////
+void showHint()
 {
-    int topLeftCornerX = (endX * floorTileLength + (floorTileLength / 2)) - (floorLength / 2);
-    int topLeftCornerY = (endY * floorTileLength + (floorTileLength / 2)) - (floorLength / 2);
-    M5.Lcd.fillRect(topLeftCornerX, topLeftCornerY, floorLength, floorLength, M5.Lcd.alphaBlend(128, TFT_PURPLE, TFT_WHITE));
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.setTextColor(TFT_WHITE);
-    M5.Lcd.drawString("End", (endX * floorTileLength) + halfWall + 7, (endY * floorTileLength) + halfWall + 11, 1);
+    clearHint();
+    uint8_t dir = mazeAnalysis.hint(maze, currentX, currentY, numFlowersBloomed < numFlowersToBloom);
+    if (dir == 0)
+        return;
+
+    hintCol = currentX + MazeGrid::dx(dir);
+    hintRow = currentY + MazeGrid::dy(dir);
+    if (!camera.isVisible(hintCol, hintRow))
+        return;
+
+    int x = camera.screenX(hintCol) + floorTileLength / 2;
+    int y = camera.screenY(hintRow) + floorTileLength / 2;
+    int dx = MazeGrid::dx(dir);
+    int dy = MazeGrid::dy(dir);
+    const int size = 8;
+    M5.Lcd.fillTriangle(x + dx * size, y + dy * size,
+                        x - dx * size + dy * size, y - dy * size + dx * size,
+                        x - dx * size - dy * size, y - dy * size - dx * size, hintColor);
+    hintShown = true;
+    hintTask = scheduler.after(hintMs, clearHint);
 }
 
-void drawStartTile()
+void clearHint()
 {
-    int topLeftCornerX = (startX * floorTileLength + (floorTileLength / 2)) - (floorLength / 2);
-    int topLeftCornerY = (startY * floorTileLength + (floorTileLength / 2)) - (floorLength / 2);
-    M5.Lcd.fillRect(topLeftCornerX, topLeftCornerY, floorLength, floorLength, M5.Lcd.alphaBlend(128, TFT_PURPLE, TFT_WHITE));
-    M5.Lcd.setTextColor(TFT_WHITE);
+    scheduler.cancel(hintTask);
+    hintTask = Scheduler::NO_TASK;
+    if (hintShown)
+    {
+        hintShown = false;
+        drawTile(hintCol, hintRow);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Tilt in g after the dead zone and response curve: every new FIFO
+// sample goes through the tilt filter. Without the FIFO it's a single
+// accelerometer read.
+//////////////////////////////////////////////////////////////////////
+void readTilt(float *accX, float *accY)
+{
+    if (!imuFifoRunning)
+    {
+        float accZ; // don't need this data
+        M5.IMU.getAccelData(accX, accY, &accZ);
+        *accX = tiltFilter.response(*accX);
+        *accY = tiltFilter.response(*accY);
+        return;
+    }
+
+    imuFifo.poll();
+    float dt = imuFifo.samplePeriodUs() / 1000000.0;
+    ImuSample sample;
+    while (imuFifo.read(&sample))
+    {
+        tiltFilter.update(sample, dt);
+    }
+    *accX = tiltFilter.tiltX();
+    *accY = tiltFilter.tiltY();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Average a second of samples with the device lying flat and still,
+// and save the offsets to EEPROM
+//////////////////////////////////////////////////////////////////////
+void calibrateTilt()
+{
+    M5.Lcd.setCursor(200, 30);
     M5.Lcd.setTextSize(1);
-    M5.Lcd.drawString("Start", (startX * floorTileLength) + halfWall, (startY * floorTileLength) + halfWall + 11, 1);
+    M5.Lcd.setTextColor(TFT_YELLOW, TFT_BLACK);
+    if (!imuFifoRunning)
+    {
+        M5.Lcd.print("no IMU FIFO      ");
+        return;
+    }
+    M5.Lcd.print("calibrating...   ");
+
+    ImuSample sample;
+    while (imuFifo.read(&sample))
+        ; // throw away anything from before
+    tiltFilter.beginCalibration();
+    unsigned long start = millis();
+    while (millis() - start < tiltCalibrationMs)
+    {
+        imuFifo.poll();
+        while (imuFifo.read(&sample))
+        {
+            tiltFilter.addCalibrationSample(sample);
+        }
+        delay(5);
+    }
+
+    M5.Lcd.setCursor(200, 30);
+    if (tiltFilter.finishCalibration())
+    {
+        EEPROM.put(tiltCalibrationAddress, tiltFilter.calibration());
+        EEPROM.commit();
+        M5.Lcd.print("calibrated!      ");
+    }
+    else
+    {
+        M5.Lcd.print("calibration failed");
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Draw the hat where it is between the last two physics steps, at
+// most once per frame and only if it moved a pixel
+//////////////////////////////////////////////////////////////////////
+void drawMovingHat()
+{
+    q16 alpha = (q16)(((int64_t)(micros() - physicsTickUs) << 16) / physicsPeriodUs);
+    int px;
+    int py;
+    hatPhysics.interpolate(alpha, &px, &py);
+    if (px == drawnHatX && py == drawnHatY)
+    {
+        return;
+    }
+
+    eraseHat();
+    drawHatAt(px, py);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Blit the atlas tile for maze cell (col, row) at (x, y); the end
+// tile shows once all the flowers have bloomed
+//////////////////////////////////////////////////////////////////////
+void drawMazeTile(int col, int row, int x, int y)
+{
+    int floor = maze.floor(col, row);
+    if (col == endX && row == endY && numFlowersBloomed >= numFlowersToBloom)
+    {
+        floor = TileAtlas::END_FLOOR;
+    }
+    tileAtlas.drawTile(x, y, maze.openings(col, row), floor);
+}
+
+// Redraw a maze cell if it is on screen
+void drawTile(int col, int row)
+{
+    camera.drawCell(col, row);
+}
+
+void drawTileCover()
+{
+    drawTile(currentX, currentY);
+}
+
+void drawEndTile()
+{
+    drawTile(endX, endY);
 }
 
 void onTap(Event &e)
@@ -710,18 +962,25 @@ void onTap(Event &e)
 
         drawLevelButtons();
 
+        if (b.instanceIndex() == 10) {
+            // bottom left button
+            randomMaze = !randomMaze;
+            drawRandomMazeToggle();
+        }
         if (b.instanceIndex() == 8) {
             // start button
             initMazeVariables();
             drawMaze();
-            drawHat(convertCoor(hat.x), convertCoor(hat.y));
+            drawHatOnTile(hat.x, hat.y);
             screenState = MAZE;
+            startMazeTasks();
             Serial.println(timerDelayMs);
         }
         if (b.instanceIndex() == 9) {
             // bottom right button
             drawHowToPlayScreen();
             screenState = INSTRUCTIONS;
+            updateLightSleep();
         }
     }
 
@@ -740,6 +999,7 @@ void onDoubleTap(Event& e) {
         // go back to start screen
         drawStartScreen();
         screenState = START;
+        updateLightSleep();
         
     }
 }
@@ -764,661 +1024,94 @@ void drawSensorScreen(){
     M5.Lcd.fillEllipse(sWidth-15, sHeight-15, 6, 2, TFT_CYAN);
 }
 
-void makeMazeMap()
+//////////////////////////////////////////////////////////////////////
+// Read /levels/<name>.maze from LittleFS into buffer. Returns the
+// number of bytes read, or 0 if there is no such file.
+//////////////////////////////////////////////////////////////////////
+size_t readMazeFile(const char *name, uint8_t *buffer, size_t size)
 {
-    if (mazeMap == EASY) {
-        // row 1
-        mazeFloorPlan[0][0].right = true;
-
-        mazeFloorPlan[0][1].left = true;
-        mazeFloorPlan[0][1].right = true;
-        mazeFloorPlan[0][1].below = true;
-
-        mazeFloorPlan[0][2].left = true;
-        mazeFloorPlan[0][2].below = true;
-
-        mazeFloorPlan[0][3].below = true;
-
-        mazeFloorPlan[0][4].right = true;
-        mazeFloorPlan[0][4].below = true;
-
-        mazeFloorPlan[0][5].left = true;
-        mazeFloorPlan[0][5].right = true;
-
-        mazeFloorPlan[0][6].left = true;
-        mazeFloorPlan[0][6].below = true;
-
-        mazeFloorPlan[0][7].below = true;
-
-        // row 2
-        mazeFloorPlan[1][0].right = true;
-        mazeFloorPlan[1][0].below = true;
-
-        mazeFloorPlan[1][1].above = true;
-        mazeFloorPlan[1][1].left = true;
-
-        mazeFloorPlan[1][2].above = true;
-        mazeFloorPlan[1][2].below = true;
-
-        mazeFloorPlan[1][3].above = true;
-        mazeFloorPlan[1][3].below = true;
-
-        mazeFloorPlan[1][4].above = true;
-        mazeFloorPlan[1][4].right = true;
-
-        mazeFloorPlan[1][5].left = true;
-        mazeFloorPlan[1][5].below = true;
-
-        mazeFloorPlan[1][6].above = true;
-        mazeFloorPlan[1][6].below = true;
-
-        mazeFloorPlan[1][7].above = true;
-        mazeFloorPlan[1][7].below = true;
-
-        // row 3
-        mazeFloorPlan[2][0].above = true;
-        mazeFloorPlan[2][0].right = true;
-
-        mazeFloorPlan[2][1].left = true;
-        mazeFloorPlan[2][1].below = true;
-
-        mazeFloorPlan[2][2].above = true;
-        mazeFloorPlan[2][2].below = true;
-
-        mazeFloorPlan[2][3].above = true;
-        mazeFloorPlan[2][3].right = true;
-
-        mazeFloorPlan[2][4].left = true;
-        mazeFloorPlan[2][4].right = true;
-
-        mazeFloorPlan[2][5].left = true;
-        mazeFloorPlan[2][5].above = true;
-
-        mazeFloorPlan[2][6].above = true;
-        mazeFloorPlan[2][6].right = true;
-        mazeFloorPlan[2][6].below = true;
-
-        mazeFloorPlan[2][7].left = true;
-        mazeFloorPlan[2][7].above = true;
-
-        // row 4
-        mazeFloorPlan[3][0].below = true;
-
-        mazeFloorPlan[3][1].above = true;
-        mazeFloorPlan[3][1].below = true;
-
-        mazeFloorPlan[3][2].above = true;
-        mazeFloorPlan[3][2].right = true;
-
-        mazeFloorPlan[3][3].left = true;
-        mazeFloorPlan[3][3].right = true;
-
-        mazeFloorPlan[3][4].left = true;
-        mazeFloorPlan[3][4].right = true;
-
-        mazeFloorPlan[3][5].left = true;
-        mazeFloorPlan[3][5].right = true;
-        mazeFloorPlan[3][5].below = true;
-
-        mazeFloorPlan[3][6].left = true;
-        mazeFloorPlan[3][6].right = true;
-        mazeFloorPlan[3][6].above = true;
-
-        mazeFloorPlan[3][7].left = true;
-
-        // row 5
-        mazeFloorPlan[4][0].above = true;
-        mazeFloorPlan[4][0].below = true;
-
-        mazeFloorPlan[4][1].above = true;
-        mazeFloorPlan[4][1].below = true;
-        mazeFloorPlan[4][1].right = true;
-
-        mazeFloorPlan[4][2].left = true;
-        mazeFloorPlan[4][2].below = true;
-
-        mazeFloorPlan[4][3].right = true;
-
-        mazeFloorPlan[4][4].left = true;
-        mazeFloorPlan[4][4].below = true;
-
-        mazeFloorPlan[4][5].above = true;
-        mazeFloorPlan[4][5].below = true;
-
-        mazeFloorPlan[4][6].below = true;
-        mazeFloorPlan[4][6].right = true;
-
-        mazeFloorPlan[4][7].below = true;
-        mazeFloorPlan[4][7].left = true;
-
-        // row 6
-        mazeFloorPlan[5][0].above = true;
-        mazeFloorPlan[5][0].right = true;
-
-        mazeFloorPlan[5][1].left = true;
-        mazeFloorPlan[5][1].above = true;
-
-        mazeFloorPlan[5][2].right = true;
-        mazeFloorPlan[5][2].above = true;
-
-        mazeFloorPlan[5][3].left = true;
-        mazeFloorPlan[5][3].right = true;
-
-        mazeFloorPlan[5][4].left = true;
-        mazeFloorPlan[5][4].above = true;
-
-        mazeFloorPlan[5][5].above = true;
-        mazeFloorPlan[5][5].right = true;
-
-        mazeFloorPlan[5][6].left = true;
-        mazeFloorPlan[5][6].above = true;
-
-        mazeFloorPlan[5][7].above = true;
-
-        // FLOWERS
-        mazeFloorPlan[0][0].floor = FLOWER;
-        mazeFloorPlan[0][7].floor = FLOWER;
-        mazeFloorPlan[4][0].floor = FLOWER;
-        mazeFloorPlan[4][3].floor = FLOWER;
-        mazeFloorPlan[5][7].floor = FLOWER;
-
-        // ICE
-        mazeFloorPlan[0][4].floor = ICE;
-        mazeFloorPlan[5][5].floor = ICE;
-        mazeFloorPlan[3][1].floor = ICE;
-
-    } else if (mazeMap == MEDIUM) {
-        // row 1
-        mazeFloorPlan[0][0].right = true;
-        mazeFloorPlan[0][0].below = true;
-
-        mazeFloorPlan[0][1].below = true;
-        mazeFloorPlan[0][1].left = true;
-        mazeFloorPlan[0][1].right = true;
-
-        mazeFloorPlan[0][2].left = true;
-
-        mazeFloorPlan[0][3].below = true;
-
-        mazeFloorPlan[0][4].right = true;
-
-        mazeFloorPlan[0][5].right = true;
-        mazeFloorPlan[0][5].left = true;
-
-        mazeFloorPlan[0][6].right = true;
-        mazeFloorPlan[0][6].left = true;
-        mazeFloorPlan[0][6].below = true;
-
-        mazeFloorPlan[0][7].below = true;
-        mazeFloorPlan[0][7].left = true;
-
-        // row 2
-        mazeFloorPlan[1][0].above = true;
-        mazeFloorPlan[1][0].below = true;
-
-        mazeFloorPlan[1][1].above = true;
-        mazeFloorPlan[1][1].below = true;
-
-        mazeFloorPlan[1][2].below = true;
-        mazeFloorPlan[1][2].right = true;
-
-        mazeFloorPlan[1][3].above = true;
-        mazeFloorPlan[1][3].left = true;
-
-        mazeFloorPlan[1][4].right = true;
-        mazeFloorPlan[1][4].below = true;
-
-        mazeFloorPlan[1][5].below = true;
-        mazeFloorPlan[1][5].left = true;
-
-        mazeFloorPlan[1][6].above = true;
-
-        mazeFloorPlan[1][7].above = true;
-        mazeFloorPlan[1][7].below = true;
-
-        // row 3
-        mazeFloorPlan[2][0].below = true;
-        mazeFloorPlan[2][0].above = true;
-
-        mazeFloorPlan[2][1].above = true;
-        mazeFloorPlan[2][1].below = true;
-
-        mazeFloorPlan[2][2].above = true;
-        mazeFloorPlan[2][2].right = true;
-
-        mazeFloorPlan[2][3].right = true;
-        mazeFloorPlan[2][3].left = true;
-
-        mazeFloorPlan[2][4].left = true;
-        mazeFloorPlan[2][4].above = true;
-
-        mazeFloorPlan[2][5].above = true;
-        mazeFloorPlan[2][5].right = true;
-
-        mazeFloorPlan[2][6].right = true;
-        mazeFloorPlan[2][6].left = true;
-
-        mazeFloorPlan[2][7].left = true;
-        mazeFloorPlan[2][7].above = true;
-        mazeFloorPlan[2][7].below = true;
-
-        // row 4
-        mazeFloorPlan[3][0].above = true;
-        mazeFloorPlan[3][0].below = true;
-
-        mazeFloorPlan[3][1].above = true;
-
-        mazeFloorPlan[3][2].right = true;
-        mazeFloorPlan[3][2].below = true;
-
-        mazeFloorPlan[3][3].right = true;
-        mazeFloorPlan[3][3].left = true;
-
-        mazeFloorPlan[3][4].left = true;
-        mazeFloorPlan[3][4].right = true;
-
-        mazeFloorPlan[3][5].below = true;
-        mazeFloorPlan[3][5].left = true;
-        mazeFloorPlan[3][5].right = true;
-
-        mazeFloorPlan[3][6].left = true;
-        mazeFloorPlan[3][6].below = true;
-
-        mazeFloorPlan[3][7].below = true;
-        mazeFloorPlan[3][7].above = true;
-
-        // row 5
-        mazeFloorPlan[4][0].above = true;
-        mazeFloorPlan[4][0].below = true;
-
-        mazeFloorPlan[4][1].right = true;
-        mazeFloorPlan[4][1].below = true;
-
-        mazeFloorPlan[4][2].left = true;
-        mazeFloorPlan[4][2].above = true;
-
-        mazeFloorPlan[4][3].right = true;
-        mazeFloorPlan[4][3].below = true;
-
-        mazeFloorPlan[4][4].below = true;
-        mazeFloorPlan[4][4].left = true;
-
-        mazeFloorPlan[4][5].above = true;
-        mazeFloorPlan[4][5].below = true;
-
-        mazeFloorPlan[4][6].above = true;
-
-        mazeFloorPlan[4][7].above = true;
-        mazeFloorPlan[4][7].below = true;
-
-        // row 6
-        mazeFloorPlan[5][0].above = true;
-        mazeFloorPlan[5][0].right = true;
-
-        mazeFloorPlan[5][1].right = true;
-        mazeFloorPlan[5][1].left = true;
-        mazeFloorPlan[5][1].above = true;
-
-        mazeFloorPlan[5][2].left = true;
-        mazeFloorPlan[5][2].right = true;
-
-        mazeFloorPlan[5][3].left = true;
-        mazeFloorPlan[5][3].above = true;
-
-        mazeFloorPlan[5][4].above = true;
-
-        mazeFloorPlan[5][5].above = true;
-        mazeFloorPlan[5][5].right = true;
-
-        mazeFloorPlan[5][6].left = true;
-        mazeFloorPlan[5][6].right = true;
-
-        mazeFloorPlan[5][7].left = true;
-        mazeFloorPlan[5][7].above = true;
-
-        // FLOWERS
-        mazeFloorPlan[0][2].floor = FLOWER;
-        mazeFloorPlan[0][4].floor = FLOWER;
-        mazeFloorPlan[1][6].floor = FLOWER;
-        mazeFloorPlan[3][1].floor = FLOWER;
-        mazeFloorPlan[4][2].floor = FLOWER;
-        mazeFloorPlan[4][6].floor = FLOWER;
-
-        // ICE
-        mazeFloorPlan[2][2].floor = ICE;
-        mazeFloorPlan[4][7].floor = ICE;
-        mazeFloorPlan[4][0].floor = ICE;
-        mazeFloorPlan[1][1].floor = ICE;
-
-    } else if (mazeMap == HARD) {
-        // row 1
-        mazeFloorPlan[0][0].right = true;
-        mazeFloorPlan[0][0].below = true;
-
-        mazeFloorPlan[0][1].below = true;
-        mazeFloorPlan[0][1].left = true;
-
-        mazeFloorPlan[0][2].right = true;
-
-        mazeFloorPlan[0][3].below = true;
-        mazeFloorPlan[0][3].left = true;
-
-        mazeFloorPlan[0][4].right = true;
-        mazeFloorPlan[0][4].below = true;
-
-        mazeFloorPlan[0][5].right = true;
-        mazeFloorPlan[0][5].left = true;
-
-        mazeFloorPlan[0][6].right = true;
-        mazeFloorPlan[0][6].left = true;
-
-        mazeFloorPlan[0][7].below = true;
-        mazeFloorPlan[0][7].left = true;
-
-        // row 2
-        mazeFloorPlan[1][0].above = true;
-        mazeFloorPlan[1][0].below = true;
-
-        mazeFloorPlan[1][1].above = true;
-        mazeFloorPlan[1][1].below = true;
-
-        mazeFloorPlan[1][2].below = true;
-        mazeFloorPlan[1][2].right = true;
-
-        mazeFloorPlan[1][3].above = true;
-        mazeFloorPlan[1][3].left = true;
-
-        mazeFloorPlan[1][4].right = true;
-        mazeFloorPlan[1][4].above = true;
-
-        mazeFloorPlan[1][5].below = true;
-        mazeFloorPlan[1][5].left = true;
-
-        mazeFloorPlan[1][6].right = true;
-
-        mazeFloorPlan[1][7].above = true;
-        mazeFloorPlan[1][7].left = true;
-
-        // row 3
-        mazeFloorPlan[2][0].below = true;
-        mazeFloorPlan[2][0].above = true;
-
-        mazeFloorPlan[2][1].above = true;
-        mazeFloorPlan[2][1].right = true;
-
-        mazeFloorPlan[2][2].above = true;
-        mazeFloorPlan[2][2].left = true;
-
-        mazeFloorPlan[2][3].right = true;
-        mazeFloorPlan[2][3].below = true;
-
-        mazeFloorPlan[2][4].left = true;
-        mazeFloorPlan[2][4].right = true;
-
-        mazeFloorPlan[2][5].above = true;
-        mazeFloorPlan[2][5].left = true;
-        mazeFloorPlan[2][5].below = true;
-
-        mazeFloorPlan[2][6].right = true;
-        mazeFloorPlan[2][6].below = true;
-
-        mazeFloorPlan[2][7].left = true;
-        mazeFloorPlan[2][7].below = true;
-
-        // row 4
-        mazeFloorPlan[3][0].above = true;
-        mazeFloorPlan[3][0].below = true;
-
-        mazeFloorPlan[3][1].right = true;
-
-        mazeFloorPlan[3][2].right = true;
-        mazeFloorPlan[3][2].left = true;
-
-        mazeFloorPlan[3][3].above = true;
-        mazeFloorPlan[3][3].left = true;
-
-        mazeFloorPlan[3][4].below = true;
-        mazeFloorPlan[3][4].right = true;
-
-        mazeFloorPlan[3][5].above = true;
-        mazeFloorPlan[3][5].left = true;
-
-        mazeFloorPlan[3][6].above = true;
-        mazeFloorPlan[3][6].below = true;
-
-        mazeFloorPlan[3][7].below = true;
-        mazeFloorPlan[3][7].above = true;
-
-        // row 5
-        mazeFloorPlan[4][0].above = true;
-        mazeFloorPlan[4][0].below = true;
-        mazeFloorPlan[4][0].right = true;
-
-        mazeFloorPlan[4][1].left = true;
-        mazeFloorPlan[4][1].below = true;
-
-        mazeFloorPlan[4][2].right = true;
-        mazeFloorPlan[4][2].below = true;
-
-        mazeFloorPlan[4][3].left = true;
-        mazeFloorPlan[4][3].below = true;
-
-        mazeFloorPlan[4][4].above = true;
-        mazeFloorPlan[4][4].right = true;
-
-        mazeFloorPlan[4][5].left = true;
-        mazeFloorPlan[4][5].right = true;
-
-        mazeFloorPlan[4][6].left = true;
-        mazeFloorPlan[4][6].above = true;
-
-        mazeFloorPlan[4][7].above = true;
-        mazeFloorPlan[4][7].below = true;
-
-        // row 6
-        mazeFloorPlan[5][0].above = true;
-
-        mazeFloorPlan[5][1].right = true;
-        mazeFloorPlan[5][1].above = true;
-
-        mazeFloorPlan[5][2].left = true;
-        mazeFloorPlan[5][2].above = true;
-
-        mazeFloorPlan[5][3].right = true;
-        mazeFloorPlan[5][3].above = true;
-
-        mazeFloorPlan[5][4].left = true;
-        mazeFloorPlan[5][4].right = true;
-
-        mazeFloorPlan[5][5].left = true;
-        mazeFloorPlan[5][5].right = true;
-
-        mazeFloorPlan[5][6].left = true;
-        mazeFloorPlan[5][6].right = true;
-
-        mazeFloorPlan[5][7].left = true;
-        mazeFloorPlan[5][7].above = true;
-
-        // FLOWERS
-        mazeFloorPlan[0][2].floor = FLOWER;
-        mazeFloorPlan[1][6].floor = FLOWER;
-        mazeFloorPlan[3][1].floor = FLOWER;
-        mazeFloorPlan[4][6].floor = FLOWER;
-        mazeFloorPlan[5][0].floor = FLOWER;
-        mazeFloorPlan[5][7].floor = FLOWER;
-
-        // ICE
-        mazeFloorPlan[0][1].floor = ICE;
-        mazeFloorPlan[1][5].floor = ICE;
-        mazeFloorPlan[3][3].floor = ICE;
-        mazeFloorPlan[5][5].floor = ICE;
-        mazeFloorPlan[4][0].floor = ICE;
-
-    } else if (mazeMap == EXTREME) {
-         // row 1
-        mazeFloorPlan[0][0].below = true;
-
-        mazeFloorPlan[0][1].below = true;
-        mazeFloorPlan[0][1].right = true;
-
-        mazeFloorPlan[0][2].right = true;
-        mazeFloorPlan[0][2].left = true;
-        mazeFloorPlan[0][2].below = true;
-
-        mazeFloorPlan[0][3].left = true;
-
-        mazeFloorPlan[0][4].right = true;
-        mazeFloorPlan[0][4].below = true;
-
-        mazeFloorPlan[0][5].below = true;
-        mazeFloorPlan[0][5].left = true;
-
-        mazeFloorPlan[0][6].right = true;
-        mazeFloorPlan[0][6].below = true;
-
-        mazeFloorPlan[0][7].below = true;
-        mazeFloorPlan[0][7].left = true;
-
-        // row 2
-        mazeFloorPlan[1][0].above = true;
-        mazeFloorPlan[1][0].right = true;
-
-        mazeFloorPlan[1][1].above = true;
-        mazeFloorPlan[1][1].left = true;
-
-        mazeFloorPlan[1][2].above = true;
-        mazeFloorPlan[1][2].right = true;
-
-        mazeFloorPlan[1][3].below = true;
-        mazeFloorPlan[1][3].left = true;
-
-        mazeFloorPlan[1][4].below = true;
-        mazeFloorPlan[1][4].above = true;
-
-        mazeFloorPlan[1][5].above = true;
-        mazeFloorPlan[1][5].right = true;
-
-        mazeFloorPlan[1][6].above = true;
-        mazeFloorPlan[1][6].left = true;
-        mazeFloorPlan[1][6].below = true;
-
-        mazeFloorPlan[1][7].above = true;
-
-        // row 3
-        mazeFloorPlan[2][0].below = true;
-        mazeFloorPlan[2][0].right = true;
-
-        mazeFloorPlan[2][1].below = true;
-        mazeFloorPlan[2][1].left = true;
-
-        mazeFloorPlan[2][2].below = true;
-
-        mazeFloorPlan[2][3].above = true;
-        mazeFloorPlan[2][3].below = true;
-
-        mazeFloorPlan[2][4].above = true;
-        mazeFloorPlan[2][4].right = true;
-
-        mazeFloorPlan[2][5].left = true;
-
-        mazeFloorPlan[2][6].right = true;
-        mazeFloorPlan[2][6].above = true;
-
-        mazeFloorPlan[2][7].left = true;
-        mazeFloorPlan[2][7].below = true;
-
-        // row 4
-        mazeFloorPlan[3][0].above = true;
-        mazeFloorPlan[3][0].below = true;
-
-        mazeFloorPlan[3][1].above = true;
-        mazeFloorPlan[3][1].below = true;
-
-        mazeFloorPlan[3][2].above = true;
-        mazeFloorPlan[3][2].below = true;
-
-        mazeFloorPlan[3][3].above = true;
-        mazeFloorPlan[3][3].right = true;
-
-        mazeFloorPlan[3][4].left = true;
-        mazeFloorPlan[3][4].right = true;
-
-        mazeFloorPlan[3][5].below = true;
-        mazeFloorPlan[3][5].left = true;
-
-        mazeFloorPlan[3][6].right = true;
-        mazeFloorPlan[3][6].below = true;
-
-        mazeFloorPlan[3][7].left = true;
-        mazeFloorPlan[3][7].above = true;
-
-        // row 5
-        mazeFloorPlan[4][0].above = true;
-        mazeFloorPlan[4][0].below = true;
-
-        mazeFloorPlan[4][1].above = true;
-        mazeFloorPlan[4][1].right = true;
-
-        mazeFloorPlan[4][2].above = true;
-        mazeFloorPlan[4][2].left = true;
-
-        mazeFloorPlan[4][3].below = true;
-
-        mazeFloorPlan[4][4].below = true;
-        mazeFloorPlan[4][4].right = true;
-
-        mazeFloorPlan[4][5].left = true;
-        mazeFloorPlan[4][5].above = true;
-
-        mazeFloorPlan[4][6].right = true;
-        mazeFloorPlan[4][6].above = true;
-
-        mazeFloorPlan[4][7].left = true;
-        mazeFloorPlan[4][7].below = true;
-
-        // row 6
-        mazeFloorPlan[5][0].above = true;
-        mazeFloorPlan[5][0].right = true;
-
-        mazeFloorPlan[5][1].right = true;
-        mazeFloorPlan[5][1].left = true;
-
-        mazeFloorPlan[5][2].left = true;
-        mazeFloorPlan[5][2].right = true;
-
-        mazeFloorPlan[5][3].right = true;
-        mazeFloorPlan[5][3].above = true;
-        mazeFloorPlan[5][3].left = true;
+    char path[32];
+    snprintf(path, sizeof(path), "/levels/%s.maze", name);
+    if (!levelFilesMounted || !LittleFS.exists(path))
+        return 0;
+
+    File file = LittleFS.open(path, "r");
+    if (!file)
+        return 0;
+    size_t length = file.read(buffer, size);
+    file.close();
+    return length;
+}
 
-        mazeFloorPlan[5][4].left = true;
-        mazeFloorPlan[5][4].right = true;
-        mazeFloorPlan[5][4].above = true;
+//////////////////////////////////////////////////////////////////////
+// Load a level (binary maze format, see Maze.h) into the maze grid:
+// from LittleFS if the file is there, otherwise from flash. Every
+// cell is overwritten, so nothing is left over from the last game.
+//////////////////////////////////////////////////////////////////////
+bool loadMazeLevel(MazeLevel level)
+{
+    static uint8_t fileBuffer[MAZE_HEADER_SIZE + MazeGrid::MAX_WIDTH * MazeGrid::MAX_HEIGHT];
 
-        mazeFloorPlan[5][5].left = true;
-        mazeFloorPlan[5][5].right = true;
+    MazeHeader header;
+    size_t fileLength = readMazeFile(MAZE_LEVEL_NAME[level], fileBuffer, sizeof(fileBuffer));
+    bool loaded = fileLength > 0 && maze.load(fileBuffer, fileLength, &header);
+    if (!loaded && fileLength > 0)
+    {
+        Serial.printf("Ignoring bad maze file for %s\n", MAZE_LEVEL_NAME[level]);
+    }
 
-        mazeFloorPlan[5][6].left = true;
-        mazeFloorPlan[5][6].right = true;
+    if (!loaded)
+    {
+        loaded = maze.load(MAZE_LEVEL_DATA[level], MAZE_LEVEL_SIZE[level], &header);
+    }
+    if (!loaded)
+        return false;
 
-        mazeFloorPlan[5][7].left = true;
-        mazeFloorPlan[5][7].above = true;
+    const char *reason;
+    if (!mazeAnalysis.analyze(maze, header, &reason))
+    {
+        Serial.printf("Level %s can't be finished (%s)\n", MAZE_LEVEL_NAME[level], reason);
+    }
 
-        // FLOWERS
-        mazeFloorPlan[0][0].floor = FLOWER;
-        mazeFloorPlan[1][7].floor = FLOWER;
-        mazeFloorPlan[2][2].floor = FLOWER;
-        mazeFloorPlan[2][5].floor = FLOWER;
-        mazeFloorPlan[4][3].floor = FLOWER;
-        mazeFloorPlan[5][7].floor = FLOWER;
-        mazeFloorPlan[5][0].floor = FLOWER;
+    startX = header.startX;
+    startY = header.startY;
+    endX = header.endX;
+    endY = header.endY;
+    numFlowersToBloom = header.flowersToBloom;
+    return true;
+}
 
-        // ICE
-        mazeFloorPlan[0][5].floor = ICE;
-        mazeFloorPlan[1][1].floor = ICE;
-        mazeFloorPlan[1][6].floor = ICE;
-        mazeFloorPlan[2][1].floor = ICE;
-        mazeFloorPlan[5][3].floor = ICE;
-        mazeFloorPlan[3][3].floor = ICE;
-        
+//////////////////////////////////////////////////////////////////////
+// Generate a random level with as many flowers and ice blocks as the
+// built-in level of the same difficulty. The seed is printed so a
+// good maze can be replayed by typing it into the serial monitor.
+//////////////////////////////////////////////////////////////////////
+bool generateMazeLevel(MazeLevel level)
+{
+    uint32_t seed = mazeSeed != 0 ? mazeSeed : esp_random();
+    Serial.printf("Maze seed: %u\n", seed);
+    mazeGenerator.setSeed(seed);
+
+    MazeGenParams params;
+    params.width = randomMazeWidth[level];
+    params.height = randomMazeHeight[level];
+    params.flowers = randomMazeFlowers[level];
+    params.ice = randomMazeIce[level];
+    params.minDistance = randomMazeFlowerDistance;
+
+    MazeHeader header;
+    const char *reason = "bad size";
+    if (!mazeGenerator.generate(params, maze, &header) || !mazeGenerator.validate(maze, header, &reason) ||
+        !mazeAnalysis.analyze(maze, header, &reason))
+    {
+        Serial.printf("Random maze failed (%s), using the built-in level\n", reason);
+        return loadMazeLevel(level);
     }
-}
\ No newline at end of file
+
+    startX = header.startX;
+    startY = header.startY;
+    endX = header.endX;
+    endY = header.endY;
+    numFlowersToBloom = header.flowersToBloom;
+    return true;
+}
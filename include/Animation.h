@@ -0,0 +1,112 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+// Includes
+#include <Arduino.h>
+
+////////////////////////////////////////////////////////////////////
+// A small, non-blocking animation timeline. Keyframes are callbacks
+// scheduled at an offset (ms) from start(); loop() calls update()
+// with the current time and every keyframe that has come due runs.
+// Nothing ever delay()s, so BLE reads and buttons keep working while
+// an animation is playing.
+//
+// Keyframes marked as droppable (e.g. the in-between faces of a
+// rolling die) are skipped when a later keyframe is already due, so
+// a late update() catches up instead of drawing a burst of stale
+// frames.
+////////////////////////////////////////////////////////////////////
+class Timeline
+{
+    public:
+        typedef void (*KeyframeFn)(int arg);
+
+        static const int MAX_KEYFRAMES = 16;
+
+        Timeline() : count(0), next(0), startMs(0), running(false) {}
+
+        // Remove all keyframes and stop
+        void clear()
+        {
+            count = 0;
+            next = 0;
+            running = false;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Queue fn(arg) at atMs after start(). Keyframes must be added
+        // in time order. Returns false if the timeline is full.
+        //////////////////////////////////////////////////////////////
+        bool add(unsigned long atMs, KeyframeFn fn, int arg = 0, bool droppable = false)
+        {
+            if (count >= MAX_KEYFRAMES)
+                return false;
+
+            keyframes[count].atMs = atMs;
+            keyframes[count].fn = fn;
+            keyframes[count].arg = arg;
+            keyframes[count].droppable = droppable;
+            count++;
+            return true;
+        }
+
+        void start(unsigned long now)
+        {
+            startMs = now;
+            next = 0;
+            running = count > 0;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Run every keyframe that is due. Returns true while the
+        // timeline still has keyframes left.
+        //////////////////////////////////////////////////////////////
+        bool update(unsigned long now)
+        {
+            if (!running)
+                return false;
+
+            unsigned long elapsed = now - startMs;
+            while (next < count && keyframes[next].atMs <= elapsed)
+            {
+                bool laterDue = next + 1 < count && keyframes[next + 1].atMs <= elapsed;
+                if (!(keyframes[next].droppable && laterDue))
+                    keyframes[next].fn(keyframes[next].arg);
+                next++;
+            }
+
+            running = next < count;
+            return running;
+        }
+
+        // Jump to the end: run the remaining keyframes that can't be
+        // dropped right now (e.g. the game moved on mid-animation)
+        void finish()
+        {
+            for (; running && next < count; next++)
+            {
+                if (!keyframes[next].droppable)
+                    keyframes[next].fn(keyframes[next].arg);
+            }
+            running = false;
+        }
+
+        bool isRunning() const { return running; }
+
+    private:
+        struct Keyframe
+        {
+            unsigned long atMs;
+            KeyframeFn fn;
+            int arg;
+            bool droppable;
+        };
+
+        Keyframe keyframes[MAX_KEYFRAMES];
+        int count;
+        int next;
+        unsigned long startMs;
+        bool running;
+};
+
+#endif
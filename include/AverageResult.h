@@ -0,0 +1,360 @@
+#ifndef AVERAGE_RESULT_H
+#define AVERAGE_RESULT_H
+
+// Includes
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "HalNet.h"
+
+////////////////////////////////////////////////////////////////////
+// The average cloud function's answer (func2_index.js), parsed as it
+// streams in instead of being kept as text and parsed again:
+//
+//   AverageResultParser parser;
+//   HalHttp::get(url, keys, vals, 1, parser);  // or HttpWorker::get
+//   AverageResult result;
+//   if (parser.result(&result))
+//       draw(result);
+//
+// The answer is one flat JSON object:
+//   {"dataType":"temp","averageData":21.3,"minData":20.9,
+//    "maxData":21.8,"stdDevData":0.2,"timeRange":"... - ...",
+//    "numDataPoints":120,"rateDataCollect":1,"queryTimeMs":85.2}
+// The parser is a byte-at-a-time state machine with a 64 byte
+// scratch buffer, so the body can arrive in pieces of any size and
+// is never held in memory. Unknown keys are skipped (nested values
+// too); a key longer than the scratch buffer counts as unknown, a
+// timeRange is cut to fit.
+////////////////////////////////////////////////////////////////////
+
+// The dataTypes func2 averages (its metricFields)
+enum DataType
+{
+    DATA_UNKNOWN,
+    DATA_PROX,
+    DATA_AMBIENT_LIGHT,
+    DATA_WHITE_LIGHT,
+    DATA_TEMP,
+    DATA_RHUM,
+    DATA_ACC_X,
+    DATA_ACC_Y,
+    DATA_ACC_Z
+};
+
+// Name as the cloud functions spell it ("" for DATA_UNKNOWN)
+inline const char *dataTypeName(DataType type)
+{
+    static const char *const names[] = {"", "prox", "al", "rwl", "temp", "rHum", "ax", "ay", "az"};
+    return (unsigned)type < sizeof(names) / sizeof(names[0]) ? names[type] : "";
+}
+
+inline DataType dataTypeFromName(const char *name)
+{
+    if (strcmp(name, "als") == 0) // the device's older name for it
+        return DATA_AMBIENT_LIGHT;
+    for (int type = DATA_PROX; type <= DATA_ACC_Z; type++)
+        if (strcmp(name, dataTypeName((DataType)type)) == 0)
+            return (DataType)type;
+    return DATA_UNKNOWN;
+}
+
+struct AverageResult
+{
+    DataType dataType;
+    float average;
+    float min;
+    float max;
+    float stdDev;      // 0 from older functions
+    int32_t count;     // numDataPoints
+    float rate;        // rateDataCollect, samples per second
+    float queryTimeMs; // 0 from older functions
+    char timeRange[64];
+};
+
+class AverageResultParser : public HalHttpBody
+{
+    public:
+        AverageResultParser() { begin(); }
+
+        // Start over for a new response
+        void begin()
+        {
+            memset(&parsed, 0, sizeof(parsed));
+            state = EXPECT_OBJECT;
+            depth = 0;
+            escaped = false;
+            field = FIELD_NONE;
+            length = 0;
+            seen = 0;
+        }
+
+        bool write(const char *data, size_t count)
+        {
+            for (size_t i = 0; i < count && state != FAILED; i++)
+                feed(data[i]);
+            return state != FAILED;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Once the response is in: false unless it was a complete
+        // object with at least the dataType, average and count
+        //////////////////////////////////////////////////////////////
+        bool result(AverageResult *out) const
+        {
+            const uint32_t needed = (1u << FIELD_DATA_TYPE) | (1u << FIELD_AVERAGE) | (1u << FIELD_COUNT);
+            if (state != DONE || (seen & needed) != needed)
+                return false;
+            *out = parsed;
+            return true;
+        }
+
+    private:
+        enum State
+        {
+            EXPECT_OBJECT,
+            EXPECT_KEY,     // or the closing brace
+            IN_KEY,
+            EXPECT_COLON,
+            EXPECT_VALUE,
+            IN_STRING,      // a value we keep
+            IN_NUMBER,
+            SKIP_STRING,    // inside a value we skip
+            SKIP_VALUE,     // a skipped object, array or literal
+            AFTER_VALUE,    // comma or closing brace
+            DONE,
+            FAILED
+        };
+
+        enum Field
+        {
+            FIELD_NONE,
+            FIELD_DATA_TYPE,
+            FIELD_AVERAGE,
+            FIELD_MIN,
+            FIELD_MAX,
+            FIELD_STD_DEV,
+            FIELD_COUNT,
+            FIELD_RATE,
+            FIELD_QUERY_TIME,
+            FIELD_TIME_RANGE
+        };
+
+        static const int SCRATCH_SIZE = 64;
+
+        AverageResult parsed;
+        State state;
+        int depth;       // nesting inside a skipped value
+        bool escaped;    // last string character was a backslash
+        Field field;
+        char scratch[SCRATCH_SIZE];
+        int length;
+        uint32_t seen;   // bit per Field
+
+        static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+        static Field fieldFor(const char *key)
+        {
+            static const char *const keys[] = {"", "dataType", "averageData", "minData", "maxData", "stdDevData",
+                                               "numDataPoints", "rateDataCollect", "queryTimeMs", "timeRange"};
+            for (int f = FIELD_DATA_TYPE; f <= FIELD_TIME_RANGE; f++)
+                if (strcmp(key, keys[f]) == 0)
+                    return (Field)f;
+            return FIELD_NONE;
+        }
+
+        void keep(char c)
+        {
+            if (length < SCRATCH_SIZE - 1)
+                scratch[length++] = c;
+        }
+
+        void feed(char c)
+        {
+            switch (state)
+            {
+                case EXPECT_OBJECT:
+                    if (c == '{')
+                        state = EXPECT_KEY;
+                    else if (!isSpace(c))
+                        state = FAILED;
+                    break;
+
+                case EXPECT_KEY:
+                    if (c == '"')
+                    {
+                        state = IN_KEY;
+                        length = 0;
+                        escaped = false;
+                    }
+                    else if (c == '}')
+                        state = DONE;
+                    else if (!isSpace(c))
+                        state = FAILED;
+                    break;
+
+                case IN_KEY:
+                    if (escaped)
+                    {
+                        escaped = false;
+                        keep(c);
+                    }
+                    else if (c == '\\')
+                        escaped = true;
+                    else if (c == '"')
+                    {
+                        scratch[length] = '\0';
+                        field = length < SCRATCH_SIZE - 1 ? fieldFor(scratch) : FIELD_NONE;
+                        state = EXPECT_COLON;
+                    }
+                    else
+                        keep(c);
+                    break;
+
+                case EXPECT_COLON:
+                    if (c == ':')
+                        state = EXPECT_VALUE;
+                    else if (!isSpace(c))
+                        state = FAILED;
+                    break;
+
+                case EXPECT_VALUE:
+                    length = 0;
+                    escaped = false;
+                    if (isSpace(c))
+                        break;
+                    if (c == '"')
+                        state = field == FIELD_NONE ? SKIP_STRING : IN_STRING;
+                    else if (c == '-' || (c >= '0' && c <= '9'))
+                    {
+                        state = IN_NUMBER;
+                        keep(c);
+                    }
+                    else
+                    {
+                        // object, array, true/false/null: not ours
+                        depth = 0;
+                        state = SKIP_VALUE;
+                        feed(c);
+                    }
+                    break;
+
+                case IN_STRING:
+                    if (escaped)
+                    {
+                        // \uXXXX comes out as its hex digits; timeRange
+                        // is plain ASCII anyway
+                        escaped = false;
+                        keep(c == 'n' || c == 't' || c == 'r' ? ' ' : c);
+                    }
+                    else if (c == '\\')
+                        escaped = true;
+                    else if (c == '"')
+                    {
+                        scratch[length] = '\0';
+                        storeString();
+                        state = AFTER_VALUE;
+                    }
+                    else
+                        keep(c);
+                    break;
+
+                case IN_NUMBER:
+                    if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+                    {
+                        keep(c);
+                        break;
+                    }
+                    scratch[length] = '\0';
+                    storeNumber();
+                    state = AFTER_VALUE;
+                    feed(c);
+                    break;
+
+                case SKIP_STRING:
+                    if (escaped)
+                        escaped = false;
+                    else if (c == '\\')
+                        escaped = true;
+                    else if (c == '"')
+                        state = depth > 0 ? SKIP_VALUE : AFTER_VALUE;
+                    break;
+
+                case SKIP_VALUE:
+                    if (c == '{' || c == '[')
+                        depth++;
+                    else if ((c == '}' || c == ']') && depth > 0)
+                    {
+                        if (--depth == 0)
+                            state = AFTER_VALUE;
+                    }
+                    else if (c == '"' && depth > 0)
+                    {
+                        escaped = false;
+                        state = SKIP_STRING;
+                    }
+                    else if (depth == 0 && (c == ',' || c == '}' || isSpace(c)))
+                    {
+                        // end of a literal
+                        state = AFTER_VALUE;
+                        feed(c);
+                    }
+                    else if (depth == 0 && !(c >= 'a' && c <= 'z'))
+                        state = FAILED;
+                    break;
+
+                case AFTER_VALUE:
+                    if (c == ',')
+                        state = EXPECT_KEY;
+                    else if (c == '}')
+                        state = DONE;
+                    else if (!isSpace(c))
+                        state = FAILED;
+                    break;
+
+                case DONE:
+                    if (!isSpace(c))
+                        state = FAILED;
+                    break;
+
+                case FAILED:
+                    break;
+            }
+        }
+
+        void storeString()
+        {
+            if (field == FIELD_DATA_TYPE)
+                parsed.dataType = dataTypeFromName(scratch);
+            else if (field == FIELD_TIME_RANGE)
+                memcpy(parsed.timeRange, scratch, length + 1);
+            else
+                return; // a string where a number belongs
+            seen |= 1u << field;
+        }
+
+        void storeNumber()
+        {
+            char *end;
+            double value = strtod(scratch, &end);
+            if (end == scratch || *end != '\0')
+            {
+                state = FAILED;
+                return;
+            }
+            switch (field)
+            {
+                case FIELD_AVERAGE:    parsed.average = value; break;
+                case FIELD_MIN:        parsed.min = value; break;
+                case FIELD_MAX:        parsed.max = value; break;
+                case FIELD_STD_DEV:    parsed.stdDev = value; break;
+                case FIELD_COUNT:      parsed.count = (int32_t)value; break;
+                case FIELD_RATE:       parsed.rate = value; break;
+                case FIELD_QUERY_TIME: parsed.queryTimeMs = value; break;
+                default:               return; // unknown key or a number where a string belongs
+            }
+            seen |= 1u << field;
+        }
+};
+
+#endif
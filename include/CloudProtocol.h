@@ -0,0 +1,66 @@
+#ifndef CLOUD_PROTOCOL_H
+#define CLOUD_PROTOCOL_H
+
+// Includes
+#include <stdio.h>
+#include "TelemetryRecord.h"
+
+////////////////////////////////////////////////////////////////////
+// What Weather Program v3 (GCP.cpp) sends its cloud functions, kept
+// free of Arduino types so the load generator (tools/cloud_loadgen.cpp)
+// builds the same requests on a PC:
+//   deviceDetails        one reading of the sensors
+//   toTelemetrySample()  its fields in the binary upload format
+//   formatReqDetails()   the Req-Details header of an average request
+//   formatM5Details()    one reading as M5-Details JSON, the layout
+//                        the upload function still takes from older
+//                        clients (header or JSON batch)
+// The format functions return the length like snprintf (no more
+// than size - 1 bytes are written). userId and dataType are copied
+// as they are, so they must not contain quotes.
+////////////////////////////////////////////////////////////////////
+struct deviceDetails {
+    int prox;
+    int ambientLight;
+    int whiteLight;
+    double rHum;
+    double temp;
+    double accX;
+    double accY;
+    double accZ;
+    unsigned long timeCaptured; // UTC epoch seconds
+};
+
+inline TelemetrySample toTelemetrySample(const deviceDetails &details)
+{
+    TelemetrySample sample;
+    sample.timeCaptured = details.timeCaptured;
+    sample.prox = details.prox;
+    sample.ambientLight = details.ambientLight;
+    sample.whiteLight = details.whiteLight;
+    sample.temp = details.temp;
+    sample.rHum = details.rHum;
+    sample.acc[0] = details.accX;
+    sample.acc[1] = details.accY;
+    sample.acc[2] = details.accZ;
+    return sample;
+}
+
+inline int formatReqDetails(char *buffer, size_t size, const char *userId, int duration, const char *dataType)
+{
+    return snprintf(buffer, size, "{\"userId\":\"%s\",\"timeDuration\":%d,\"dataType\":\"%s\"}",
+                    userId, duration, dataType);
+}
+
+inline int formatM5Details(char *buffer, size_t size, const char *userId, const deviceDetails &details)
+{
+    return snprintf(buffer, size,
+                    "{\"vcnlDetails\":{\"prox\":%d,\"al\":%d,\"rwl\":%d},"
+                    "\"shtDetails\":{\"temp\":%.2f,\"rHum\":%.2f},"
+                    "\"m5Details\":{\"ax\":%.2f,\"ay\":%.2f,\"az\":%.2f},"
+                    "\"otherDetails\":{\"timeCaptured\":%lu,\"userId\":\"%s\"}}",
+                    details.prox, details.ambientLight, details.whiteLight, details.temp, details.rHum,
+                    details.accX, details.accY, details.accZ, details.timeCaptured, userId);
+}
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+// Includes
+#include "Hal.h"
+
+////////////////////////////////////////////////////////////////////
+// Append-only log of fixed-size records in a raw flash partition,
+// for data that has to survive losing the network (and power) until
+// it can be uploaded:
+//
+//   log.append(record);               // when it can't be sent now
+//   int n = log.read(batch, 30);      // oldest unread, in order
+//   if (upload(batch, n))
+//       log.consume(n);               // only after it got through
+//
+// The partition is split into segments of one flash sector each,
+// used round robin, so every sector is erased equally often and only
+// when the log wraps around onto it (the erase is what wears NOR
+// flash out; writes into erased space are free). If that segment
+// still has unread records they are dropped, oldest first.
+//
+// Segment: 16 byte header (magic, sequence number, slot size, CRC),
+// then slots of
+//   u8 written  0xA5 once the slot is complete, written last
+//   u8 read     0xFF, cleared to 0x00 by consume()
+//   u16 crc     CRC-16/CCITT of the record
+//   the record, padded to a multiple of 4 bytes
+// Marking records read only clears bits, so the read cursor is kept
+// in flash without erases. begin() finds the newest segment, the
+// next free slot and the first unread record again after a reset; a
+// slot torn by a reset mid-write fails its marker or CRC and is
+// skipped.
+//
+// RAM use is one slot on the stack, whatever the partition size.
+// Records are copied byte for byte, so they must be plain structs.
+////////////////////////////////////////////////////////////////////
+template <typename Record>
+class FlashLog
+{
+    public:
+        static const uint32_t SEGMENT_SIZE = HalFlash::SECTOR_SIZE;
+        static const int HEADER_SIZE = 16;
+        static const int SLOT_SIZE = (4 + sizeof(Record) + 3) & ~3;
+        static const int SLOTS_PER_SEGMENT = (SEGMENT_SIZE - HEADER_SIZE) / SLOT_SIZE;
+
+        explicit FlashLog(HalFlash &flash)
+            : flash(flash), numSegments(0), headSegment(0), headSequence(0), writeSlot(0),
+              readSegment(0), readSlot(0), unread(0), dropped(0), corrupt(0) {}
+
+        //////////////////////////////////////////////////////////////
+        // Mount the log (formatting the partition if it holds none).
+        // Returns false if the partition is too small or unusable.
+        //////////////////////////////////////////////////////////////
+        bool begin()
+        {
+            numSegments = flash.size() / SEGMENT_SIZE;
+            unread = 0;
+            if (numSegments < 2 || SLOTS_PER_SEGMENT < 1)
+                return false;
+
+            // Newest and oldest segments
+            int oldest = -1;
+            uint32_t oldestSequence = 0;
+            headSegment = -1;
+            for (int segment = 0; segment < numSegments; segment++)
+            {
+                uint32_t sequence;
+                if (!readHeader(segment, &sequence))
+                    continue;
+                if (headSegment < 0 || sequence > headSequence)
+                {
+                    headSegment = segment;
+                    headSequence = sequence;
+                }
+                if (oldest < 0 || sequence < oldestSequence)
+                {
+                    oldest = segment;
+                    oldestSequence = sequence;
+                }
+            }
+            if (headSegment < 0)
+            {
+                readSegment = 0;
+                readSlot = 0;
+                return startSegment(0, 1);
+            }
+
+            // Next free slot in the newest segment
+            writeSlot = 0;
+            while (writeSlot < SLOTS_PER_SEGMENT && slotState(headSegment, writeSlot, nullptr) != SLOT_ERASED)
+                writeSlot++;
+
+            // First unread record, from the oldest segment on
+            bool found = false;
+            readSegment = headSegment;
+            readSlot = writeSlot;
+            for (int segment = oldest; ; segment = (segment + 1) % numSegments)
+            {
+                uint32_t sequence;
+                if (readHeader(segment, &sequence))
+                {
+                    int end = segment == headSegment ? writeSlot : SLOTS_PER_SEGMENT;
+                    for (int slot = 0; slot < end; slot++)
+                    {
+                        if (slotState(segment, slot, nullptr) != SLOT_UNREAD)
+                            continue;
+                        if (!found)
+                        {
+                            readSegment = segment;
+                            readSlot = slot;
+                            found = true;
+                        }
+                        unread++;
+                    }
+                }
+                if (segment == headSegment)
+                    break;
+            }
+            return true;
+        }
+
+        // Add a record at the end; false if the flash write failed
+        bool append(const Record &record)
+        {
+            if (numSegments == 0)
+                return false;
+            if (writeSlot == SLOTS_PER_SEGMENT && !advanceHead())
+                return false;
+
+            // Everything but the written marker, then the marker, so
+            // a reset in between leaves a slot that is skipped
+            uint8_t slot[SLOT_SIZE];
+            memset(slot, 0xFF, sizeof(slot));
+            uint16_t crc = crc16((const uint8_t *)&record, sizeof(Record));
+            slot[2] = crc & 0xFF;
+            slot[3] = crc >> 8;
+            memcpy(slot + 4, &record, sizeof(Record));
+
+            uint32_t offset = slotOffset(headSegment, writeSlot);
+            writeSlot++;
+            uint8_t written = MARK_WRITTEN;
+            if (!flash.write(offset, slot, sizeof(slot)) || !flash.write(offset, &written, 1))
+                return false;
+            unread++;
+            return true;
+        }
+
+        // Records appended but not consumed yet
+        int pending() const { return unread; }
+
+        // Copy up to maxRecords of the oldest unread records, oldest
+        // first, without consuming them
+        int read(Record *records, int maxRecords)
+        {
+            int count = 0;
+            int segment = readSegment;
+            int slot = readSlot;
+            while (count < maxRecords && next(&segment, &slot))
+            {
+                if (slotState(segment, slot, &records[count]) == SLOT_UNREAD)
+                    count++;
+                slot++;
+            }
+            return count;
+        }
+
+        // Mark the count oldest unread records as read
+        void consume(int count)
+        {
+            uint8_t mark = MARK_READ;
+            while (count > 0 && next(&readSegment, &readSlot))
+            {
+                SlotState state = slotState(readSegment, readSlot, nullptr);
+                if (state == SLOT_UNREAD)
+                {
+                    flash.write(slotOffset(readSegment, readSlot) + 1, &mark, 1);
+                    unread--;
+                    count--;
+                }
+                else if (state == SLOT_BAD)
+                {
+                    corrupt++;
+                }
+                readSlot++;
+            }
+        }
+
+        uint32_t droppedRecords() const { return dropped; }  // overwritten unread
+        uint32_t corruptRecords() const { return corrupt; }  // torn or bad CRC
+
+    private:
+        enum SlotState
+        {
+            SLOT_ERASED,
+            SLOT_UNREAD,
+            SLOT_READ,
+            SLOT_BAD
+        };
+
+        static const uint32_t MAGIC = 0x474F4C54; // "TLOG"
+        static const uint8_t MARK_WRITTEN = 0xA5;
+        static const uint8_t MARK_READ = 0x00;
+
+        HalFlash &flash;
+        int numSegments;
+        int headSegment;
+        uint32_t headSequence;
+        int writeSlot;
+        int readSegment;
+        int readSlot;
+        int unread;
+        uint32_t dropped;
+        uint32_t corrupt;
+
+        uint32_t slotOffset(int segment, int slot) const
+        {
+            return segment * SEGMENT_SIZE + HEADER_SIZE + slot * SLOT_SIZE;
+        }
+
+        // Step a read position over segment ends; false at the end
+        // of the log
+        bool next(int *segment, int *slot) const
+        {
+            if (*slot >= SLOTS_PER_SEGMENT && *segment != headSegment)
+            {
+                *segment = (*segment + 1) % numSegments;
+                *slot = 0;
+            }
+            return !(*segment == headSegment && *slot >= writeSlot);
+        }
+
+        SlotState slotState(int segment, int slot, Record *record)
+        {
+            uint8_t bytes[SLOT_SIZE];
+            if (!flash.read(slotOffset(segment, slot), bytes, sizeof(bytes)))
+                return SLOT_BAD;
+
+            bool erased = true;
+            for (int i = 0; i < SLOT_SIZE && erased; i++)
+                erased = bytes[i] == 0xFF;
+            if (erased)
+                return SLOT_ERASED;
+
+            uint16_t crc = bytes[2] | (bytes[3] << 8);
+            if (bytes[0] != MARK_WRITTEN || crc16(bytes + 4, sizeof(Record)) != crc)
+                return SLOT_BAD;
+            if (record != nullptr)
+                memcpy(record, bytes + 4, sizeof(Record));
+            return bytes[1] == MARK_READ ? SLOT_READ : SLOT_UNREAD;
+        }
+
+        bool readHeader(int segment, uint32_t *sequence)
+        {
+            uint32_t header[4];
+            if (!flash.read(segment * SEGMENT_SIZE, header, sizeof(header)))
+                return false;
+            *sequence = header[1];
+            return header[0] == MAGIC && header[2] == (uint32_t)SLOT_SIZE &&
+                   header[3] == crc16((const uint8_t *)header, 12);
+        }
+
+        bool startSegment(int segment, uint32_t sequence)
+        {
+            uint32_t header[4] = {MAGIC, sequence, (uint32_t)SLOT_SIZE, 0};
+            header[3] = crc16((const uint8_t *)header, 12);
+            if (!flash.eraseSector(segment * SEGMENT_SIZE) || !flash.write(segment * SEGMENT_SIZE, header, sizeof(header)))
+                return false;
+            headSegment = segment;
+            headSequence = sequence;
+            writeSlot = 0;
+            return true;
+        }
+
+        // Move on to the next segment, dropping what is unread in it
+        bool advanceHead()
+        {
+            int segment = (headSegment + 1) % numSegments;
+            if (readSegment == headSegment && readSlot >= SLOTS_PER_SEGMENT)
+            {
+                // The log is empty: start reading in the new segment
+                readSegment = segment;
+                readSlot = 0;
+            }
+            else if (readSegment == segment)
+            {
+                for (int slot = readSlot; slot < SLOTS_PER_SEGMENT; slot++)
+                {
+                    if (slotState(segment, slot, nullptr) == SLOT_UNREAD)
+                    {
+                        unread--;
+                        dropped++;
+                    }
+                }
+                readSegment = (segment + 1) % numSegments;
+                readSlot = 0;
+            }
+            return startSegment(segment, headSequence + 1);
+        }
+
+        // CRC-16/CCITT-FALSE
+        static uint16_t crc16(const uint8_t *data, size_t length)
+        {
+            uint16_t crc = 0xFFFF;
+            for (size_t i = 0; i < length; i++)
+            {
+                crc ^= (uint16_t)data[i] << 8;
+                for (int bit = 0; bit < 8; bit++)
+                    crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+            return crc;
+        }
+};
+
+#endif
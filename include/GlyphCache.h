@@ -0,0 +1,131 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+// Includes
+#include <string.h>
+#include "Hal.h"
+#include "GlyphCacheData.h"
+
+////////////////////////////////////////////////////////////////////
+// Pre-rendered, anti-aliased glyphs for the big numbers on the
+// weather screens (see tools/make_glyph_cache.py). Glyphs live in
+// flash as 4-bit alpha and are blended against the background while
+// they are pushed to the LCD, so a whole glyph goes out in a single
+// address window instead of one fillRect per font pixel like
+// setTextSize(n) does.
+//
+// Cached glyphs use the same 6x8 cell (times the text size) as the
+// built-in font, so they can be mixed with uncached characters.
+//
+// NOTE: the glyph data is defined in the header, so only include this
+// from one .cpp file per program.
+////////////////////////////////////////////////////////////////////
+class GlyphCache
+{
+    public:
+        // Returns the color already on screen at (x, y); used when the
+        // text sits on top of an image rather than a solid color
+        typedef uint16_t (*BackgroundSampler)(int x, int y);
+
+        // Longest cell row we blend at once (size 10 -> 60 pixels)
+        static const int MAX_ROW_PIXELS = 64;
+
+        //////////////////////////////////////////////////////////////
+        // Find the glyph for character c at the given text size, or
+        // nullptr if it is not in the cache
+        //////////////////////////////////////////////////////////////
+        static const uint8_t *find(char c, uint8_t textSize)
+        {
+            for (int s = 0; s < NUM_GLYPH_SETS; s++)
+            {
+                if (glyphSets[s].textSize != textSize)
+                    continue;
+                const char *match = strchr(glyphSets[s].chars, c);
+                if (c == '\0' || match == nullptr)
+                    return nullptr;
+                return glyphSets[s].glyphs[match - glyphSets[s].chars];
+            }
+            return nullptr;
+        }
+
+        static bool has(char c, uint8_t textSize) { return find(c, textSize) != nullptr; }
+
+        //////////////////////////////////////////////////////////////
+        // Blit a cached glyph (or an empty cell if glyph is nullptr).
+        // Without a sampler the 16 possible blends of color/bgColor are
+        // computed once and every pixel is a table lookup.
+        //////////////////////////////////////////////////////////////
+        static void blit(int x, int y, const uint8_t *glyph, uint8_t textSize, uint16_t color, uint16_t bgColor, BackgroundSampler sampler = nullptr)
+        {
+            HalDisplay &lcd = HalDisplay::lcd();
+            int w = 6 * textSize;
+            int h = 8 * textSize;
+            if (w > MAX_ROW_PIXELS || x < 0 || y < 0 || x + w > lcd.width() || y + h > lcd.height())
+                return;
+
+            uint16_t blend[16];
+            for (int a = 0; a < 16; a++)
+                blend[a] = HalDisplay::alphaBlend(a * 17, color, bgColor);
+
+            uint16_t row[MAX_ROW_PIXELS];
+            lcd.beginPush(x, y, w, h);
+            for (int j = 0; j < h; j++)
+            {
+                for (int i = 0; i < w; i++)
+                {
+                    int p = j * w + i;
+                    uint8_t alpha = 0;
+                    if (glyph != nullptr)
+                        alpha = (p & 1) ? (glyph[p >> 1] & 0x0F) : (glyph[p >> 1] >> 4);
+
+                    if (sampler == nullptr)
+                        row[i] = blend[alpha];
+                    else if (alpha == 15)
+                        row[i] = color;
+                    else
+                        row[i] = HalDisplay::alphaBlend(alpha * 17, color, sampler(x + i, y + j));
+                }
+                lcd.push(row, w);
+            }
+            lcd.endPush();
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Draw one character: from the cache if we have it, otherwise
+        // with the built-in font (opaque on bgColor, or on top of the
+        // sampled background)
+        //////////////////////////////////////////////////////////////
+        static void drawChar(int x, int y, char c, uint8_t textSize, uint16_t color, uint16_t bgColor, BackgroundSampler sampler = nullptr)
+        {
+            const uint8_t *glyph = find(c, textSize);
+            if (glyph != nullptr || c == ' ')
+            {
+                blit(x, y, glyph, textSize, color, bgColor, sampler);
+            }
+            else if (sampler == nullptr)
+            {
+                HalDisplay::lcd().drawChar(x, y, c, color, bgColor, textSize);
+            }
+            else
+            {
+                blit(x, y, nullptr, textSize, color, bgColor, sampler);
+                HalDisplay::lcd().drawChar(x, y, c, color, color, textSize);
+            }
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Draw a string starting at (x, y); returns the x just past
+        // the last character (like the text cursor would be)
+        //////////////////////////////////////////////////////////////
+        static int drawString(int x, int y, const char *text, uint8_t textSize, uint16_t color, uint16_t bgColor)
+        {
+            for (; *text != '\0'; text++)
+            {
+                drawChar(x, y, *text, textSize, color, bgColor);
+                x += 6 * textSize;
+            }
+            return x;
+        }
+};
+
+#endif
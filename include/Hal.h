@@ -0,0 +1,37 @@
+#ifndef HAL_H
+#define HAL_H
+
+////////////////////////////////////////////////////////////////////
+// Thin hardware abstraction for the code the apps share: renderers
+// (GlyphCache), sensor protocols (ImuFifo), the loop() scheduler and
+// (in HalNet.h) the BLE and HTTP protocols. The Core2 build uses the
+// ESP32 backend; building with -DHAL_LINUX swaps in a Linux one, so
+// the same code can be benchmarked, profiled with perf and run under
+// the sanitizers on a workstation (see tools/hal_native_bench.cpp).
+//
+// Both backends provide:
+//   halMillis(), halMicros(), halDelay(ms)
+//   halAttachInterrupt(pin, mode, fn, arg), halPinIsHigh(pin)
+//   halLightSleep(ms, pins, activeLow, n): true if a pin woke it
+//   halStartTask(fn, arg, name, stackBytes): run fn(arg) in its own
+//               task (thread), at the loop task's priority
+//   HalSignal   wakes a waiting loop thread; notify() is ISR safe
+//   HalDisplay  the 320x240 RGB565 LCD (HalDisplay::lcd())
+//   HalI2c      one I2C bus (HalI2c::internal() for the IMU, AXP
+//               and touch, HalI2c::external() for port A)
+//   HalFlash    a raw flash partition: read, write (clears bits
+//               only) and 4 KB sector erase
+//
+// The Linux backend draws into a framebuffer that can be dumped as a
+// PPM, and its I2C buses talk to simulated devices (HalI2cDevice)
+// that tools attach at an address; its flash is a byte array with
+// NOR erase/write rules. Screens that use the rest of the TFT_eSPI
+// API still call M5.Lcd directly and stay on the device.
+////////////////////////////////////////////////////////////////////
+#if defined(HAL_LINUX)
+#include "HalLinux.h"
+#else
+#include "HalEsp32.h"
+#endif
+
+#endif
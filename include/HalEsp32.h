@@ -0,0 +1,256 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+// Includes
+#include <M5Core2.h>
+#include <Wire.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <esp_partition.h>
+
+////////////////////////////////////////////////////////////////////
+// ESP32 / M5Core2 backend for Hal.h. Everything here is a thin
+// inline wrapper, so going through the HAL costs nothing on the
+// device.
+////////////////////////////////////////////////////////////////////
+
+// Time
+inline uint32_t halMillis() { return millis(); }
+inline uint32_t halMicros() { return micros(); }
+inline void halDelay(uint32_t ms) { delay(ms); }
+
+// Mode each pin was attached with, for halLightSleep() to put back
+inline int *halPinModes()
+{
+    static int modes[64];
+    return modes;
+}
+
+// GPIO interrupts (mode: RISING, FALLING or CHANGE)
+inline void halAttachInterrupt(int pin, int mode, void (*fn)(void *), void *arg)
+{
+    halPinModes()[pin & 63] = mode;
+    pinMode(pin, INPUT);
+    attachInterruptArg(digitalPinToInterrupt(pin), fn, arg, mode);
+}
+
+inline bool halPinIsHigh(int pin) { return digitalRead(pin) == HIGH; }
+
+// A FreeRTOS task next to loopTask, on either core. fn must never
+// return (a task that returns aborts); loop forever or delete itself.
+inline bool halStartTask(void (*fn)(void *), void *arg, const char *name, uint32_t stackBytes)
+{
+    return xTaskCreate(fn, name, stackBytes, arg, 1, nullptr) == pdPASS;
+}
+
+//////////////////////////////////////////////////////////////////
+// Light sleep for up to ms, or until one of the pins is at its
+// active level. Returns true if a pin woke it (the GPIO ISR doesn't
+// run for a wake-up from light sleep, so the caller has to check).
+//
+// gpio_wakeup_enable() makes the pin's interrupt level triggered;
+// left that way, a pin held at its level (a finger on the touch
+// screen) would fire the ISR nonstop. It gets its edge back after.
+//////////////////////////////////////////////////////////////////
+inline gpio_int_type_t halEdgeType(int mode)
+{
+    switch (mode)
+    {
+        case RISING:  return GPIO_INTR_POSEDGE;
+        case FALLING: return GPIO_INTR_NEGEDGE;
+        default:      return GPIO_INTR_ANYEDGE;
+    }
+}
+
+inline bool halLightSleep(uint32_t ms, const int *pins, const bool *activeLow, int numPins)
+{
+    // the UART stops with the clock: let it send what's queued
+    Serial.flush();
+
+    esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+    for (int i = 0; i < numPins; i++)
+        gpio_wakeup_enable((gpio_num_t)pins[i], activeLow[i] ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    if (numPins > 0)
+        esp_sleep_enable_gpio_wakeup();
+    esp_light_sleep_start();
+
+    for (int i = 0; i < numPins; i++)
+    {
+        gpio_wakeup_disable((gpio_num_t)pins[i]);
+        gpio_set_intr_type((gpio_num_t)pins[i], halEdgeType(halPinModes()[pins[i] & 63]));
+    }
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+}
+
+//////////////////////////////////////////////////////////////////
+// Wakes one waiting task: a FreeRTOS task notification. bind() from
+// the task that will wait().
+//////////////////////////////////////////////////////////////////
+class HalSignal
+{
+    public:
+        HalSignal() : task(nullptr) {}
+
+        void bind() { task = xTaskGetCurrentTaskHandle(); }
+        bool bound() const { return task != nullptr; }
+
+        void IRAM_ATTR notify()
+        {
+            if (task == nullptr)
+                return;
+            if (xPortInIsrContext())
+            {
+                BaseType_t woken = pdFALSE;
+                vTaskNotifyGiveFromISR(task, &woken);
+                if (woken)
+                    portYIELD_FROM_ISR();
+            }
+            else
+            {
+                xTaskNotifyGive(task);
+            }
+        }
+
+        // Sleep the task until notify() or ms have passed
+        void wait(uint32_t ms) { ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms)); }
+
+    private:
+        TaskHandle_t task;
+};
+
+//////////////////////////////////////////////////////////////////
+// The LCD, through M5.Lcd. push*() streams a block of pixels into
+// one address window, row by row.
+//////////////////////////////////////////////////////////////////
+class HalDisplay
+{
+    public:
+        static HalDisplay &lcd()
+        {
+            static HalDisplay display;
+            return display;
+        }
+
+        int width() const { return M5.Lcd.width(); }
+        int height() const { return M5.Lcd.height(); }
+
+        void fillRect(int x, int y, int w, int h, uint16_t color) { M5.Lcd.fillRect(x, y, w, h, color); }
+        void drawPixel(int x, int y, uint16_t color) { M5.Lcd.drawPixel(x, y, color); }
+
+        void beginPush(int x, int y, int w, int h)
+        {
+            M5.Lcd.startWrite();
+            M5.Lcd.setAddrWindow(x, y, w, h);
+        }
+        void push(const uint16_t *pixels, int count) { M5.Lcd.pushColors((uint16_t *)pixels, count, true); }
+        void endPush() { M5.Lcd.endWrite(); }
+
+        // Built-in 6x8 font character, scaled by size
+        void drawChar(int x, int y, char c, uint16_t color, uint16_t bgColor, uint8_t size)
+        {
+            M5.Lcd.drawChar(x, y, c, color, bgColor, size);
+        }
+
+        static uint16_t alphaBlend(uint8_t alpha, uint16_t fgColor, uint16_t bgColor)
+        {
+            return M5.Lcd.alphaBlend(alpha, fgColor, bgColor);
+        }
+};
+
+//////////////////////////////////////////////////////////////////
+// One I2C bus, through TwoWire. Register reads use a repeated start.
+//////////////////////////////////////////////////////////////////
+class HalI2c
+{
+    public:
+        explicit HalI2c(TwoWire &wire) : wire(wire) {}
+
+        // IMU, AXP and touch on the Core2
+        static HalI2c &internal()
+        {
+            static HalI2c bus(Wire1);
+            return bus;
+        }
+
+        // Port A (the Grove connector)
+        static HalI2c &external()
+        {
+            static HalI2c bus(Wire);
+            return bus;
+        }
+
+        bool begin(int sdaPin, int sclPin, uint32_t frequency) { return wire.begin(sdaPin, sclPin, frequency); }
+
+        // Raw transfers, for devices that take commands instead of
+        // register addresses
+        bool write(uint8_t address, const uint8_t *data, int length, bool stop = true)
+        {
+            wire.beginTransmission(address);
+            wire.write(data, length);
+            return wire.endTransmission(stop) == 0;
+        }
+
+        bool read(uint8_t address, uint8_t *buffer, int length)
+        {
+            if (wire.requestFrom(address, (uint8_t)length) != length)
+                return false;
+            for (int i = 0; i < length; i++)
+                buffer[i] = wire.read();
+            return true;
+        }
+
+        bool writeReg(uint8_t address, uint8_t reg, uint8_t value)
+        {
+            uint8_t data[2] = {reg, value};
+            return write(address, data, 2);
+        }
+
+        bool readRegs(uint8_t address, uint8_t reg, uint8_t *buffer, int length)
+        {
+            return write(address, &reg, 1, false) && read(address, buffer, length);
+        }
+
+    private:
+        TwoWire &wire;
+};
+
+//////////////////////////////////////////////////////////////////
+// A raw data partition in the SPI flash (see partitions.csv). NOR
+// flash: write() can only clear bits, so a range has to be erased
+// (a whole 4 KB sector at a time) before it is written again.
+//////////////////////////////////////////////////////////////////
+class HalFlash
+{
+    public:
+        static const uint32_t SECTOR_SIZE = 4096;
+
+        HalFlash() : partition(nullptr) {}
+
+        bool begin(const char *label)
+        {
+            partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+            return partition != nullptr;
+        }
+
+        uint32_t size() const { return partition != nullptr ? partition->size : 0; }
+
+        bool read(uint32_t offset, void *buffer, size_t length)
+        {
+            return esp_partition_read(partition, offset, buffer, length) == ESP_OK;
+        }
+
+        bool write(uint32_t offset, const void *data, size_t length)
+        {
+            return esp_partition_write(partition, offset, data, length) == ESP_OK;
+        }
+
+        bool eraseSector(uint32_t offset)
+        {
+            return esp_partition_erase_range(partition, offset, SECTOR_SIZE) == ESP_OK;
+        }
+
+    private:
+        const esp_partition_t *partition;
+};
+
+#endif
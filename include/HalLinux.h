@@ -0,0 +1,460 @@
+#ifndef HAL_LINUX_H
+#define HAL_LINUX_H
+
+// Includes
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////
+// Linux backend for Hal.h (build with -DHAL_LINUX). No SDL or other
+// libraries: the LCD is a framebuffer in memory that dumpPpm() writes
+// out, and the I2C buses route transfers to simulated devices that
+// the host program attaches. GPIO interrupts only fire when the host
+// calls halTriggerPin().
+////////////////////////////////////////////////////////////////////
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+#ifndef RISING
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define ONLOW 0x04
+#define ONHIGH 0x05
+#endif
+
+// Time, from the monotonic clock
+inline uint64_t halMonotonicMicros()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+inline uint32_t halMicros() { return (uint32_t)halMonotonicMicros(); }
+inline uint32_t halMillis() { return (uint32_t)(halMonotonicMicros() / 1000); }
+inline void halDelay(uint32_t ms) { usleep(ms * 1000); }
+
+//////////////////////////////////////////////////////////////////
+// GPIO: the host program sets pin levels and triggers the handlers
+//////////////////////////////////////////////////////////////////
+struct HalPin
+{
+    void (*fn)(void *);
+    void *arg;
+    int mode;    // as attached
+    int trigger; // what the interrupt fires on now (ONLOW/ONHIGH while asleep)
+    bool high;
+};
+
+inline HalPin *halPins()
+{
+    static HalPin pins[64];
+    return pins;
+}
+
+inline void halAttachInterrupt(int pin, int mode, void (*fn)(void *), void *arg)
+{
+    HalPin &p = halPins()[pin & 63];
+    p.fn = fn;
+    p.arg = arg;
+    p.mode = mode;
+    p.trigger = mode;
+}
+
+inline bool halPinIsHigh(int pin) { return halPins()[pin & 63].high; }
+
+// A detached thread (name and stack size don't apply)
+inline bool halStartTask(void (*fn)(void *), void *arg, const char *, uint32_t)
+{
+    std::thread(fn, arg).detach();
+    return true;
+}
+
+// Set a pin's level and run its handler if the edge matches. A level
+// triggered pin fires on every call while it is at its level, as the
+// ESP32 keeps re-entering a level ISR.
+inline void halTriggerPin(int pin, bool high)
+{
+    HalPin &p = halPins()[pin & 63];
+    bool rose = high && !p.high;
+    bool fell = !high && p.high;
+    p.high = high;
+    if (p.fn == nullptr)
+        return;
+    bool fire;
+    if (p.trigger == ONLOW || p.trigger == ONHIGH)
+        fire = high == (p.trigger == ONHIGH);
+    else
+        fire = (rose && (p.trigger & RISING)) || (fell && (p.trigger & FALLING));
+    if (fire)
+        p.fn(p.arg);
+}
+
+// Light sleeps so far, so tools can tell a sleep from a plain wait
+inline uint32_t &halLightSleepCount()
+{
+    static uint32_t count = 0;
+    return count;
+}
+
+//////////////////////////////////////////////////////////////////
+// No light sleep here: just sleep the thread. The wake pins go
+// level triggered for the sleep and get their edge back after it,
+// as on the ESP32, so a pin left at its wake level shows up here
+// too.
+//////////////////////////////////////////////////////////////////
+inline bool halLightSleep(uint32_t ms, const int *pins, const bool *activeLow, int numPins)
+{
+    halLightSleepCount()++;
+    bool woken = false;
+    for (int i = 0; i < numPins; i++)
+    {
+        HalPin &p = halPins()[pins[i] & 63];
+        p.trigger = activeLow[i] ? ONLOW : ONHIGH;
+        woken = woken || p.high != activeLow[i];
+    }
+    if (!woken)
+        halDelay(ms);
+    for (int i = 0; i < numPins; i++)
+    {
+        HalPin &p = halPins()[pins[i] & 63];
+        p.trigger = p.mode;
+        woken = woken || p.high != activeLow[i];
+    }
+    return woken;
+}
+
+//////////////////////////////////////////////////////////////////
+// Wakes one waiting thread; notify() may come from any thread
+//////////////////////////////////////////////////////////////////
+class HalSignal
+{
+    public:
+        HalSignal() : isBound(false), notified(false) {}
+
+        void bind() { isBound = true; }
+        bool bound() const { return isBound; }
+
+        void notify()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            notified = true;
+            wake.notify_one();
+        }
+
+        void wait(uint32_t ms)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(ms), [this] { return notified; });
+            notified = false;
+        }
+
+    private:
+        bool isBound;
+        bool notified;
+        std::mutex mutex;
+        std::condition_variable wake;
+};
+
+//////////////////////////////////////////////////////////////////
+// 320x240 RGB565 framebuffer. Counts pixels written so renderers can
+// be compared by how much they send to the LCD.
+//////////////////////////////////////////////////////////////////
+class HalDisplay
+{
+    public:
+        static const int WIDTH = 320;
+        static const int HEIGHT = 240;
+
+        static HalDisplay &lcd()
+        {
+            static HalDisplay display;
+            return display;
+        }
+
+        HalDisplay() : pushX(0), pushY(0), pushW(0), pushH(0), pushed(0), written(0)
+        {
+            memset(framebuffer, 0, sizeof(framebuffer));
+        }
+
+        int width() const { return WIDTH; }
+        int height() const { return HEIGHT; }
+
+        void fillRect(int x, int y, int w, int h, uint16_t color)
+        {
+            for (int j = y; j < y + h; j++)
+                for (int i = x; i < x + w; i++)
+                    drawPixel(i, j, color);
+        }
+
+        void drawPixel(int x, int y, uint16_t color)
+        {
+            written++;
+            if (x >= 0 && y >= 0 && x < WIDTH && y < HEIGHT)
+                framebuffer[y * WIDTH + x] = color;
+        }
+
+        void beginPush(int x, int y, int w, int h)
+        {
+            pushX = x;
+            pushY = y;
+            pushW = w;
+            pushH = h;
+            pushed = 0;
+        }
+
+        void push(const uint16_t *pixels, int count)
+        {
+            for (int i = 0; i < count && pushed < pushW * pushH; i++, pushed++)
+                drawPixel(pushX + pushed % pushW, pushY + pushed / pushW, pixels[i]);
+        }
+
+        void endPush() {}
+
+        // No font here: the cell is filled with the background
+        void drawChar(int x, int y, char c, uint16_t color, uint16_t bgColor, uint8_t size)
+        {
+            if (bgColor != color)
+                fillRect(x, y, 6 * size, 8 * size, bgColor);
+        }
+
+        // Same rounding as TFT_eSPI::alphaBlend()
+        static uint16_t alphaBlend(uint8_t alpha, uint16_t fgColor, uint16_t bgColor)
+        {
+            uint16_t fgR = ((fgColor >> 10) & 0x3E) + 1;
+            uint16_t fgG = ((fgColor >> 4) & 0x7E) + 1;
+            uint16_t fgB = ((fgColor << 1) & 0x3E) + 1;
+            uint16_t bgR = ((bgColor >> 10) & 0x3E) + 1;
+            uint16_t bgG = ((bgColor >> 4) & 0x7E) + 1;
+            uint16_t bgB = ((bgColor << 1) & 0x3E) + 1;
+            uint16_t r = ((fgR * alpha) + (bgR * (255 - alpha))) >> 9;
+            uint16_t g = ((fgG * alpha) + (bgG * (255 - alpha))) >> 9;
+            uint16_t b = ((fgB * alpha) + (bgB * (255 - alpha))) >> 9;
+            return (r << 11) | (g << 5) | b;
+        }
+
+        uint16_t pixel(int x, int y) const { return framebuffer[y * WIDTH + x]; }
+        uint32_t pixelsWritten() const { return written; }
+
+        // Binary PPM (P6), viewable with most image tools
+        bool dumpPpm(const char *path) const
+        {
+            FILE *file = fopen(path, "wb");
+            if (file == nullptr)
+                return false;
+            fprintf(file, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+            for (int i = 0; i < WIDTH * HEIGHT; i++)
+            {
+                uint16_t c = framebuffer[i];
+                uint8_t rgb[3] = {(uint8_t)((c >> 8) & 0xF8), (uint8_t)((c >> 3) & 0xFC), (uint8_t)((c << 3) & 0xF8)};
+                fwrite(rgb, 1, 3, file);
+            }
+            return fclose(file) == 0;
+        }
+
+    private:
+        uint16_t framebuffer[WIDTH * HEIGHT];
+        int pushX;
+        int pushY;
+        int pushW;
+        int pushH;
+        int pushed;
+        uint32_t written;
+};
+
+//////////////////////////////////////////////////////////////////
+// A simulated I2C device. HalRegisterDevice covers the usual "first
+// byte written is the register, then auto-increment" chips;
+// override readRegister()/autoIncrement() for FIFOs and other live
+// registers.
+//////////////////////////////////////////////////////////////////
+class HalI2cDevice
+{
+    public:
+        virtual ~HalI2cDevice() {}
+        virtual void write(const uint8_t *data, int length) = 0;
+        virtual void read(uint8_t *buffer, int length) = 0;
+};
+
+class HalRegisterDevice : public HalI2cDevice
+{
+    public:
+        HalRegisterDevice() : pointer(0) { memset(regs, 0, sizeof(regs)); }
+
+        void write(const uint8_t *data, int length)
+        {
+            if (length < 1)
+                return;
+            pointer = data[0];
+            for (int i = 1; i < length; i++)
+                writeRegister(pointer++, data[i]);
+        }
+
+        void read(uint8_t *buffer, int length)
+        {
+            for (int i = 0; i < length; i++)
+            {
+                buffer[i] = readRegister(pointer);
+                if (autoIncrement(pointer))
+                    pointer++;
+            }
+        }
+
+        virtual void writeRegister(uint8_t reg, uint8_t value) { regs[reg] = value; }
+        virtual uint8_t readRegister(uint8_t reg) { return regs[reg]; }
+
+        // FIFO data registers keep the pointer where it is
+        virtual bool autoIncrement(uint8_t reg) { return true; }
+
+    protected:
+        uint8_t regs[256];
+        uint8_t pointer;
+};
+
+//////////////////////////////////////////////////////////////////
+// A bus of simulated devices. Besides moving the bytes, it adds up
+// how long the transfers would take on the wire (9 clocks per byte
+// plus start/stop) so host runs can report bus time.
+//////////////////////////////////////////////////////////////////
+class HalI2c
+{
+    public:
+        HalI2c() : frequency(400000), transfers(0), busNanos(0)
+        {
+            for (int i = 0; i < 128; i++)
+                devices[i] = nullptr;
+        }
+
+        static HalI2c &internal()
+        {
+            static HalI2c bus;
+            return bus;
+        }
+
+        static HalI2c &external()
+        {
+            static HalI2c bus;
+            return bus;
+        }
+
+        bool begin(int sdaPin, int sclPin, uint32_t newFrequency)
+        {
+            frequency = newFrequency;
+            return true;
+        }
+
+        void attach(uint8_t address, HalI2cDevice *device) { devices[address & 0x7F] = device; }
+
+        bool write(uint8_t address, const uint8_t *data, int length, bool stop = true)
+        {
+            count(length);
+            HalI2cDevice *device = devices[address & 0x7F];
+            if (device == nullptr)
+                return false;
+            device->write(data, length);
+            return true;
+        }
+
+        bool read(uint8_t address, uint8_t *buffer, int length)
+        {
+            count(length);
+            HalI2cDevice *device = devices[address & 0x7F];
+            if (device == nullptr)
+                return false;
+            device->read(buffer, length);
+            return true;
+        }
+
+        bool writeReg(uint8_t address, uint8_t reg, uint8_t value)
+        {
+            uint8_t data[2] = {reg, value};
+            return write(address, data, 2);
+        }
+
+        bool readRegs(uint8_t address, uint8_t reg, uint8_t *buffer, int length)
+        {
+            return write(address, &reg, 1, false) && read(address, buffer, length);
+        }
+
+        uint32_t transferCount() const { return transfers; }
+        uint64_t busTimeMicros() const { return busNanos / 1000; }
+
+    private:
+        HalI2cDevice *devices[128];
+        uint32_t frequency;
+        uint32_t transfers;
+        uint64_t busNanos;
+
+        // address byte + data bytes, 9 clocks each, plus start/stop
+        void count(int length)
+        {
+            transfers++;
+            busNanos += (uint64_t)((length + 1) * 9 + 2) * 1000000000ULL / frequency;
+        }
+};
+
+//////////////////////////////////////////////////////////////////
+// Flash partition in memory with NOR semantics: erased bytes are
+// 0xFF, write() ANDs the data in (so writing a used range twice
+// shows up as corrupt data, as on the chip) and eraseSector() resets
+// one sector. Counts erases per sector for wear checks.
+//////////////////////////////////////////////////////////////////
+class HalFlash
+{
+    public:
+        static const uint32_t SECTOR_SIZE = 4096;
+
+        explicit HalFlash(uint32_t sectors = 64)
+            : memory(sectors * SECTOR_SIZE, 0xFF), erases(sectors, 0), writes(0) {}
+
+        bool begin(const char *label) { return true; }
+
+        uint32_t size() const { return memory.size(); }
+
+        bool read(uint32_t offset, void *buffer, size_t length)
+        {
+            if (offset + length > memory.size())
+                return false;
+            memcpy(buffer, &memory[offset], length);
+            return true;
+        }
+
+        bool write(uint32_t offset, const void *data, size_t length)
+        {
+            if (offset + length > memory.size())
+                return false;
+            const uint8_t *bytes = (const uint8_t *)data;
+            for (size_t i = 0; i < length; i++)
+                memory[offset + i] &= bytes[i];
+            writes++;
+            return true;
+        }
+
+        bool eraseSector(uint32_t offset)
+        {
+            if (offset % SECTOR_SIZE != 0 || offset >= memory.size())
+                return false;
+            memset(&memory[offset], 0xFF, SECTOR_SIZE);
+            erases[offset / SECTOR_SIZE]++;
+            return true;
+        }
+
+        uint32_t eraseCount(int sector) const { return erases[sector]; }
+        uint32_t writeCount() const { return writes; }
+
+    private:
+        std::vector<uint8_t> memory;
+        std::vector<uint32_t> erases;
+        uint32_t writes;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef HAL_NET_H
+#define HAL_NET_H
+
+////////////////////////////////////////////////////////////////////
+// Network side of the HAL (see Hal.h), kept apart so apps without a
+// radio don't pull in the BLE and HTTP libraries.
+//
+//   HalBleLink  the characteristic value two Core2s play through:
+//               attach() the server's own characteristic or the
+//               client's remote one, then write()/read() it. The
+//               Linux backend links both ends to one in-memory
+//               HalBleCharacteristic.
+//   HalHttp     one request with headers and an optional body;
+//               returns the status code (negative on failure) and
+//               copies the response into a buffer, or hands it to a
+//               HalHttpBody piece by piece as it comes off the
+//               socket. The Linux backend speaks plain HTTP/1.0 over
+//               a socket, so native runs point the URLs at a server
+//               on localhost.
+////////////////////////////////////////////////////////////////////
+
+// Includes
+#include <stddef.h>
+#include <string.h>
+
+// Where a streamed response goes: begin() once the status line and
+// headers are in, then write() for each piece of the body (already
+// de-chunked); returning false from write() stops the download
+class HalHttpBody
+{
+    public:
+        virtual ~HalHttpBody() {}
+        virtual void begin() {}
+        virtual bool write(const char *data, size_t length) = 0;
+};
+
+// Copies the body into a buffer, cut to size - 1 and NUL terminated
+// (buffer may be nullptr to throw the body away)
+class HalHttpBuffer : public HalHttpBody
+{
+    public:
+        HalHttpBuffer(char *buffer, size_t size) : buffer(buffer), size(size), length(0)
+        {
+            begin();
+        }
+
+        void begin()
+        {
+            length = 0;
+            if (buffer != nullptr && size > 0)
+                buffer[0] = '\0';
+        }
+
+        bool write(const char *data, size_t count)
+        {
+            if (buffer == nullptr || size == 0)
+                return true;
+            if (count > size - 1 - length)
+                count = size - 1 - length;
+            memcpy(buffer + length, data, count);
+            length += count;
+            buffer[length] = '\0';
+            return true;
+        }
+
+    private:
+        char *buffer;
+        size_t size;
+        size_t length;
+};
+
+#if defined(HAL_LINUX)
+#include "HalNetLinux.h"
+#else
+#include "HalNetEsp32.h"
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef HAL_NET_ESP32_H
+#define HAL_NET_ESP32_H
+
+// Includes
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include <HTTPClient.h>
+
+////////////////////////////////////////////////////////////////////
+// ESP32 backend for HalNet.h
+////////////////////////////////////////////////////////////////////
+class HalBleLink
+{
+    public:
+        HalBleLink() : local(nullptr), remote(nullptr) {}
+
+        // Server: our own characteristic
+        void attach(BLECharacteristic *characteristic)
+        {
+            local = characteristic;
+            remote = nullptr;
+        }
+
+        // Client: the server's characteristic
+        void attach(BLERemoteCharacteristic *characteristic)
+        {
+            remote = characteristic;
+            local = nullptr;
+        }
+
+        bool write(const char *value)
+        {
+            if (local != nullptr)
+                local->setValue(std::string(value));
+            else if (remote != nullptr)
+                remote->writeValue(std::string(value), true);
+            else
+                return false;
+            return true;
+        }
+
+        // Copies the value (NUL terminated) and returns its length
+        int read(char *buffer, int size)
+        {
+            std::string value;
+            if (local != nullptr)
+                value = local->getValue();
+            else if (remote != nullptr)
+                value = remote->readValue();
+            int length = value.length() < (size_t)size ? value.length() : size - 1;
+            memcpy(buffer, value.data(), length);
+            buffer[length] = '\0';
+            return length;
+        }
+
+    private:
+        BLECharacteristic *local;
+        BLERemoteCharacteristic *remote;
+};
+
+class HalHttp
+{
+    public:
+        //////////////////////////////////////////////////////////////
+        // method is "GET", "POST", ...; payload may be nullptr. The
+        // response body is streamed into body straight from the
+        // socket, through HTTPClient's own buffer (no String).
+        //////////////////////////////////////////////////////////////
+        static int request(const char *method, const char *url,
+                           const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                           const uint8_t *payload, size_t payloadLength,
+                           HalHttpBody &body)
+        {
+            HTTPClient http;
+            http.begin(url);
+            for (int i = 0; i < numHeaders; i++)
+                http.addHeader(headerKeys[i], headerVals[i]);
+
+            int code;
+            if (payload != nullptr)
+                code = http.sendRequest(method, (uint8_t *)payload, payloadLength);
+            else
+                code = http.sendRequest(method);
+
+            body.begin();
+            if (code > 0)
+            {
+                BodyStream stream(body);
+                http.writeToStream(&stream);
+            }
+            http.end();
+            return code;
+        }
+
+        // As above, with the response cut to responseSize - 1 bytes
+        // and NUL terminated (response may be nullptr to skip it)
+        static int request(const char *method, const char *url,
+                           const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                           const uint8_t *payload, size_t payloadLength,
+                           char *response, size_t responseSize)
+        {
+            HalHttpBuffer body(response, responseSize);
+            return request(method, url, headerKeys, headerVals, numHeaders, payload, payloadLength, body);
+        }
+
+        static int get(const char *url, const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                       char *response, size_t responseSize)
+        {
+            return request("GET", url, headerKeys, headerVals, numHeaders, nullptr, 0, response, responseSize);
+        }
+
+        static int get(const char *url, const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                       HalHttpBody &body)
+        {
+            return request("GET", url, headerKeys, headerVals, numHeaders, nullptr, 0, body);
+        }
+
+    private:
+        // What HTTPClient::writeToStream() writes to; a short write
+        // makes it stop
+        class BodyStream : public Stream
+        {
+            public:
+                explicit BodyStream(HalHttpBody &body) : body(body) {}
+
+                size_t write(const uint8_t *data, size_t length)
+                {
+                    return body.write((const char *)data, length) ? length : 0;
+                }
+
+                size_t write(uint8_t value) { return write(&value, 1); }
+                int available() { return 0; }
+                int read() { return -1; }
+                int peek() { return -1; }
+                void flush() {}
+
+            private:
+                HalHttpBody &body;
+        };
+};
+
+#endif
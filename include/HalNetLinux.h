@@ -0,0 +1,207 @@
+#ifndef HAL_NET_LINUX_H
+#define HAL_NET_LINUX_H
+
+// Includes
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <mutex>
+#include <string>
+
+////////////////////////////////////////////////////////////////////
+// Linux backend for HalNet.h
+////////////////////////////////////////////////////////////////////
+
+// The value both ends of a loopback link share
+class HalBleCharacteristic
+{
+    public:
+        HalBleCharacteristic() : writes(0) {}
+
+        void set(const char *newValue)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            value = newValue;
+            writes++;
+        }
+
+        std::string get()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return value;
+        }
+
+        uint32_t writeCount() const { return writes; }
+
+    private:
+        std::mutex mutex;
+        std::string value;
+        uint32_t writes;
+};
+
+class HalBleLink
+{
+    public:
+        HalBleLink() : characteristic(nullptr) {}
+
+        void attach(HalBleCharacteristic *shared) { characteristic = shared; }
+
+        bool write(const char *value)
+        {
+            if (characteristic == nullptr)
+                return false;
+            characteristic->set(value);
+            return true;
+        }
+
+        int read(char *buffer, int size)
+        {
+            std::string value = characteristic != nullptr ? characteristic->get() : std::string();
+            int length = value.length() < (size_t)size ? value.length() : size - 1;
+            memcpy(buffer, value.data(), length);
+            buffer[length] = '\0';
+            return length;
+        }
+
+    private:
+        HalBleCharacteristic *characteristic;
+};
+
+class HalHttp
+{
+    public:
+        static const int ERROR_URL = -1;     // not http://host[:port]/path
+        static const int ERROR_CONNECT = -2;
+        static const int ERROR_SEND = -3;
+        static const int ERROR_RESPONSE = -4;
+
+        static int request(const char *method, const char *url,
+                           const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                           const uint8_t *payload, size_t payloadLength,
+                           HalHttpBody &body)
+        {
+            // http://host[:port][/path] (no TLS here)
+            if (strncmp(url, "http://", 7) != 0)
+                return ERROR_URL;
+            const char *hostStart = url + 7;
+            const char *path = strchr(hostStart, '/');
+            std::string hostPort(hostStart, path != nullptr ? path - hostStart : strlen(hostStart));
+            if (path == nullptr)
+                path = "/";
+            std::string host = hostPort;
+            std::string port = "80";
+            size_t colon = hostPort.find(':');
+            if (colon != std::string::npos)
+            {
+                host = hostPort.substr(0, colon);
+                port = hostPort.substr(colon + 1);
+            }
+
+            int sock = connectTo(host.c_str(), port.c_str());
+            if (sock < 0)
+                return ERROR_CONNECT;
+
+            std::string head = std::string(method) + " " + path + " HTTP/1.0\r\nHost: " + hostPort + "\r\n";
+            for (int i = 0; i < numHeaders; i++)
+                head += std::string(headerKeys[i]) + ": " + headerVals[i] + "\r\n";
+            if (payload != nullptr)
+                head += "Content-Length: " + std::to_string(payloadLength) + "\r\n";
+            head += "\r\n";
+
+            if (!sendAll(sock, (const uint8_t *)head.data(), head.length()) ||
+                (payload != nullptr && !sendAll(sock, payload, payloadLength)))
+            {
+                close(sock);
+                return ERROR_SEND;
+            }
+
+            // Status line and headers
+            std::string reply;
+            char chunk[1024];
+            ssize_t n;
+            size_t bodyStart;
+            while ((bodyStart = reply.find("\r\n\r\n")) == std::string::npos &&
+                   (n = recv(sock, chunk, sizeof(chunk), 0)) > 0)
+                reply.append(chunk, n);
+
+            int code = 0;
+            if (sscanf(reply.c_str(), "HTTP/%*d.%*d %d", &code) != 1 || bodyStart == std::string::npos)
+            {
+                close(sock);
+                return ERROR_RESPONSE;
+            }
+
+            // HTTP/1.0: the body runs until the server closes the
+            // connection
+            body.begin();
+            bool more = body.write(reply.data() + bodyStart + 4, reply.length() - (bodyStart + 4));
+            while (more && (n = recv(sock, chunk, sizeof(chunk), 0)) > 0)
+                more = body.write(chunk, n);
+            close(sock);
+            return code;
+        }
+
+        static int request(const char *method, const char *url,
+                           const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                           const uint8_t *payload, size_t payloadLength,
+                           char *response, size_t responseSize)
+        {
+            HalHttpBuffer body(response, responseSize);
+            return request(method, url, headerKeys, headerVals, numHeaders, payload, payloadLength, body);
+        }
+
+        static int get(const char *url, const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                       char *response, size_t responseSize)
+        {
+            return request("GET", url, headerKeys, headerVals, numHeaders, nullptr, 0, response, responseSize);
+        }
+
+        static int get(const char *url, const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                       HalHttpBody &body)
+        {
+            return request("GET", url, headerKeys, headerVals, numHeaders, nullptr, 0, body);
+        }
+
+    private:
+        static int connectTo(const char *host, const char *port)
+        {
+            struct addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo *addresses;
+            if (getaddrinfo(host, port, &hints, &addresses) != 0)
+                return -1;
+
+            int sock = -1;
+            for (struct addrinfo *a = addresses; a != nullptr && sock < 0; a = a->ai_next)
+            {
+                sock = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (sock >= 0 && connect(sock, a->ai_addr, a->ai_addrlen) != 0)
+                {
+                    close(sock);
+                    sock = -1;
+                }
+            }
+            freeaddrinfo(addresses);
+            return sock;
+        }
+
+        static bool sendAll(int sock, const uint8_t *data, size_t length)
+        {
+            while (length > 0)
+            {
+                ssize_t n = send(sock, data, length, MSG_NOSIGNAL);
+                if (n <= 0)
+                    return false;
+                data += n;
+                length -= n;
+            }
+            return true;
+        }
+};
+
+#endif
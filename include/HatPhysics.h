@@ -0,0 +1,181 @@
+#ifndef HAT_PHYSICS_H
+#define HAT_PHYSICS_H
+
+// Includes
+#include <stdint.h>
+#include "Maze.h"
+#include "MazeGrid.h"
+
+////////////////////////////////////////////////////////////////////
+// Sub-tile movement for the hat in Q16.16 fixed point (no floats in
+// the step, so it's cheap and the same on every run). Positions are
+// maze pixels (tile col * 40 + 20 is the middle of a tile).
+//
+// Each step adds tilt * accelGain to the velocity, takes off a
+// fraction for friction, caps the speed and then moves one axis at
+// a time, stopping against walls. The hat (radius 10) fits in the
+// 30px floor of a tile, so its center can move in a "plus" shape:
+// the 10px square in the middle of the tile (LANE_MIN..LANE_MAX),
+// plus the lane towards each open side.
+//
+// Flower buds and ice lock the hat in the middle of the tile until
+// they are cleared, like the tile-by-tile version did.
+//
+// Keep maxSpeed under LANE_MIN (15 px/step) so a step never skips
+// over a tile.
+////////////////////////////////////////////////////////////////////
+typedef int32_t q16;
+
+const q16 Q16_ONE = 1 << 16;
+
+inline q16 toQ16(int value) { return (q16)value << 16; }
+inline q16 floatToQ16(float value) { return (q16)(value * Q16_ONE); }
+inline int q16ToInt(q16 value) { return value >> 16; }
+inline q16 q16Mul(q16 a, q16 b) { return (q16)(((int64_t)a * b) >> 16); }
+
+class HatPhysics
+{
+    public:
+        static const int TILE_SIZE = 40;
+        static const int HAT_RADIUS = 10;
+        static const int HALF_WALL = 5;
+        static const int LANE_MIN = HALF_WALL + HAT_RADIUS; // 15
+        static const int LANE_MAX = TILE_SIZE - LANE_MIN;   // 25
+
+        HatPhysics() : x(0), y(0), prevX(0), prevY(0), vx(0), vy(0), maxSpeed(Q16_ONE), accelGain(Q16_ONE / 8), friction(Q16_ONE / 32) {}
+
+        // Put the hat, stopped, in the middle of a tile
+        void reset(int col, int row)
+        {
+            x = prevX = toQ16(col * TILE_SIZE + TILE_SIZE / 2);
+            y = prevY = toQ16(row * TILE_SIZE + TILE_SIZE / 2);
+            vx = vy = 0;
+        }
+
+        // Speeds in px/step, gain in px/step^2 per g of tilt, friction
+        // as the fraction of speed lost each step
+        void setTuning(q16 newMaxSpeed, q16 newAccelGain, q16 newFriction)
+        {
+            maxSpeed = newMaxSpeed;
+            accelGain = newAccelGain;
+            friction = newFriction;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // One fixed time step. tiltX/tiltY are in g: +x tilts the hat
+        // right, +y tilts it down.
+        //////////////////////////////////////////////////////////////
+        void step(const MazeGrid &grid, q16 tiltX, q16 tiltY)
+        {
+            prevX = x;
+            prevY = y;
+
+            FloorType floor = grid.floor(col(), row());
+            if (floor == ICE || floor == FLOWER)
+            {
+                reset(col(), row());
+                prevX = x;
+                prevY = y;
+                return;
+            }
+
+            vx = limitSpeed(vx + q16Mul(tiltX, accelGain) - q16Mul(vx, friction));
+            vy = limitSpeed(vy + q16Mul(tiltY, accelGain) - q16Mul(vy, friction));
+
+            q16 nx = clampX(grid, x + vx);
+            if (nx != x + vx)
+                vx = 0;
+            x = nx;
+
+            q16 ny = clampY(grid, y + vy);
+            if (ny != y + vy)
+                vy = 0;
+            y = ny;
+        }
+
+        // Tile the center of the hat is in
+        int col() const { return q16ToInt(x) / TILE_SIZE; }
+        int row() const { return q16ToInt(y) / TILE_SIZE; }
+
+        bool isMoving() const { return vx != 0 || vy != 0; }
+
+        //////////////////////////////////////////////////////////////
+        // Position between the last two steps, alpha in [0, 1] (Q16),
+        // for drawing faster than the physics runs
+        //////////////////////////////////////////////////////////////
+        void interpolate(q16 alpha, int *px, int *py) const
+        {
+            if (alpha < 0)
+                alpha = 0;
+            if (alpha > Q16_ONE)
+                alpha = Q16_ONE;
+            *px = q16ToInt(prevX + q16Mul(x - prevX, alpha));
+            *py = q16ToInt(prevY + q16Mul(y - prevY, alpha));
+        }
+
+    private:
+        q16 x;
+        q16 y;
+        q16 prevX;
+        q16 prevY;
+        q16 vx;
+        q16 vy;
+        q16 maxSpeed;
+        q16 accelGain;
+        q16 friction;
+
+        q16 limitSpeed(q16 v) const
+        {
+            if (v > maxSpeed)
+                return maxSpeed;
+            if (v < -maxSpeed)
+                return -maxSpeed;
+            return v;
+        }
+
+        // Is the other coordinate inside the middle lane of its tile?
+        static bool inLane(q16 value)
+        {
+            q16 local = value - toQ16((q16ToInt(value) / TILE_SIZE) * TILE_SIZE);
+            return local >= toQ16(LANE_MIN) && local <= toQ16(LANE_MAX);
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Walls: inside the horizontal lane the hat can go on into the
+        // next tile if that side is open; otherwise it stays in the
+        // middle square of its tile
+        //////////////////////////////////////////////////////////////
+        q16 clampX(const MazeGrid &grid, q16 nx) const
+        {
+            int c = col();
+            int r = row();
+            q16 lo = toQ16(c * TILE_SIZE + LANE_MIN);
+            q16 hi = toQ16(c * TILE_SIZE + LANE_MAX);
+            if (inLane(y))
+            {
+                if (grid.canMove(c, r, OPEN_LEFT))
+                    lo = toQ16((c - 1) * TILE_SIZE + LANE_MIN);
+                if (grid.canMove(c, r, OPEN_RIGHT))
+                    hi = toQ16((c + 1) * TILE_SIZE + LANE_MAX);
+            }
+            return nx < lo ? lo : nx > hi ? hi : nx;
+        }
+
+        q16 clampY(const MazeGrid &grid, q16 ny) const
+        {
+            int c = col();
+            int r = row();
+            q16 lo = toQ16(r * TILE_SIZE + LANE_MIN);
+            q16 hi = toQ16(r * TILE_SIZE + LANE_MAX);
+            if (inLane(x))
+            {
+                if (grid.canMove(c, r, OPEN_ABOVE))
+                    lo = toQ16((r - 1) * TILE_SIZE + LANE_MIN);
+                if (grid.canMove(c, r, OPEN_BELOW))
+                    hi = toQ16((r + 1) * TILE_SIZE + LANE_MAX);
+            }
+            return ny < lo ? lo : ny > hi ? hi : ny;
+        }
+};
+
+#endif
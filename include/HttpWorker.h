@@ -0,0 +1,200 @@
+#ifndef HTTP_WORKER_H
+#define HTTP_WORKER_H
+
+// Includes
+#include "Hal.h"
+#include "HalNet.h"
+#include "Scheduler.h"
+
+////////////////////////////////////////////////////////////////////
+// One HTTP GET at a time in a background task, so a slow cloud round
+// trip doesn't stall loop(): the scheduler keeps sampling, uploading
+// and drawing while it runs, and the worker posts an event when the
+// answer is in.
+//
+//   HttpWorker average(scheduler, EVENT_AVERAGE_DONE);
+//   average.begin();                          // in setup()
+//   average.get(url, keys, vals, 1, &parser); // returns at once
+//   scheduler.onEvent(EVENT_AVERAGE_DONE, showAverage);
+//   void showAverage() { if (average.done()) use(parser); }
+//   average.cancel();                         // drop the answer
+//
+// The body streams into the HalHttpBody given with the request (see
+// HalNet.h), from the worker task; a parser there sees it as it comes
+// off the socket and nothing keeps the text.
+//
+// The request can't be aborted halfway (HTTPClient has no way to),
+// so cancel() just makes the worker forget it: done() never turns
+// true for it, and a get() after it waits in a one-deep queue until
+// the old request has timed out or finished. A newer get() replaces a
+// request that is still queued. The loop task calls everything but
+// the worker's own task function.
+//
+// The loop task and the worker hand requests over through a slot with
+// an atomic state (no locks). A request's body belongs to the worker
+// until done() is true for it; nothing writes to it after that, since
+// only a later get() gives the worker more to do. Don't hand a body
+// that a cancelled request may still be writing to anything but a
+// later get().
+////////////////////////////////////////////////////////////////////
+class HttpWorker
+{
+    public:
+        static const int MAX_URL = 160;
+        static const int MAX_HEADERS = 2;
+        static const int MAX_KEY = 32;
+        static const int MAX_VALUE = 192;
+        static const uint32_t STACK_BYTES = 8192; // as loopTask, which ran these before
+
+        HttpWorker(Scheduler &scheduler, int doneEvent)
+            : scheduler(scheduler), doneEvent(doneEvent), started(false), slot(SLOT_EMPTY),
+              lastTicket(0), current(0), finished(0), status(0), elapsed(0) {}
+
+        // Start the worker task; false if it couldn't be created
+        bool begin(const char *name = "http")
+        {
+            if (!started)
+                started = halStartTask(taskMain, this, name, STACK_BYTES);
+            return started;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Queue a GET with the given headers; its body goes to body
+        // (nullptr to throw it away). Returns false if the worker
+        // isn't running or the request doesn't fit.
+        //////////////////////////////////////////////////////////////
+        bool get(const char *url, const char *const *headerKeys, const char *const *headerVals, int numHeaders,
+                 HalHttpBody *body)
+        {
+            if (!started || numHeaders > MAX_HEADERS || strlen(url) >= (size_t)MAX_URL)
+                return false;
+            for (int i = 0; i < numHeaders; i++)
+                if (strlen(headerKeys[i]) >= (size_t)MAX_KEY || strlen(headerVals[i]) >= (size_t)MAX_VALUE)
+                    return false;
+
+            // Claim the slot (empty, or full with a request nobody
+            // wants any more); the worker only holds it for a copy
+            for (;;)
+            {
+                uint8_t state = __atomic_load_n(&slot, __ATOMIC_ACQUIRE);
+                if (state != SLOT_TAKING &&
+                    __atomic_compare_exchange_n(&slot, &state, SLOT_FILLING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                    break;
+                halDelay(1);
+            }
+
+            uint32_t ticket = ++lastTicket;
+            if (ticket == 0)
+                ticket = ++lastTicket; // 0 means "none"
+            next.ticket = ticket;
+            next.body = body;
+            strcpy(next.url, url);
+            next.numHeaders = numHeaders;
+            for (int i = 0; i < numHeaders; i++)
+            {
+                strcpy(next.keys[i], headerKeys[i]);
+                strcpy(next.vals[i], headerVals[i]);
+            }
+            __atomic_store_n(&current, ticket, __ATOMIC_RELEASE);
+            __atomic_store_n(&slot, (uint8_t)SLOT_FULL, __ATOMIC_RELEASE);
+            wake.notify();
+            return true;
+        }
+
+        // Forget the current request; its answer is dropped
+        void cancel() { __atomic_store_n(&current, 0U, __ATOMIC_RELEASE); }
+
+        // The last get() is still on its way
+        bool pending() const
+        {
+            uint32_t ticket = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+            return ticket != 0 && __atomic_load_n(&finished, __ATOMIC_ACQUIRE) != ticket;
+        }
+
+        // The last get() has been answered (or failed)
+        bool done() const
+        {
+            uint32_t ticket = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+            return ticket != 0 && __atomic_load_n(&finished, __ATOMIC_ACQUIRE) == ticket;
+        }
+
+        // Once done(): status code (negative on failure) and the time
+        // the request itself took
+        int code() const { return status; }
+        uint32_t elapsedMs() const { return elapsed; }
+
+    private:
+        enum SlotState
+        {
+            SLOT_EMPTY,
+            SLOT_FILLING, // loop task writing
+            SLOT_FULL,
+            SLOT_TAKING   // worker copying
+        };
+
+        struct Request
+        {
+            uint32_t ticket;
+            HalHttpBody *body;
+            char url[MAX_URL];
+            char keys[MAX_HEADERS][MAX_KEY];
+            char vals[MAX_HEADERS][MAX_VALUE];
+            int numHeaders;
+        };
+
+        Scheduler &scheduler;
+        int doneEvent;
+        bool started;
+        HalSignal wake; // the worker sleeps on this
+        uint8_t slot;
+        Request next;   // written by the loop task while SLOT_FILLING
+        Request active; // the worker's copy
+        uint32_t lastTicket;
+        uint32_t current;  // ticket the loop task waits for, 0 if none
+        uint32_t finished; // ticket of the last answered request
+        int status;
+        uint32_t elapsed;
+
+        static void taskMain(void *arg)
+        {
+            HttpWorker *worker = (HttpWorker *)arg;
+            worker->wake.bind();
+            for (;;)
+                worker->serveNext();
+        }
+
+        void serveNext()
+        {
+            uint8_t state = SLOT_FULL;
+            if (!__atomic_compare_exchange_n(&slot, &state, SLOT_TAKING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            {
+                wake.wait(1000);
+                return;
+            }
+            active = next;
+            __atomic_store_n(&slot, (uint8_t)SLOT_EMPTY, __ATOMIC_RELEASE);
+
+            // Cancelled while it was queued
+            if (__atomic_load_n(&current, __ATOMIC_ACQUIRE) != active.ticket)
+                return;
+
+            const char *keys[MAX_HEADERS];
+            const char *vals[MAX_HEADERS];
+            for (int i = 0; i < active.numHeaders; i++)
+            {
+                keys[i] = active.keys[i];
+                vals[i] = active.vals[i];
+            }
+            uint32_t start = halMillis();
+            HalHttpBuffer discard(nullptr, 0);
+            status = HalHttp::get(active.url, keys, vals, active.numHeaders,
+                                  active.body != nullptr ? *active.body : discard);
+            elapsed = halMillis() - start;
+
+            __atomic_store_n(&finished, active.ticket, __ATOMIC_RELEASE);
+            if (__atomic_load_n(&current, __ATOMIC_ACQUIRE) == active.ticket)
+                scheduler.post(doneEvent);
+        }
+};
+
+#endif
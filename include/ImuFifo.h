@@ -0,0 +1,262 @@
+#ifndef IMU_FIFO_H
+#define IMU_FIFO_H
+
+// Includes
+#include "Hal.h"
+
+////////////////////////////////////////////////////////////////////
+// MPU6886 sampling through its FIFO. The chip samples accel + gyro
+// at a fixed rate into its 1 KB FIFO by itself; we drain it in burst
+// reads (up to 9 packets per I2C transaction) and stamp each sample
+// with the time it was taken, working back from the drain time.
+// Samples land in a ring buffer that the app reads at its own pace.
+//
+// Call M5.IMU.Init() first: it powers the chip and sets the ranges
+// (+-8 g, +-2000 dps) that the conversions below assume.
+//
+// Drains happen from poll() on the loop thread (the I2C driver can't
+// be used from an ISR). With an interrupt pin, the watermark interrupt
+// tells poll() when to drain; without one, poll() waits until enough
+// samples for the watermark should be in the FIFO before even reading
+// the FIFO count, so it never spins on the bus.
+////////////////////////////////////////////////////////////////////
+struct ImuSample
+{
+    uint32_t timeUs; // halMicros() when the sample was taken
+    int16_t accel[3];
+    int16_t gyro[3];
+};
+
+class ImuFifo
+{
+    public:
+        static const uint8_t ADDRESS = 0x68;
+        static const int PACKET_SIZE = 14; // accel x/y/z, temp, gyro x/y/z
+        static const int MAX_BURST_PACKETS = 9; // 126 bytes, fits the Wire buffer
+        static const int FIFO_BYTES = 1024;
+        static const int RING_SIZE = 128; // power of two
+
+        explicit ImuFifo(HalI2c &bus = HalI2c::internal())
+            : bus(bus), periodUs(0), watermark(1), interruptPin(-1), head(0), tail(0),
+              nextDrainUs(0), dropped(0), overflows(0), transactions(0) {}
+
+        //////////////////////////////////////////////////////////////
+        // Start sampling at sampleHz (4-1000) and drain once
+        // watermarkSamples are waiting. Pass the GPIO wired to the
+        // MPU6886 INT line to use the watermark interrupt, or -1 to
+        // poll. Returns false if the chip doesn't answer.
+        //////////////////////////////////////////////////////////////
+        bool begin(uint16_t sampleHz, uint8_t watermarkSamples, int intPin = -1)
+        {
+            if (sampleHz < 4)
+                sampleHz = 4;
+            if (sampleHz > 1000)
+                sampleHz = 1000;
+            if (watermarkSamples < 1)
+                watermarkSamples = 1;
+            if (watermarkSamples > FIFO_BYTES / PACKET_SIZE / 2)
+                watermarkSamples = FIFO_BYTES / PACKET_SIZE / 2;
+
+            uint8_t whoAmI;
+            if (!readRegs(REG_WHO_AM_I, &whoAmI, 1) || whoAmI != WHO_AM_I_MPU6886)
+                return false;
+
+            // 1 kHz internal rate (DLPF on), divided down to sampleHz
+            uint8_t divider = 1000 / sampleHz - 1;
+            periodUs = 1000000UL / (1000 / (divider + 1));
+            watermark = watermarkSamples;
+
+            writeReg(REG_USER_CTRL, 0x00);  // FIFO off while we set it up
+            writeReg(REG_FIFO_EN, 0x00);
+            writeReg(REG_SMPLRT_DIV, divider);
+            writeReg(REG_CONFIG, 0x01);     // gyro DLPF 176 Hz, FIFO overwrites oldest when full
+            writeReg(REG_ACCEL_CONFIG2, 0x01); // accel DLPF 218 Hz
+            uint16_t threshold = watermark * PACKET_SIZE;
+            writeReg(REG_FIFO_WM_TH1, threshold >> 8);
+            writeReg(REG_FIFO_WM_TH2, threshold & 0xFF);
+
+            interruptPin = intPin;
+            if (interruptPin >= 0)
+            {
+                writeReg(REG_INT_PIN_CFG, 0x00);  // active high, push-pull, 50 us pulse
+                writeReg(REG_INT_ENABLE, 0x10);   // FIFO overflow (watermark is on while WM_TH != 0)
+                halAttachInterrupt(interruptPin, RISING, onInterrupt, nullptr);
+            }
+            else
+            {
+                writeReg(REG_INT_ENABLE, 0x00);
+            }
+
+            writeReg(REG_USER_CTRL, USER_CTRL_FIFO_RST);
+            writeReg(REG_FIFO_EN, FIFO_EN_GYRO | FIFO_EN_ACCEL);
+            writeReg(REG_USER_CTRL, USER_CTRL_FIFO_EN);
+
+            head = tail = 0;
+            interruptPending() = false;
+            nextDrainUs = halMicros() + watermark * periodUs;
+            return true;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Call every loop(). Drains the FIFO when the watermark has
+        // been reached; otherwise it doesn't touch the bus. Returns
+        // the number of new samples.
+        //////////////////////////////////////////////////////////////
+        int poll()
+        {
+            if (periodUs == 0)
+                return 0;
+
+            if (interruptPin >= 0)
+            {
+                if (!interruptPending())
+                    return 0;
+                interruptPending() = false;
+            }
+            else if ((int32_t)(halMicros() - nextDrainUs) < 0)
+            {
+                return 0;
+            }
+
+            int count = drain();
+            nextDrainUs = halMicros() + watermark * periodUs;
+            return count;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Read everything in the FIFO now. Returns the number of new
+        // samples (0 if the bus failed).
+        //////////////////////////////////////////////////////////////
+        int drain()
+        {
+            uint8_t countBytes[2];
+            if (!readRegs(REG_FIFO_COUNTH, countBytes, 2))
+                return 0;
+            uint32_t now = halMicros();
+            int packets = (((countBytes[0] & 0x1F) << 8) | countBytes[1]) / PACKET_SIZE;
+
+            // a full FIFO has lost samples and may hold a partial packet
+            if (packets * PACKET_SIZE >= FIFO_BYTES - PACKET_SIZE)
+            {
+                overflows++;
+                writeReg(REG_USER_CTRL, USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RST);
+                return 0;
+            }
+
+            uint8_t burst[MAX_BURST_PACKETS * PACKET_SIZE];
+            for (int done = 0; done < packets;)
+            {
+                int n = packets - done;
+                if (n > MAX_BURST_PACKETS)
+                    n = MAX_BURST_PACKETS;
+                if (!readRegs(REG_FIFO_R_W, burst, n * PACKET_SIZE))
+                    return done;
+
+                for (int i = 0; i < n; i++)
+                {
+                    // the newest packet was taken about now
+                    uint32_t age = (uint32_t)(packets - 1 - (done + i)) * periodUs;
+                    push(burst + i * PACKET_SIZE, now - age);
+                }
+                done += n;
+            }
+            return packets;
+        }
+
+        int available() const { return (head - tail) & (RING_SIZE - 1); }
+
+        // Oldest sample not read yet
+        bool read(ImuSample *sample)
+        {
+            if (head == tail)
+                return false;
+            *sample = ring[tail];
+            tail = (tail + 1) & (RING_SIZE - 1);
+            return true;
+        }
+
+        uint32_t samplePeriodUs() const { return periodUs; }
+
+        // Samples lost because the ring (dropped) or FIFO (overflows)
+        // filled up, and I2C transactions so far
+        uint32_t droppedSamples() const { return dropped; }
+        uint32_t fifoOverflows() const { return overflows; }
+        uint32_t busTransactions() const { return transactions; }
+
+        static float toG(int16_t raw) { return raw * (8.0f / 32768.0f); }
+        static float toDps(int16_t raw) { return raw * (2000.0f / 32768.0f); }
+
+    private:
+        static const uint8_t WHO_AM_I_MPU6886 = 0x19;
+        static const uint8_t REG_SMPLRT_DIV = 0x19;
+        static const uint8_t REG_CONFIG = 0x1A;
+        static const uint8_t REG_ACCEL_CONFIG2 = 0x1D;
+        static const uint8_t REG_FIFO_EN = 0x23;
+        static const uint8_t REG_INT_PIN_CFG = 0x37;
+        static const uint8_t REG_INT_ENABLE = 0x38;
+        static const uint8_t REG_FIFO_WM_TH1 = 0x60;
+        static const uint8_t REG_FIFO_WM_TH2 = 0x61;
+        static const uint8_t REG_USER_CTRL = 0x6A;
+        static const uint8_t REG_FIFO_COUNTH = 0x72;
+        static const uint8_t REG_FIFO_R_W = 0x74;
+        static const uint8_t REG_WHO_AM_I = 0x75;
+        static const uint8_t FIFO_EN_GYRO = 0x10;
+        static const uint8_t FIFO_EN_ACCEL = 0x08;
+        static const uint8_t USER_CTRL_FIFO_EN = 0x40;
+        static const uint8_t USER_CTRL_FIFO_RST = 0x04;
+
+        HalI2c &bus;
+        uint32_t periodUs;
+        uint8_t watermark;
+        int interruptPin;
+        ImuSample ring[RING_SIZE];
+        int head;
+        int tail;
+        uint32_t nextDrainUs;
+        uint32_t dropped;
+        uint32_t overflows;
+        uint32_t transactions;
+
+        // Set by the watermark interrupt (function static so the header
+        // can be included anywhere)
+        static volatile bool &interruptPending()
+        {
+            static volatile bool pending = false;
+            return pending;
+        }
+
+        static void IRAM_ATTR onInterrupt(void *arg) { interruptPending() = true; }
+
+        // Unpack one big-endian FIFO packet into the ring, overwriting
+        // the oldest sample if the app hasn't kept up
+        void push(const uint8_t *packet, uint32_t timeUs)
+        {
+            ImuSample &sample = ring[head];
+            sample.timeUs = timeUs;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                sample.accel[axis] = (int16_t)((packet[axis * 2] << 8) | packet[axis * 2 + 1]);
+                sample.gyro[axis] = (int16_t)((packet[8 + axis * 2] << 8) | packet[8 + axis * 2 + 1]);
+            }
+            head = (head + 1) & (RING_SIZE - 1);
+            if (head == tail)
+            {
+                tail = (tail + 1) & (RING_SIZE - 1);
+                dropped++;
+            }
+        }
+
+        void writeReg(uint8_t reg, uint8_t value)
+        {
+            transactions++;
+            bus.writeReg(ADDRESS, reg, value);
+        }
+
+        bool readRegs(uint8_t reg, uint8_t *buffer, int length)
+        {
+            transactions++;
+            return bus.readRegs(ADDRESS, reg, buffer, length);
+        }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef MAZE_H
+#define MAZE_H
+
+// Includes
+#include <stdint.h>
+#include <stddef.h>
+
+////////////////////////////////////////////////////////////////////
+// Types shared by the a-MAZE-ing game and its renderer
+////////////////////////////////////////////////////////////////////
+
+// floor types
+enum FloorType
+{
+    FLOWER,
+    ICE,
+    WALKABLE,
+    BLOOMED,
+    STARTTILE
+};
+const int NUM_FLOOR_TYPES = 5;
+
+// Which sides of a tile are open (no wall), packed into 4 bits.
+// The 16 combinations index the tile atlas.
+const uint8_t OPEN_LEFT = 0x01;
+const uint8_t OPEN_RIGHT = 0x02;
+const uint8_t OPEN_ABOVE = 0x04;
+const uint8_t OPEN_BELOW = 0x08;
+const int NUM_WALL_CONFIGS = 16;
+
+////////////////////////////////////////////////////////////////////
+// Binary maze format (see tools/make_maze_levels.py)
+//
+//   byte 0-1   'M' 'Z'
+//   byte 2     format version (1)
+//   byte 3-4   width, height (cells)
+//   byte 5-6   start x, y
+//   byte 7-8   end x, y
+//   byte 9     number of flowers to bloom
+//   byte 10-   one byte per cell, row by row:
+//                bits 0-3  OPEN_* bits
+//                bits 4-6  FloorType
+////////////////////////////////////////////////////////////////////
+const int MAZE_HEADER_SIZE = 10;
+const uint8_t MAZE_FORMAT_VERSION = 1;
+
+struct MazeHeader
+{
+    uint8_t width;
+    uint8_t height;
+    uint8_t startX;
+    uint8_t startY;
+    uint8_t endX;
+    uint8_t endY;
+    uint8_t flowersToBloom;
+};
+
+// Check the header of a maze image and read it. Returns false if
+// this isn't a maze we can load.
+inline bool parseMazeHeader(const uint8_t *data, size_t length, MazeHeader *header)
+{
+    if (length < (size_t)MAZE_HEADER_SIZE || data[0] != 'M' || data[1] != 'Z' || data[2] != MAZE_FORMAT_VERSION)
+        return false;
+
+    header->width = data[3];
+    header->height = data[4];
+    header->startX = data[5];
+    header->startY = data[6];
+    header->endX = data[7];
+    header->endY = data[8];
+    header->flowersToBloom = data[9];
+
+    return length >= (size_t)MAZE_HEADER_SIZE + header->width * header->height &&
+           header->startX < header->width && header->startY < header->height &&
+           header->endX < header->width && header->endY < header->height;
+}
+
+// Cell byte accessors
+constexpr uint8_t mazeCell(uint8_t openings, FloorType floor) { return (openings & 0x0F) | ((uint8_t)floor << 4); }
+constexpr uint8_t mazeCellOpenings(uint8_t cell) { return cell & 0x0F; }
+constexpr FloorType mazeCellFloor(uint8_t cell) { return (FloorType)((cell >> 4) & 0x07); }
+
+#endif
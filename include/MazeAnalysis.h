@@ -0,0 +1,256 @@
+#ifndef MAZE_ANALYSIS_H
+#define MAZE_ANALYSIS_H
+
+// Includes
+#include "Maze.h"
+#include "MazeGrid.h"
+
+////////////////////////////////////////////////////////////////////
+// Distance fields for a loaded maze. analyze() runs one BFS from the
+// end and one from each flower bud over the walls and keeps them as
+// uint16_t steps per cell. After that, everything during play is a
+// lookup:
+//   - distance from any cell to the end or to flower i
+//   - hint(): which way to go next (towards the nearest bud that
+//     hasn't bloomed, or the end once enough have)
+//   - parSteps(): the shortest start -> flowers -> end route, worked
+//     out once with a DP over subsets of flowers
+// analyze() also fails for mazes that can't be finished.
+//
+// The fields share one pool, packed at width * height cells each, so
+// small mazes get a field for every flower (up to MAX_FLOWERS) and the
+// largest ones still fit a few. No Arduino dependencies.
+////////////////////////////////////////////////////////////////////
+class MazeAnalysis
+{
+    public:
+        static const int MAX_CELLS = MazeGrid::MAX_WIDTH * MazeGrid::MAX_HEIGHT;
+        static const int MAX_FLOWERS = 8;
+        static const int POOL_CELLS = 4 * MAX_CELLS;
+        static const uint16_t UNREACHABLE = 0xFFFF;
+
+        MazeAnalysis() : width(0), cells(0), numFields(0), numFlowerTiles(0), par(UNREACHABLE) {}
+
+        //////////////////////////////////////////////////////////////
+        // BFS from (x, y) over open walls. dist gets the number of
+        // steps to each cell (row major) or UNREACHABLE; queue needs
+        // room for every cell. Returns the number of cells reached.
+        //////////////////////////////////////////////////////////////
+        static int bfs(const MazeGrid &grid, int x, int y, uint16_t *dist, uint16_t *queue)
+        {
+            static const uint8_t dirs[4] = {OPEN_LEFT, OPEN_RIGHT, OPEN_ABOVE, OPEN_BELOW};
+            int w = grid.width();
+            int count = w * grid.height();
+            for (int i = 0; i < count; i++)
+                dist[i] = UNREACHABLE;
+
+            int head = 0;
+            int tail = 0;
+            dist[y * w + x] = 0;
+            queue[tail++] = y * w + x;
+            while (head < tail)
+            {
+                int cell = queue[head++];
+                int cx = cell % w;
+                int cy = cell / w;
+                for (int d = 0; d < 4; d++)
+                {
+                    if (!grid.canMove(cx, cy, dirs[d]))
+                        continue;
+                    int next = (cy + MazeGrid::dy(dirs[d])) * w + cx + MazeGrid::dx(dirs[d]);
+                    if (dist[next] == UNREACHABLE)
+                    {
+                        dist[next] = dist[cell] + 1;
+                        queue[tail++] = next;
+                    }
+                }
+            }
+            return tail;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Build the fields for a freshly loaded maze (call before any
+        // flower blooms). Returns false if the end or enough flowers
+        // can't be reached from the start; *reason says which.
+        //////////////////////////////////////////////////////////////
+        bool analyze(const MazeGrid &grid, const MazeHeader &header, const char **reason = nullptr)
+        {
+            const char *unused;
+            if (reason == nullptr)
+                reason = &unused;
+
+            width = grid.width();
+            cells = width * grid.height();
+            start = header.startY * width + header.startX;
+            toBloom = header.flowersToBloom;
+            numFlowerTiles = 0;
+            par = UNREACHABLE;
+
+            // field 0 is the end, then one per flower while they fit
+            bfs(grid, header.endX, header.endY, pool, queue);
+            numFields = 1;
+            for (int i = 0; i < cells; i++)
+            {
+                if (grid.floor(i % width, i / width) != FLOWER)
+                    continue;
+                numFlowerTiles++;
+                if (numFields <= MAX_FLOWERS && (numFields + 1) * cells <= POOL_CELLS)
+                {
+                    flowerCell[numFields - 1] = i;
+                    bfs(grid, i % width, i / width, pool + numFields * cells, queue);
+                    numFields++;
+                }
+            }
+
+            if (pool[start] == UNREACHABLE)
+            {
+                *reason = "the end can't be reached";
+                return false;
+            }
+            int reachable = 0;
+            for (int f = 0; f < numFlowers(); f++)
+            {
+                if (field(f + 1)[start] != UNREACHABLE)
+                    reachable++;
+            }
+            if (numFlowerTiles == numFlowers() && reachable < toBloom)
+            {
+                *reason = "not enough reachable flowers";
+                return false;
+            }
+
+            par = solveParSteps();
+            *reason = "ok";
+            return true;
+        }
+
+        // Flowers with a distance field
+        int numFlowers() const { return numFields - 1; }
+        int flowerX(int f) const { return flowerCell[f] % width; }
+        int flowerY(int f) const { return flowerCell[f] / width; }
+
+        uint16_t distanceToEnd(int x, int y) const { return field(0)[y * width + x]; }
+        uint16_t distanceToFlower(int f, int x, int y) const { return field(f + 1)[y * width + x]; }
+
+        //////////////////////////////////////////////////////////////
+        // Which way to go from (x, y): OPEN_* towards the nearest bud
+        // still on the grid while flowers are needed, otherwise
+        // towards the end. 0 if there is nowhere to go.
+        //////////////////////////////////////////////////////////////
+        uint8_t hint(const MazeGrid &grid, int x, int y, bool needFlowers) const
+        {
+            int best = 0; // the end
+            if (needFlowers)
+            {
+                uint16_t bestDistance = UNREACHABLE;
+                for (int f = 0; f < numFlowers(); f++)
+                {
+                    uint16_t d = distanceToFlower(f, x, y);
+                    if (d < bestDistance && grid.floor(flowerX(f), flowerY(f)) == FLOWER)
+                    {
+                        bestDistance = d;
+                        best = f + 1;
+                    }
+                }
+            }
+            return stepToward(grid, field(best), x, y);
+        }
+
+        // Fewest moves to bloom enough flowers and reach the end, or
+        // UNREACHABLE if not every flower got a field
+        uint16_t parSteps() const { return par; }
+
+    private:
+        uint16_t pool[POOL_CELLS];
+        uint16_t queue[MAX_CELLS];
+        uint16_t dp[1 << MAX_FLOWERS][MAX_FLOWERS];
+        uint16_t flowerCell[MAX_FLOWERS];
+        int width;
+        int cells;
+        int numFields;
+        int numFlowerTiles;
+        int start;
+        int toBloom;
+        uint16_t par;
+
+        const uint16_t *field(int index) const { return pool + index * cells; }
+
+        static uint16_t addSteps(uint16_t a, uint16_t b)
+        {
+            if (a == UNREACHABLE || b == UNREACHABLE)
+                return UNREACHABLE;
+            return a + b;
+        }
+
+        // The open neighbour one step closer in a field
+        uint8_t stepToward(const MazeGrid &grid, const uint16_t *dist, int x, int y) const
+        {
+            static const uint8_t dirs[4] = {OPEN_LEFT, OPEN_RIGHT, OPEN_ABOVE, OPEN_BELOW};
+            uint16_t here = dist[y * width + x];
+            if (here == 0 || here == UNREACHABLE)
+                return 0;
+            for (int d = 0; d < 4; d++)
+            {
+                if (grid.canMove(x, y, dirs[d]) &&
+                    dist[(y + MazeGrid::dy(dirs[d])) * width + x + MazeGrid::dx(dirs[d])] == here - 1)
+                    return dirs[d];
+            }
+            return 0;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // dp[mask][last]: shortest walk from the start through the
+        // flowers in mask, ending at flower last. The answer is the
+        // best dp + distance to the end over masks with enough flowers.
+        //////////////////////////////////////////////////////////////
+        uint16_t solveParSteps()
+        {
+            if (numFlowerTiles != numFlowers())
+                return UNREACHABLE;
+            int k = numFlowers();
+            if (toBloom <= 0 || k == 0)
+                return pool[start];
+
+            uint16_t best = UNREACHABLE;
+            for (int mask = 1; mask < (1 << k); mask++)
+            {
+                int bloomed = 0;
+                for (int f = 0; f < k; f++)
+                    bloomed += (mask >> f) & 1;
+
+                for (int last = 0; last < k; last++)
+                {
+                    dp[mask][last] = UNREACHABLE;
+                    if (!((mask >> last) & 1))
+                        continue;
+
+                    int before = mask & ~(1 << last);
+                    if (before == 0)
+                    {
+                        dp[mask][last] = field(last + 1)[start];
+                    }
+                    else
+                    {
+                        for (int prev = 0; prev < k; prev++)
+                        {
+                            if (!((before >> prev) & 1))
+                                continue;
+                            uint16_t d = addSteps(dp[before][prev], field(last + 1)[flowerCell[prev]]);
+                            if (d < dp[mask][last])
+                                dp[mask][last] = d;
+                        }
+                    }
+
+                    if (bloomed >= toBloom)
+                    {
+                        uint16_t total = addSteps(dp[mask][last], field(0)[flowerCell[last]]);
+                        if (total < best)
+                            best = total;
+                    }
+                }
+            }
+            return best;
+        }
+};
+
+#endif
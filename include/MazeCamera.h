@@ -0,0 +1,78 @@
+#ifndef MAZE_CAMERA_H
+#define MAZE_CAMERA_H
+
+// Includes
+#include <M5Core2.h>
+
+// Set to 0 to redraw the whole view on every scroll instead of using
+// the LCD's hardware vertical scrolling
+#ifndef MAZE_CAMERA_HW_SCROLL
+#define MAZE_CAMERA_HW_SCROLL 1
+#endif
+
+////////////////////////////////////////////////////////////////////
+// Viewport onto a maze that can be bigger than the screen. The view
+// is 8x6 tiles of 40px and only visible tiles are drawn. The camera
+// follows the hat one tile at a time, keeping a tile of margin
+// around it when the maze allows.
+//
+// Vertical moves use the ILI9342C vertical scroll registers: the
+// panel's scroll start line moves by one tile, and only the row of
+// tiles that came into view is drawn (into the frame memory the old
+// row used). Horizontal moves redraw the view, since the panel only
+// scrolls vertically. Because of this, screen y and frame memory y
+// differ while scrolled; always place things with screenX()/screenY().
+////////////////////////////////////////////////////////////////////
+class MazeCamera
+{
+    public:
+        // Draws maze cell (col, row) with its top-left corner at (x, y)
+        typedef void (*TileDrawer)(int col, int row, int x, int y);
+
+        static const int TILE_SIZE = 40;
+        static const int VIEW_COLS = 8;
+        static const int VIEW_ROWS = 6;
+        static const int MARGIN = 1;
+
+        MazeCamera(TileDrawer drawer, uint16_t outsideColor);
+
+        // Start on a new maze centred (as far as possible) on the
+        // given cell and draw the whole view
+        void begin(int mazeWidth, int mazeHeight, int focusCol, int focusRow);
+
+        // Scroll so (col, row) stays in view. Returns true if the view
+        // moved (the caller should redraw anything on top, e.g. the hat)
+        bool follow(int col, int row);
+
+        // Put the panel back to normal (call when leaving the maze)
+        void end();
+
+        // Redraw one cell if it is in view
+        void drawCell(int col, int row);
+        void redrawAll();
+
+        bool isVisible(int col, int row) const
+        {
+            return col >= left && col < left + VIEW_COLS && row >= top && row < top + VIEW_ROWS;
+        }
+
+        // Where cell (col, row) is drawn (frame memory coordinates)
+        int screenX(int col) const { return (col - left) * TILE_SIZE; }
+        int screenY(int row) const { return ((row - top) * TILE_SIZE + scrollOffset) % (VIEW_ROWS * TILE_SIZE); }
+
+    private:
+        TileDrawer drawer;
+        uint16_t outsideColor;
+        int mazeWidth;
+        int mazeHeight;
+        int left;
+        int top;
+        int scrollOffset; // panel line shown at the top of the screen
+
+        int clampLeft(int value) const;
+        int clampTop(int value) const;
+        void drawRow(int row);
+        void setScroll(int offset);
+};
+
+#endif
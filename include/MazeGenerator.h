@@ -0,0 +1,297 @@
+#ifndef MAZE_GENERATOR_H
+#define MAZE_GENERATOR_H
+
+// Includes
+#include "Maze.h"
+#include "MazeGrid.h"
+#include "MazeAnalysis.h"
+
+////////////////////////////////////////////////////////////////////
+// Random maze levels. The walls come from a recursive backtracker
+// that uses an explicit stack instead of recursion. Each cell is
+// pushed once, so memory is bounded by the largest grid. The same
+// seed always gives the same level (xorshift32, no global RNG).
+//
+// After carving, BFS distances from the start and end control where
+// things go: the end is the cell farthest from the start, ice blocks
+// sit on the shortest path so they can't be skipped, and flowers are
+// kept at least minDistance steps from both the start and the end.
+//
+// No Arduino dependencies, so tools/maze_gen_bench.cpp can build it
+// on a PC. The object holds ~18 KB of work buffers; keep one around
+// (global/static) instead of putting it on the stack.
+////////////////////////////////////////////////////////////////////
+struct MazeGenParams
+{
+    uint8_t width;
+    uint8_t height;
+    uint8_t flowers;      // flower buds to place (and bloom)
+    uint8_t ice;          // ice blocks to place on the solution path
+    uint16_t minDistance; // min BFS steps from start/end to a flower
+};
+
+class MazeGenerator
+{
+    public:
+        static const int MAX_CELLS = MazeGrid::MAX_WIDTH * MazeGrid::MAX_HEIGHT;
+        static const uint16_t UNREACHABLE = MazeAnalysis::UNREACHABLE;
+
+        explicit MazeGenerator(uint32_t seed = 1) { setSeed(seed); }
+
+        // xorshift32 can't start from 0
+        void setSeed(uint32_t seed) { state = seed != 0 ? seed : 0x9E3779B9; }
+
+        uint32_t nextRandom()
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+
+        // Random number in [0, n)
+        int randomBelow(int n) { return (int)(nextRandom() % (uint32_t)n); }
+
+        //////////////////////////////////////////////////////////////
+        // Carve a new maze into grid and fill in the header (start,
+        // end, flowers to bloom). Returns false for a bad size.
+        //////////////////////////////////////////////////////////////
+        bool generate(const MazeGenParams &params, MazeGrid &grid, MazeHeader *header)
+        {
+            if (!grid.reset(params.width, params.height) || params.width * params.height < 2)
+                return false;
+
+            int w = params.width;
+            int h = params.height;
+
+            // start in the middle of the top row, like the built-in levels
+            int startX = (w - 1) / 2;
+            int startY = 0;
+            carve(grid, startX, startY);
+
+            // the end is the cell farthest from the start
+            distances(grid, startX, startY, distStart);
+            int end = startY * w + startX;
+            for (int i = 0; i < w * h; i++)
+            {
+                if (distStart[i] != UNREACHABLE && distStart[i] > distStart[end])
+                    end = i;
+            }
+            int endX = end % w;
+            int endY = end / w;
+            distances(grid, endX, endY, distEnd);
+
+            placeIce(grid, params, endX, endY);
+            int flowerCount = placeFlowers(grid, params, startX, startY, endX, endY);
+
+            header->width = w;
+            header->height = h;
+            header->startX = startX;
+            header->startY = startY;
+            header->endX = endX;
+            header->endY = endY;
+            header->flowersToBloom = flowerCount;
+            return true;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // BFS from (x, y) over open walls. dist gets the number of
+        // steps to each cell (row major, width() per row) or
+        // UNREACHABLE. Returns the number of cells reached.
+        //////////////////////////////////////////////////////////////
+        int distances(const MazeGrid &grid, int x, int y, uint16_t *dist)
+        {
+            return MazeAnalysis::bfs(grid, x, y, dist, queue);
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Check that a maze is playable: walls agree from both sides,
+        // nothing opens off the grid, the end can be reached and there
+        // are enough reachable flowers. On failure, *reason says why.
+        //////////////////////////////////////////////////////////////
+        bool validate(const MazeGrid &grid, const MazeHeader &header, const char **reason = nullptr)
+        {
+            static const uint8_t dirs[4] = {OPEN_LEFT, OPEN_RIGHT, OPEN_ABOVE, OPEN_BELOW};
+            const char *unused;
+            if (reason == nullptr)
+                reason = &unused;
+
+            int w = grid.width();
+            int h = grid.height();
+            if (header.width != w || header.height != h)
+                return fail(reason, "header size does not match the grid");
+            if (!grid.contains(header.startX, header.startY) || !grid.contains(header.endX, header.endY))
+                return fail(reason, "start or end is outside the maze");
+            if (header.startX == header.endX && header.startY == header.endY)
+                return fail(reason, "start and end are the same cell");
+
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    for (int d = 0; d < 4; d++)
+                    {
+                        bool open = (grid.openings(x, y) & dirs[d]) != 0;
+                        int nx = x + MazeGrid::dx(dirs[d]);
+                        int ny = y + MazeGrid::dy(dirs[d]);
+                        if (!grid.contains(nx, ny))
+                        {
+                            if (open)
+                                return fail(reason, "a wall opens off the edge");
+                        }
+                        else if (open != ((grid.openings(nx, ny) & MazeGrid::opposite(dirs[d])) != 0))
+                        {
+                            return fail(reason, "a wall is only open from one side");
+                        }
+                    }
+                }
+            }
+
+            distances(grid, header.startX, header.startY, distStart);
+            if (distStart[header.endY * w + header.endX] == UNREACHABLE)
+                return fail(reason, "the end can't be reached");
+
+            int flowers = 0;
+            for (int i = 0; i < w * h; i++)
+            {
+                if (distStart[i] != UNREACHABLE && grid.floor(i % w, i / w) == FLOWER)
+                    flowers++;
+            }
+            if (flowers < header.flowersToBloom)
+                return fail(reason, "not enough reachable flowers");
+
+            *reason = "ok";
+            return true;
+        }
+
+    private:
+        uint32_t state;
+        uint16_t queue[MAX_CELLS]; // carving stack, BFS queue, candidate list
+        uint16_t distStart[MAX_CELLS];
+        uint16_t distEnd[MAX_CELLS];
+        uint64_t visited[MazeGrid::MAX_HEIGHT];
+
+        static bool fail(const char **reason, const char *why)
+        {
+            *reason = why;
+            return false;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Recursive backtracker with an explicit stack: walk to a
+        // random unvisited neighbour, back up when there is none
+        //////////////////////////////////////////////////////////////
+        void carve(MazeGrid &grid, int x, int y)
+        {
+            static const uint8_t dirs[4] = {OPEN_LEFT, OPEN_RIGHT, OPEN_ABOVE, OPEN_BELOW};
+            int w = grid.width();
+            for (int row = 0; row < grid.height(); row++)
+                visited[row] = 0;
+
+            int top = 0;
+            visited[y] |= (uint64_t)1 << x;
+            queue[top++] = y * w + x;
+            while (top > 0)
+            {
+                int cell = queue[top - 1];
+                int cx = cell % w;
+                int cy = cell / w;
+
+                uint8_t choices[4];
+                int numChoices = 0;
+                for (int d = 0; d < 4; d++)
+                {
+                    int nx = cx + MazeGrid::dx(dirs[d]);
+                    int ny = cy + MazeGrid::dy(dirs[d]);
+                    if (grid.contains(nx, ny) && !((visited[ny] >> nx) & 1))
+                        choices[numChoices++] = dirs[d];
+                }
+
+                if (numChoices == 0)
+                {
+                    top--; // dead end, back up
+                    continue;
+                }
+
+                uint8_t dir = choices[randomBelow(numChoices)];
+                int nx = cx + MazeGrid::dx(dir);
+                int ny = cy + MazeGrid::dy(dir);
+                grid.openWall(cx, cy, dir);
+                visited[ny] |= (uint64_t)1 << nx;
+                queue[top++] = ny * w + nx;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Ice goes on the shortest start->end path, spread evenly
+        // along it (never on the start or end tile)
+        //////////////////////////////////////////////////////////////
+        int placeIce(MazeGrid &grid, const MazeGenParams &params, int endX, int endY)
+        {
+            int w = grid.width();
+            int pathLength = distStart[endY * w + endX];
+            int placed = 0;
+            for (int i = 0; i < w * grid.height() && placed < params.ice; i++)
+            {
+                if (distStart[i] == UNREACHABLE || distStart[i] + distEnd[i] != pathLength)
+                    continue;
+
+                // slot k of ice sits at (k + 1) / (ice + 1) of the path
+                int step = distStart[i];
+                for (int k = 0; k < params.ice; k++)
+                {
+                    if (step == (k + 1) * pathLength / (params.ice + 1) && step > 0 && step < pathLength)
+                    {
+                        grid.setFloor(i % w, i / w, ICE);
+                        placed++;
+                        break;
+                    }
+                }
+            }
+            return placed;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Flowers go on random walkable cells far enough from both the
+        // start and the end (the distance is relaxed if the maze is
+        // too small to fit them all)
+        //////////////////////////////////////////////////////////////
+        int placeFlowers(MazeGrid &grid, const MazeGenParams &params, int startX, int startY, int endX, int endY)
+        {
+            int w = grid.width();
+            int cells = w * grid.height();
+            int minDistance = params.minDistance;
+            int numCandidates = 0;
+
+            while (true)
+            {
+                numCandidates = 0;
+                for (int i = 0; i < cells; i++)
+                {
+                    bool isStartOrEnd = (i == startY * w + startX) || (i == endY * w + endX);
+                    if (!isStartOrEnd && grid.floor(i % w, i / w) == WALKABLE &&
+                        distStart[i] != UNREACHABLE && distStart[i] >= minDistance && distEnd[i] >= minDistance)
+                    {
+                        queue[numCandidates++] = i;
+                    }
+                }
+                if (numCandidates >= params.flowers || minDistance == 0)
+                    break;
+                minDistance /= 2;
+            }
+
+            // partial Fisher-Yates shuffle of the candidates
+            int placed = 0;
+            for (; placed < params.flowers && placed < numCandidates; placed++)
+            {
+                int pick = placed + randomBelow(numCandidates - placed);
+                uint16_t cell = queue[pick];
+                queue[pick] = queue[placed];
+                queue[placed] = cell;
+                grid.setFloor(cell % w, cell / w, FLOWER);
+            }
+            return placed;
+        }
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef MAZE_GRID_H
+#define MAZE_GRID_H
+
+// Includes
+#include <string.h>
+#include "Maze.h"
+
+////////////////////////////////////////////////////////////////////
+// The maze, one byte per cell in the same layout as the binary maze
+// format (OPEN_* bits in the low nibble, FloorType above it), so a
+// level loads with one memcpy per row. Up to 64x48 cells fit in ~3 KB.
+//
+// Next to the cells, a bitboard keeps one 64-bit row mask per
+// direction: bit x of openRow(OPEN_LEFT, y) is set when (x, y) is
+// open to the left. Checking a move is a single mask test, and a
+// whole row of neighbours can be queried at once.
+////////////////////////////////////////////////////////////////////
+class MazeGrid
+{
+    public:
+        static const int MAX_WIDTH = 64;
+        static const int MAX_HEIGHT = 48;
+
+        MazeGrid() : w(0), h(0)
+        {
+            memset(cells, 0, sizeof(cells));
+            memset(open, 0, sizeof(open));
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Start a width x height maze with every wall up and plain
+        // floor everywhere
+        //////////////////////////////////////////////////////////////
+        bool reset(int width, int height)
+        {
+            if (width < 1 || height < 1 || width > MAX_WIDTH || height > MAX_HEIGHT)
+                return false;
+
+            w = width;
+            h = height;
+            memset(cells, mazeCell(0, WALKABLE), sizeof(cells));
+            memset(open, 0, sizeof(open));
+            return true;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Load a maze image (binary maze format). Sides that open off
+        // the edge of the grid are closed.
+        //////////////////////////////////////////////////////////////
+        bool load(const uint8_t *data, size_t length, MazeHeader *header)
+        {
+            if (!parseMazeHeader(data, length, header) || !reset(header->width, header->height))
+                return false;
+
+            const uint8_t *row = data + MAZE_HEADER_SIZE;
+            for (int y = 0; y < h; y++, row += w)
+            {
+                memcpy(cells[y], row, w);
+            }
+            rebuildBitboard();
+            return true;
+        }
+
+        constexpr int width() const { return w; }
+        constexpr int height() const { return h; }
+        constexpr bool contains(int x, int y) const { return x >= 0 && y >= 0 && x < w && y < h; }
+
+        // Cell accessors
+        constexpr uint8_t cell(int x, int y) const { return cells[y][x]; }
+        constexpr uint8_t openings(int x, int y) const { return mazeCellOpenings(cells[y][x]); }
+        constexpr FloorType floor(int x, int y) const { return mazeCellFloor(cells[y][x]); }
+
+        // Single mask test: can we leave (x, y) in direction dir (an
+        // OPEN_* bit)?
+        constexpr bool canMove(int x, int y, uint8_t dir) const
+        {
+            return (open[dirIndex(dir)][y] >> x) & 1;
+        }
+
+        // Cells in row y that are open towards dir, as bits 0..width-1
+        constexpr uint64_t openRow(uint8_t dir, int y) const { return open[dirIndex(dir)][y]; }
+
+        void setFloor(int x, int y, FloorType floor)
+        {
+            cells[y][x] = mazeCell(mazeCellOpenings(cells[y][x]), floor);
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Knock down the wall between (x, y) and its neighbour in
+        // direction dir, on both sides
+        //////////////////////////////////////////////////////////////
+        void openWall(int x, int y, uint8_t dir)
+        {
+            int nx = x + dx(dir);
+            int ny = y + dy(dir);
+            if (!contains(x, y) || !contains(nx, ny))
+                return;
+
+            setOpening(x, y, dir);
+            setOpening(nx, ny, opposite(dir));
+        }
+
+        // Direction helpers
+        static constexpr int dirIndex(uint8_t dir)
+        {
+            return dir == OPEN_LEFT ? 0 : dir == OPEN_RIGHT ? 1 : dir == OPEN_ABOVE ? 2 : 3;
+        }
+        static constexpr int dx(uint8_t dir) { return dir == OPEN_LEFT ? -1 : dir == OPEN_RIGHT ? 1 : 0; }
+        static constexpr int dy(uint8_t dir) { return dir == OPEN_ABOVE ? -1 : dir == OPEN_BELOW ? 1 : 0; }
+        static constexpr uint8_t opposite(uint8_t dir)
+        {
+            return dir == OPEN_LEFT ? OPEN_RIGHT : dir == OPEN_RIGHT ? OPEN_LEFT : dir == OPEN_ABOVE ? OPEN_BELOW : OPEN_ABOVE;
+        }
+
+    private:
+        int w;
+        int h;
+        uint8_t cells[MAX_HEIGHT][MAX_WIDTH];
+        uint64_t open[4][MAX_HEIGHT]; // bitboard, indexed by dirIndex()
+
+        void setOpening(int x, int y, uint8_t dir)
+        {
+            cells[y][x] |= dir;
+            open[dirIndex(dir)][y] |= (uint64_t)1 << x;
+        }
+
+        void rebuildBitboard()
+        {
+            const uint8_t dirs[4] = {OPEN_LEFT, OPEN_RIGHT, OPEN_ABOVE, OPEN_BELOW};
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    // nothing opens off the edge of the grid
+                    uint8_t sides = mazeCellOpenings(cells[y][x]);
+                    if (x == 0)
+                        sides &= ~OPEN_LEFT;
+                    if (x == w - 1)
+                        sides &= ~OPEN_RIGHT;
+                    if (y == 0)
+                        sides &= ~OPEN_ABOVE;
+                    if (y == h - 1)
+                        sides &= ~OPEN_BELOW;
+                    if (mazeCellFloor(cells[y][x]) >= NUM_FLOOR_TYPES)
+                        cells[y][x] = mazeCell(sides, WALKABLE);
+                    else
+                        cells[y][x] = mazeCell(sides, mazeCellFloor(cells[y][x]));
+
+                    for (int d = 0; d < 4; d++)
+                    {
+                        if (sides & dirs[d])
+                            open[d][y] |= (uint64_t)1 << x;
+                    }
+                }
+            }
+        }
+};
+
+#endif
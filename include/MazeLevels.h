@@ -0,0 +1,60 @@
+#ifndef MAZE_LEVELS_H
+#define MAZE_LEVELS_H
+
+// Generated by tools/make_maze_levels.py - do not edit by hand.
+// Binary maze format, see include/Maze.h.
+
+#include <stdint.h>
+
+constexpr uint8_t MAZE_LEVEL_EASY[58] = {
+    0x4D, 0x5A, 0x01, 0x08, 0x06, 0x03, 0x00, 0x04, 0x05, 0x05, // header
+    0x02, 0x2B, 0x29, 0x28, 0x1A, 0x23, 0x29, 0x08,
+    0x2A, 0x25, 0x2C, 0x2C, 0x26, 0x29, 0x2C, 0x2C,
+    0x26, 0x29, 0x2C, 0x26, 0x23, 0x25, 0x2E, 0x25,
+    0x28, 0x1C, 0x26, 0x23, 0x23, 0x2B, 0x27, 0x21,
+    0x0C, 0x2E, 0x29, 0x02, 0x29, 0x2C, 0x2A, 0x29,
+    0x26, 0x25, 0x26, 0x23, 0x25, 0x16, 0x25, 0x04,
+};
+
+constexpr uint8_t MAZE_LEVEL_MEDIUM[58] = {
+    0x4D, 0x5A, 0x01, 0x08, 0x06, 0x03, 0x00, 0x04, 0x05, 0x06, // header
+    0x2A, 0x2B, 0x01, 0x28, 0x02, 0x23, 0x2B, 0x29,
+    0x2C, 0x1C, 0x2A, 0x25, 0x2A, 0x29, 0x04, 0x2C,
+    0x2C, 0x2C, 0x16, 0x23, 0x25, 0x26, 0x23, 0x2D,
+    0x2C, 0x04, 0x2A, 0x23, 0x23, 0x2B, 0x29, 0x2C,
+    0x1C, 0x2A, 0x05, 0x2A, 0x29, 0x2C, 0x04, 0x1C,
+    0x26, 0x27, 0x23, 0x25, 0x24, 0x26, 0x23, 0x25,
+};
+
+constexpr uint8_t MAZE_LEVEL_HARD[58] = {
+    0x4D, 0x5A, 0x01, 0x08, 0x06, 0x03, 0x00, 0x04, 0x05, 0x06, // header
+    0x2A, 0x19, 0x02, 0x29, 0x2A, 0x23, 0x23, 0x29,
+    0x2C, 0x2C, 0x2A, 0x25, 0x26, 0x19, 0x02, 0x25,
+    0x2C, 0x26, 0x25, 0x2A, 0x23, 0x2D, 0x2A, 0x29,
+    0x2C, 0x02, 0x23, 0x15, 0x2A, 0x25, 0x2C, 0x2C,
+    0x1E, 0x29, 0x2A, 0x29, 0x26, 0x23, 0x05, 0x2C,
+    0x04, 0x26, 0x25, 0x26, 0x23, 0x13, 0x23, 0x05,
+};
+
+constexpr uint8_t MAZE_LEVEL_EXTREME[58] = {
+    0x4D, 0x5A, 0x01, 0x08, 0x06, 0x03, 0x00, 0x04, 0x05, 0x07, // header
+    0x08, 0x2A, 0x2B, 0x21, 0x2A, 0x19, 0x2A, 0x29,
+    0x26, 0x15, 0x26, 0x29, 0x2C, 0x26, 0x1D, 0x04,
+    0x2A, 0x19, 0x08, 0x2C, 0x26, 0x01, 0x26, 0x29,
+    0x2C, 0x2C, 0x2C, 0x16, 0x23, 0x29, 0x2A, 0x25,
+    0x2C, 0x26, 0x25, 0x08, 0x2A, 0x25, 0x26, 0x29,
+    0x06, 0x23, 0x23, 0x17, 0x27, 0x23, 0x23, 0x05,
+};
+
+constexpr int NUM_MAZE_LEVELS = 4;
+constexpr const uint8_t *MAZE_LEVEL_DATA[NUM_MAZE_LEVELS] = {
+    MAZE_LEVEL_EASY, MAZE_LEVEL_MEDIUM, MAZE_LEVEL_HARD, MAZE_LEVEL_EXTREME,
+};
+constexpr int MAZE_LEVEL_SIZE[NUM_MAZE_LEVELS] = {
+    sizeof(MAZE_LEVEL_EASY), sizeof(MAZE_LEVEL_MEDIUM), sizeof(MAZE_LEVEL_HARD), sizeof(MAZE_LEVEL_EXTREME),
+};
+constexpr const char *MAZE_LEVEL_NAME[NUM_MAZE_LEVELS] = {
+    "easy", "medium", "hard", "extreme",
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef MOLE_BOARD_H
+#define MOLE_BOARD_H
+
+// Includes
+#include <M5Core2.h>
+
+////////////////////////////////////////////////////////////////////
+// Renderer for the Whack-A-Mole game board. The hole, the mole in
+// its hole and the six die faces are rasterized once into sprites;
+// after that the board is kept up to date by blitting only the holes
+// whose state changed (plus the turns counter) instead of repainting
+// the whole screen.
+//
+// Layout (320x240):   [hole 0] [hole 1] [hole 2] |  dice /
+//                     [hole 3] [hole 4] [hole 5] |  side text
+//                     Turns Left: N
+////////////////////////////////////////////////////////////////////
+class MoleBoard
+{
+    public:
+        static const int NUM_HOLES = 6;
+        static const int DIE_SIZE = 70;
+        static const uint16_t BOARD_COLOR = TFT_DARKGREEN;
+
+        MoleBoard();
+
+        // Rasterize the sprites; call once after M5.begin(). If there is
+        // not enough memory the board falls back to drawing primitives.
+        void begin();
+
+        // Repaint everything (screen changes)
+        void drawFull(const char *title, const bool moles[], int turnsRemaining);
+
+        // Blit only the holes that changed and the turns counter if it
+        // changed. Returns the number of holes that were redrawn.
+        int update(const bool moles[], int turnsRemaining);
+
+        // Clear the column right of the holes (dice, waiting/roll text)
+        void clearSidebar();
+
+        // Blit die face 1-6 with its top-left corner at (x, y)
+        void drawDie(int face, int x, int y);
+
+        // Mole drawn directly (for screens that aren't the board)
+        static void drawMole(TFT_eSPI &target, int xCenter, int yCenter);
+
+        int sidebarX() const { return sWidth * 3 / 4; }
+
+    private:
+        int sWidth;
+        int sHeight;
+
+        TFT_eSprite holeSprite;
+        TFT_eSprite moleSprite;
+        TFT_eSprite *dieSprites[6];
+        bool spritesReady;
+
+        // What is currently on the LCD
+        bool shownMoles[NUM_HOLES];
+        int shownTurns;
+
+        void holeCenter(int hole, int *x, int *y) const;
+        void drawHole(int hole, bool moleUp);
+        void drawTurns(int turnsRemaining);
+
+        static void renderHole(TFT_eSPI &target, int xCenter, int yCenter);
+        static void renderDie(TFT_eSPI &target, int face, int x, int y);
+};
+
+#endif
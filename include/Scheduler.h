@@ -0,0 +1,371 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Includes
+#include "Hal.h"
+
+////////////////////////////////////////////////////////////////////
+// Cooperative scheduler for the apps' loop(). Instead of checking
+// (millis() - lastTime) > timerDelay over and over, setup() registers
+// tasks and event handlers and loop() just calls run():
+//
+//   scheduler.every(5000, fetchWeather);    // periodic task
+//   scheduler.after(1500, clearHint);       // one-shot task
+//   scheduler.onEvent(EVENT_TOUCH, pollInput);
+//   scheduler.attachPinEvent(39, FALLING, EVENT_TOUCH, true);
+//
+// Timers sit in a hashed timer wheel (one slot per ms, mod WHEEL_SLOTS)
+// so run() only looks at the slots that came due since the last call.
+// Events are bits that ISRs (GPIO, hardware timers, BLE callbacks) set
+// with post(); their handlers run on the loop thread, since most of
+// the M5 and I2C APIs can't be called from an ISR.
+//
+// Timing, interrupts and sleep go through Hal.h, so the scheduler also
+// runs natively (-DHAL_LINUX), where ISRs are other threads.
+//
+// When nothing is due, run() blocks until the next deadline instead of
+// spinning: the loop task sleeps (a posted event wakes it early) and
+// the idle task lets the CPU halt. Apps without a radio link to keep
+// up can also allow esp_light_sleep_start() for longer waits; the
+// pins from attachPinEvent(..., wake = true) wake it up.
+////////////////////////////////////////////////////////////////////
+class Scheduler
+{
+    public:
+        typedef void (*TaskFn)();
+
+        static const int MAX_TASKS = 16;
+        static const int MAX_EVENTS = 32;
+        static const int MAX_WAKE_PINS = 4;
+        static const int WHEEL_SLOTS = 64; // power of two
+        static const int NO_TASK = -1;
+
+        Scheduler() : numWakePins(0), pending(0), lastTick(0),
+                      lightSleep(false), minLightSleepMs(0), maxIdleMs(1000)
+        {
+            for (int i = 0; i < MAX_TASKS; i++)
+                tasks[i].fn = nullptr;
+            for (int i = 0; i < WHEEL_SLOTS; i++)
+                wheel[i] = NO_TASK;
+            for (int i = 0; i < MAX_EVENTS; i++)
+                handlers[i] = nullptr;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Tasks. Both return an id for cancel()/setPeriod(), or
+        // NO_TASK if the table is full. A periodic task's first run is
+        // one period from now.
+        //////////////////////////////////////////////////////////////
+        int every(uint32_t periodMs, TaskFn fn) { return add(fn, periodMs, periodMs); }
+        int after(uint32_t delayMs, TaskFn fn) { return add(fn, delayMs, 0); }
+
+        void cancel(int id)
+        {
+            if (!valid(id))
+                return;
+            unlink(id);
+            tasks[id].fn = nullptr;
+        }
+
+        // New period for a periodic task, counted from now
+        void setPeriod(int id, uint32_t periodMs)
+        {
+            if (!valid(id))
+                return;
+            tasks[id].period = periodMs;
+            postpone(id, periodMs);
+        }
+
+        // Move the next run to delayMs from now (e.g. after a manual
+        // refresh, so the periodic one doesn't follow right after it)
+        void postpone(int id, uint32_t delayMs)
+        {
+            if (!valid(id))
+                return;
+            unlink(id);
+            tasks[id].deadline = halMillis() + delayMs;
+            link(id);
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Events: handler for event bit 0-31, and post() to raise it
+        // from anywhere, including an ISR
+        //////////////////////////////////////////////////////////////
+        void onEvent(int event, TaskFn fn)
+        {
+            if (event >= 0 && event < MAX_EVENTS)
+                handlers[event] = fn;
+        }
+
+        void IRAM_ATTR post(int event)
+        {
+            __atomic_fetch_or(&pending, 1UL << event, __ATOMIC_SEQ_CST);
+            wake.notify();
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Raise an event from a GPIO interrupt (mode as for
+        // attachInterrupt). With wake, the pin also wakes the chip from
+        // light sleep while it is at its active level.
+        //////////////////////////////////////////////////////////////
+        void attachPinEvent(int pin, int mode, int event, bool activeLow, bool wake = true)
+        {
+            pinEvents()[pin & 63] = event;
+            owner() = this;
+            halAttachInterrupt(pin, mode, onPinInterrupt, (void *)(intptr_t)pin);
+            if (wake && numWakePins < MAX_WAKE_PINS)
+            {
+                wakePins[numWakePins] = pin;
+                wakeLowLevel[numWakePins] = activeLow;
+                numWakePins++;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Allow light sleep for waits of at least minSleepMs. Keep it
+        // off while WiFi/BLE links or a hardware timer must keep going.
+        //////////////////////////////////////////////////////////////
+        void setLightSleep(bool enabled, uint32_t minSleepMs = 5)
+        {
+            lightSleep = enabled;
+            minLightSleepMs = minSleepMs;
+        }
+
+        // Longest single wait, so run() still returns now and then
+        void setMaxIdle(uint32_t ms) { maxIdleMs = ms; }
+
+        //////////////////////////////////////////////////////////////
+        // Call from loop(): handle events, run the tasks that are due,
+        // then wait for the next deadline or event
+        //////////////////////////////////////////////////////////////
+        void run()
+        {
+            if (!wake.bound())
+            {
+                // start from the earliest task added before this, so
+                // the wheel doesn't skip its slot
+                wake.bind();
+                lastTick = earliestDeadline(halMillis());
+            }
+
+            dispatchEvents();
+            runDueTasks(halMillis());
+            dispatchEvents();
+            idle();
+        }
+
+    private:
+        struct Task
+        {
+            TaskFn fn;
+            uint32_t period; // 0 for one-shot
+            uint32_t deadline;
+            int slot;        // wheel slot it is linked into
+            int next;        // next task in the same wheel slot
+        };
+
+        Task tasks[MAX_TASKS];
+        int wheel[WHEEL_SLOTS];
+        TaskFn handlers[MAX_EVENTS];
+        int wakePins[MAX_WAKE_PINS];
+        bool wakeLowLevel[MAX_WAKE_PINS];
+        int numWakePins;
+        volatile uint32_t pending;
+        uint32_t lastTick;
+        HalSignal wake; // the loop task sleeps on this
+        bool lightSleep;
+        uint32_t minLightSleepMs;
+        uint32_t maxIdleMs;
+
+        // GPIO -> event, shared by the pin ISR (function statics so the
+        // header can be included by more than one file)
+        static int *pinEvents()
+        {
+            static int events[64];
+            return events;
+        }
+
+        static Scheduler *&owner()
+        {
+            static Scheduler *scheduler = nullptr;
+            return scheduler;
+        }
+
+        static void IRAM_ATTR onPinInterrupt(void *arg)
+        {
+            owner()->post(pinEvents()[(intptr_t)arg & 63]);
+        }
+
+        bool valid(int id) const { return id >= 0 && id < MAX_TASKS && tasks[id].fn != nullptr; }
+
+        int add(TaskFn fn, uint32_t delayMs, uint32_t periodMs)
+        {
+            for (int id = 0; id < MAX_TASKS; id++)
+            {
+                if (tasks[id].fn == nullptr)
+                {
+                    tasks[id].fn = fn;
+                    tasks[id].period = periodMs;
+                    tasks[id].deadline = halMillis() + delayMs;
+                    link(id);
+                    return id;
+                }
+            }
+            return NO_TASK;
+        }
+
+        // A deadline the wheel has already passed (after(0) from a task
+        // or handler) goes into the next slot run() visits, not a slot
+        // that only comes round again a turn later. Before the first
+        // run() there is no wheel position yet (see run()).
+        void link(int id)
+        {
+            uint32_t at = tasks[id].deadline;
+            if (wake.bound() && (int32_t)(at - lastTick) < 0)
+                at = lastTick;
+            int slot = at & (WHEEL_SLOTS - 1);
+            tasks[id].slot = slot;
+            tasks[id].next = wheel[slot];
+            wheel[slot] = id;
+        }
+
+        void unlink(int id)
+        {
+            int *link = &wheel[tasks[id].slot];
+            while (*link != NO_TASK && *link != id)
+                link = &tasks[*link].next;
+            if (*link == id)
+                *link = tasks[id].next;
+        }
+
+        void dispatchEvents()
+        {
+            uint32_t events = __atomic_exchange_n(&pending, 0, __ATOMIC_SEQ_CST);
+            for (int event = 0; events != 0; event++, events >>= 1)
+            {
+                if ((events & 1) && handlers[event] != nullptr)
+                    handlers[event]();
+            }
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Visit each wheel slot from the last tick up to now (at most
+        // one full turn). A task in a slot may belong to a later turn
+        // of the wheel, so its deadline is checked before it runs.
+        //////////////////////////////////////////////////////////////
+        void runDueTasks(uint32_t now)
+        {
+            uint32_t ticks = now - lastTick + 1;
+            if (ticks > WHEEL_SLOTS)
+                ticks = WHEEL_SLOTS;
+            uint32_t firstTick = now - ticks + 1;
+            lastTick = now + 1;
+
+            for (uint32_t t = 0; t < ticks; t++)
+            {
+                int slot = (firstTick + t) & (WHEEL_SLOTS - 1);
+                int id = wheel[slot];
+                while (id != NO_TASK)
+                {
+                    if ((int32_t)(now - tasks[id].deadline) < 0)
+                    {
+                        id = tasks[id].next;
+                        continue;
+                    }
+
+                    TaskFn fn = tasks[id].fn;
+                    unlink(id);
+                    if (tasks[id].period > 0)
+                    {
+                        // keep the rhythm, but don't queue up missed runs
+                        tasks[id].deadline += tasks[id].period;
+                        if ((int32_t)(now - tasks[id].deadline) >= 0)
+                            tasks[id].deadline = now + tasks[id].period;
+                        link(id);
+                    }
+                    else
+                    {
+                        tasks[id].fn = nullptr;
+                    }
+                    fn();
+
+                    // fn() may have added or cancelled tasks: start the
+                    // slot over (the task that ran isn't due any more)
+                    id = wheel[slot];
+                }
+            }
+        }
+
+        uint32_t earliestDeadline(uint32_t now) const
+        {
+            uint32_t earliest = now;
+            for (int id = 0; id < MAX_TASKS; id++)
+            {
+                if (tasks[id].fn != nullptr && (int32_t)(tasks[id].deadline - earliest) < 0)
+                    earliest = tasks[id].deadline;
+            }
+            return earliest;
+        }
+
+        uint32_t msUntilNextDeadline(uint32_t now) const
+        {
+            uint32_t wait = maxIdleMs;
+            for (int id = 0; id < MAX_TASKS; id++)
+            {
+                if (tasks[id].fn == nullptr)
+                    continue;
+                // a task that was overdue when it was linked waits for
+                // the wheel to reach its slot (link())
+                uint32_t due = tasks[id].deadline;
+                if ((int32_t)(due - lastTick) < 0 && tasks[id].slot == (int)(lastTick & (WHEEL_SLOTS - 1)))
+                    due = lastTick;
+                int32_t left = (int32_t)(due - now);
+                if (left <= 0)
+                    return 0;
+                if ((uint32_t)left < wait)
+                    wait = left;
+            }
+            return wait;
+        }
+
+        bool wakePinActive() const
+        {
+            for (int i = 0; i < numWakePins; i++)
+            {
+                if (halPinIsHigh(wakePins[i]) != wakeLowLevel[i])
+                    return true;
+            }
+            return false;
+        }
+
+        void idle()
+        {
+            if (__atomic_load_n(&pending, __ATOMIC_ACQUIRE) != 0)
+                return;
+            uint32_t wait = msUntilNextDeadline(halMillis());
+            if (wait == 0)
+                return;
+
+            // a wake pin still at its level (a finger left on the touch
+            // screen) would only wake the chip again straight away
+            if (lightSleep && wait >= minLightSleepMs && !wakePinActive())
+            {
+                // the GPIO ISR doesn't run for a wake-up from light sleep
+                if (halLightSleep(wait, wakePins, wakeLowLevel, numWakePins))
+                {
+                    for (int i = 0; i < numWakePins; i++)
+                    {
+                        if (halPinIsHigh(wakePins[i]) != wakeLowLevel[i])
+                            post(pinEvents()[wakePins[i] & 63]);
+                    }
+                }
+            }
+            else
+            {
+                // sleeps the loop task; post() wakes it early
+                wake.wait(wait);
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef TELEMETRY_BUFFER_H
+#define TELEMETRY_BUFFER_H
+
+// Includes
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////
+// Fixed-size ring of sensor records waiting to be uploaded. Samples
+// are pushed as they are taken and go up together in one request
+// once there are maxRecords of them or the oldest is maxAgeMs old,
+// so the radio wakes up and a TLS handshake happens once per batch
+// instead of once per sample.
+//
+// A batch is only removed (pop) after the upload succeeded, so a
+// failed request is retried with the next batch. If the link stays
+// down the ring fills up and the oldest records are dropped.
+////////////////////////////////////////////////////////////////////
+template <typename Record, int CAPACITY>
+class TelemetryBuffer
+{
+    public:
+        TelemetryBuffer() : head(0), count(0), dropped(0) {}
+
+        // Add a record taken at nowMs; overwrites the oldest if full
+        void push(const Record &record, uint32_t nowMs)
+        {
+            int slot = (head + count) % CAPACITY;
+            records[slot] = record;
+            pushedMs[slot] = nowMs;
+            if (count < CAPACITY)
+            {
+                count++;
+            }
+            else
+            {
+                head = (head + 1) % CAPACITY;
+                dropped++;
+            }
+        }
+
+        int size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        // i-th oldest record, 0 <= i < size()
+        const Record &peek(int i) const { return records[(head + i) % CAPACITY]; }
+
+        // Remove the n oldest records (after they were uploaded)
+        void pop(int n)
+        {
+            if (n > count)
+                n = count;
+            head = (head + n) % CAPACITY;
+            count -= n;
+        }
+
+        bool shouldFlush(int maxRecords, uint32_t maxAgeMs, uint32_t nowMs) const
+        {
+            return count >= maxRecords || (count > 0 && nowMs - pushedMs[head] >= maxAgeMs);
+        }
+
+        uint32_t droppedRecords() const { return dropped; }
+
+    private:
+        Record records[CAPACITY];
+        int head;
+        int count;
+        uint32_t pushedMs[CAPACITY];
+        uint32_t dropped;
+};
+
+#endif
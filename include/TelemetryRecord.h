@@ -0,0 +1,167 @@
+#ifndef TELEMETRY_RECORD_H
+#define TELEMETRY_RECORD_H
+
+// Includes
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////
+// Binary upload format for sensor samples, sent as an
+// application/octet-stream POST body and decoded by the upload cloud
+// function (decodeTelemetry() in func1_index.js). All integers are
+// little endian.
+//
+// Batch header:
+//   'M' '5'          magic
+//   u8  version      VERSION
+//   u16 count        number of records
+//   u8  userIdLength then the userId bytes (no NUL)
+//   u32 baseTime     UTC epoch seconds of the first record
+// Record (17 bytes for samples taken within a minute of each other):
+//   varint timeDelta seconds since the previous record (or baseTime),
+//                    zigzag encoded since NTP can step the clock back
+//   u16 prox, u16 ambientLight, u16 whiteLight
+//   i16 temp         0.01 C
+//   u16 rHum         0.01 %
+//   i16 accX/Y/Z     0.01 m/s^2
+//
+// A new field means a new VERSION; the cloud function keeps decoding
+// the old ones. Values out of a field's range are clamped.
+////////////////////////////////////////////////////////////////////
+struct TelemetrySample
+{
+    uint32_t timeCaptured; // UTC epoch seconds
+    uint16_t prox;
+    uint16_t ambientLight;
+    uint16_t whiteLight;
+    float temp;            // C
+    float rHum;            // %
+    float acc[3];          // m/s^2
+};
+
+class TelemetryEncoder
+{
+    public:
+        static const uint8_t VERSION = 1;
+        static const int HEADER_SIZE = 10;     // without the userId
+        static const int MAX_RECORD_SIZE = 21; // 5 byte varint + 16
+
+        // Bytes needed for count records in the worst case
+        static size_t maxSize(int count, size_t userIdLength)
+        {
+            return HEADER_SIZE + userIdLength + (size_t)count * MAX_RECORD_SIZE;
+        }
+
+        TelemetryEncoder(uint8_t *buffer, size_t size)
+            : buffer(buffer), size(size), length(0), count(0), lastTime(0), overflow(false) {}
+
+        void begin(const char *userId)
+        {
+            size_t idLength = strlen(userId);
+            if (idLength > 255)
+                idLength = 255;
+
+            length = 0;
+            count = 0;
+            overflow = false;
+            putByte('M');
+            putByte('5');
+            putByte(VERSION);
+            putU16(0); // count, filled in by finish()
+            putByte(idLength);
+            for (size_t i = 0; i < idLength; i++)
+                putByte(userId[i]);
+            baseTimeAt = length;
+            putU32(0); // baseTime, from the first record
+        }
+
+        void add(const TelemetrySample &sample)
+        {
+            if (count == 0)
+            {
+                lastTime = sample.timeCaptured;
+                patchU32(baseTimeAt, lastTime);
+            }
+            int64_t delta = (int64_t)sample.timeCaptured - lastTime;
+            lastTime = sample.timeCaptured;
+            putVarint(delta >= 0 ? (uint64_t)delta << 1 : ((uint64_t)(-delta) << 1) - 1);
+
+            putU16(sample.prox);
+            putU16(sample.ambientLight);
+            putU16(sample.whiteLight);
+            putU16((uint16_t)fixed(sample.temp, -32768, 32767));
+            putU16((uint16_t)fixed(sample.rHum, 0, 65535));
+            for (int i = 0; i < 3; i++)
+                putU16((uint16_t)fixed(sample.acc[i], -32768, 32767));
+            count++;
+        }
+
+        // Length of the batch, or 0 if it didn't fit in the buffer
+        size_t finish()
+        {
+            if (overflow || length < 5)
+                return 0;
+            buffer[3] = count & 0xFF;
+            buffer[4] = count >> 8;
+            return length;
+        }
+
+    private:
+        uint8_t *buffer;
+        size_t size;
+        size_t length;
+        size_t baseTimeAt;
+        uint16_t count;
+        uint32_t lastTime;
+        bool overflow;
+
+        // value * 100, rounded and clamped to [lo, hi]
+        static int32_t fixed(float value, int32_t lo, int32_t hi)
+        {
+            float scaled = value * 100.0f;
+            if (!(scaled > lo)) // also catches NaN
+                return lo;
+            if (scaled > hi)
+                return hi;
+            return (int32_t)(scaled + (scaled >= 0 ? 0.5f : -0.5f));
+        }
+
+        void putByte(uint8_t value)
+        {
+            if (length < size)
+                buffer[length++] = value;
+            else
+                overflow = true;
+        }
+
+        void putU16(uint16_t value)
+        {
+            putByte(value & 0xFF);
+            putByte(value >> 8);
+        }
+
+        void putU32(uint32_t value)
+        {
+            putU16(value & 0xFFFF);
+            putU16(value >> 16);
+        }
+
+        void patchU32(size_t at, uint32_t value)
+        {
+            for (int i = 0; i < 4 && at + i < size; i++)
+                buffer[at + i] = value >> (8 * i);
+        }
+
+        void putVarint(uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                putByte((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+            putByte(value);
+        }
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TEXT_FIELD_H
+#define TEXT_FIELD_H
+
+// Includes
+#include <M5Core2.h>
+
+////////////////////////////////////////////////////////////////////
+// A single line of text drawn with the built-in (GLCD) font that
+// remembers what it last put on the screen. Calling update() with a
+// new string only repaints the character cells that changed, so a
+// temperature going from 72F to 73F costs one glyph instead of a
+// full screen redraw. Characters found in the GlyphCache are drawn
+// anti-aliased from flash; anything else uses the built-in font.
+////////////////////////////////////////////////////////////////////
+class TextField
+{
+    public:
+        // Returns the color behind the field at (x, y) when it sits on
+        // top of an image. If not supplied, the glyphs are drawn on top
+        // of bgColor.
+        typedef uint16_t (*BackgroundSampler)(int x, int y);
+
+        static const int MAX_CHARS = 32;
+
+        TextField(int x, int y, uint8_t textSize, uint16_t color, uint16_t bgColor, BackgroundSampler sampler = nullptr);
+
+        // Layout/style changes - these invalidate the field
+        void setPosition(int x, int y);
+        void setColors(uint16_t color, uint16_t bgColor);
+
+        // Forget what is on screen (call after the screen was cleared)
+        void invalidate();
+
+        // Draw the new text, repainting only the glyphs that changed.
+        // Returns the number of pixels that were sent to the LCD.
+        int update(const char *text);
+
+        // Bounding box of the text currently on screen
+        int getX() const { return x; }
+        int getY() const { return y; }
+        int width() const { return shownLen * glyphWidth(); }
+        int height() const { return glyphHeight(); }
+
+    private:
+        int x;
+        int y;
+        uint8_t textSize;
+        uint16_t color;
+        uint16_t bgColor;
+        BackgroundSampler sampler;
+
+        // What is currently on the LCD
+        char shown[MAX_CHARS + 1];
+        int shownLen;
+        bool valid;
+
+        int glyphWidth() const { return 6 * textSize; }
+        int glyphHeight() const { return 8 * textSize; }
+        void clearCell(int index);
+        void drawCell(int index, char c);
+};
+
+#endif
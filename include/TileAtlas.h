@@ -0,0 +1,58 @@
+#ifndef TILE_ATLAS_H
+#define TILE_ATLAS_H
+
+// Includes
+#include <M5Core2.h>
+#include "Maze.h"
+
+////////////////////////////////////////////////////////////////////
+// Pre-rendered maze tiles. Every combination of walls (16) and floor
+// (each FloorType plus the end tile) is drawn once into a 40x40
+// sprite, so drawing a tile - setting up the maze or covering the
+// hat's old position - is a single blit instead of up to four wall
+// rects plus the flower/ice primitives. The hat is a sprite too and
+// is pushed with a transparent color on top of its tile.
+//
+// The sprites need ~300 KB, so they go in PSRAM. If they can't be
+// allocated the atlas draws the same primitives directly.
+////////////////////////////////////////////////////////////////////
+class TileAtlas
+{
+    public:
+        static const int TILE_SIZE = 40;
+        static const int HALF_WALL = 5;
+        static const int FLOOR_SIZE = TILE_SIZE - 2 * HALF_WALL;
+        static const int HAT_RADIUS = 10;
+
+        // Floor index for the end tile (after the FloorType values)
+        static const int END_FLOOR = NUM_FLOOR_TYPES;
+        static const int NUM_FLOORS = NUM_FLOOR_TYPES + 1;
+
+        TileAtlas();
+
+        // Render every tile; call once after M5.begin()
+        void begin(uint16_t floorColor, uint16_t wallColor);
+
+        // Draw tile (walls = OPEN_* bits) with its top-left at (x, y)
+        void drawTile(int x, int y, uint8_t walls, int floor);
+
+        // Draw the hat on top of whatever is at (xCenter, yCenter)
+        void drawHat(int xCenter, int yCenter);
+
+        // Primitives, also used by the menu screens
+        static void drawFlower(TFT_eSPI &target, int xCenter, int yCenter, uint32_t petalColor, uint32_t centerColor);
+        static void drawFlowerBud(TFT_eSPI &target, int xCenter, int yCenter, uint32_t color);
+        static void drawIceBlock(TFT_eSPI &target, int xCenter, int yCenter);
+        static void drawHat(TFT_eSPI &target, int xCenter, int yCenter);
+
+    private:
+        TFT_eSprite *tiles[NUM_WALL_CONFIGS * NUM_FLOORS];
+        TFT_eSprite hatSprite;
+        bool spritesReady;
+        uint16_t floorColor;
+        uint16_t wallColor;
+
+        void renderTile(TFT_eSPI &target, int x, int y, uint8_t walls, int floor);
+};
+
+#endif
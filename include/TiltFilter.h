@@ -0,0 +1,226 @@
+#ifndef TILT_FILTER_H
+#define TILT_FILTER_H
+
+// Includes
+#include <math.h>
+#include "ImuFifo.h"
+
+////////////////////////////////////////////////////////////////////
+// Complementary filter for which way is "up", from the MPU6886 accel
+// and gyro. The gyro turns the up vector each sample (fast, no
+// noise from shaking, but it drifts); the accelerometer pulls it back
+// towards gravity over ~timeConstant seconds (slow, but it can't
+// drift). Samples where the acceleration is far from 1 g (bumps,
+// shaking) don't pull at all.
+//
+// update() is a fixed amount of float math per sample (no trig, one
+// sqrt per vector), so it can keep up with the FIFO at 1 kHz.
+//
+// tiltX()/tiltY() are the x/y components of the up vector in g, the
+// same as raw accel readings (+x: tilted left, +y: tilted down), after
+// a dead zone and a response curve that is gentle near level.
+//
+// Calibration: lay the device flat and still, feed it samples with
+// addCalibrationSample(), then finishCalibration(). The offsets are
+// raw sensor units so they can be saved as they are (see
+// TiltCalibration).
+////////////////////////////////////////////////////////////////////
+struct TiltCalibration
+{
+    uint16_t magic; // CALIBRATION_MAGIC if this holds offsets
+    int16_t accelOffset[3];
+    int16_t gyroOffset[3];
+};
+
+class TiltFilter
+{
+    public:
+        static const uint16_t CALIBRATION_MAGIC = 0x5443; // "TC"
+        static const int16_t ONE_G_RAW = 4096; // at +-8 g
+        static const int MIN_CALIBRATION_SAMPLES = 100;
+
+        TiltFilter() : deadZone(0.05f), fullTilt(0.6f), timeConstant(0.5f), lastDt(0), accelWeight(0), started(false)
+        {
+            clearCalibration();
+            beginCalibration();
+            reset();
+        }
+
+        // Start over from the next sample's accelerometer reading
+        void reset()
+        {
+            upX = 0;
+            upY = 0;
+            upZ = 1;
+            started = false;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Dead zone and full tilt in g: below deadZone reads as level,
+        // fullTilt and beyond read as fullTilt
+        //////////////////////////////////////////////////////////////
+        void setResponse(float newDeadZone, float newFullTilt)
+        {
+            deadZone = newDeadZone;
+            fullTilt = newFullTilt > newDeadZone ? newFullTilt : newDeadZone + 0.01f;
+        }
+
+        // How long (s) the accelerometer takes to correct the gyro
+        void setTimeConstant(float seconds)
+        {
+            timeConstant = seconds;
+            lastDt = 0;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // One sample, dt seconds after the previous one
+        //////////////////////////////////////////////////////////////
+        void update(const ImuSample &sample, float dt)
+        {
+            float ax = ImuFifo::toG(sample.accel[0] - cal.accelOffset[0]);
+            float ay = ImuFifo::toG(sample.accel[1] - cal.accelOffset[1]);
+            float az = ImuFifo::toG(sample.accel[2] - cal.accelOffset[2]);
+            float aLength = sqrtf(ax * ax + ay * ay + az * az);
+
+            if (!started)
+            {
+                if (aLength > 0.1f)
+                {
+                    upX = ax / aLength;
+                    upY = ay / aLength;
+                    upZ = az / aLength;
+                    started = true;
+                }
+                return;
+            }
+
+            // turn the up vector against the device's rotation:
+            // up += (up x w) dt
+            const float degToRad = 0.01745329f;
+            float wx = ImuFifo::toDps(sample.gyro[0] - cal.gyroOffset[0]) * degToRad * dt;
+            float wy = ImuFifo::toDps(sample.gyro[1] - cal.gyroOffset[1]) * degToRad * dt;
+            float wz = ImuFifo::toDps(sample.gyro[2] - cal.gyroOffset[2]) * degToRad * dt;
+            float x = upX + (upY * wz - upZ * wy);
+            float y = upY + (upZ * wx - upX * wz);
+            float z = upZ + (upX * wy - upY * wx);
+
+            // pull towards gravity, unless the device is being shaken
+            if (aLength > 0.8f && aLength < 1.2f)
+            {
+                if (dt != lastDt)
+                {
+                    lastDt = dt;
+                    accelWeight = dt / (timeConstant + dt);
+                }
+                x += (ax / aLength - x) * accelWeight;
+                y += (ay / aLength - y) * accelWeight;
+                z += (az / aLength - z) * accelWeight;
+            }
+
+            float length = sqrtf(x * x + y * y + z * z);
+            upX = x / length;
+            upY = y / length;
+            upZ = z / length;
+        }
+
+        float tiltX() const { return response(upX); }
+        float tiltY() const { return response(upY); }
+
+        //////////////////////////////////////////////////////////////
+        // Dead zone, then a curve that is half as steep near level as
+        // at full tilt, so small corrections are easier
+        //////////////////////////////////////////////////////////////
+        float response(float value) const
+        {
+            float magnitude = fabsf(value);
+            if (magnitude <= deadZone)
+                return 0;
+            float u = (magnitude - deadZone) / (fullTilt - deadZone);
+            if (u > 1)
+                u = 1;
+            float out = fullTilt * u * (0.5f + 0.5f * u);
+            return value < 0 ? -out : out;
+        }
+
+        // Calibration
+        void clearCalibration()
+        {
+            cal.magic = 0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                cal.accelOffset[axis] = 0;
+                cal.gyroOffset[axis] = 0;
+            }
+        }
+
+        // Use saved offsets; ignored if they were never filled in
+        bool setCalibration(const TiltCalibration &saved)
+        {
+            if (saved.magic != CALIBRATION_MAGIC)
+                return false;
+            cal = saved;
+            reset();
+            return true;
+        }
+
+        const TiltCalibration &calibration() const { return cal; }
+
+        void beginCalibration()
+        {
+            calibrationSamples = 0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                accelSum[axis] = 0;
+                gyroSum[axis] = 0;
+            }
+        }
+
+        void addCalibrationSample(const ImuSample &sample)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                accelSum[axis] += sample.accel[axis];
+                gyroSum[axis] += sample.gyro[axis];
+            }
+            calibrationSamples++;
+        }
+
+        //////////////////////////////////////////////////////////////
+        // Average the samples into offsets (flat: x = y = 0, z = 1 g).
+        // Returns false (keeping the old offsets) if there weren't
+        // enough samples.
+        //////////////////////////////////////////////////////////////
+        bool finishCalibration()
+        {
+            if (calibrationSamples < MIN_CALIBRATION_SAMPLES)
+                return false;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                cal.accelOffset[axis] = accelSum[axis] / calibrationSamples;
+                cal.gyroOffset[axis] = gyroSum[axis] / calibrationSamples;
+            }
+            cal.accelOffset[2] -= ONE_G_RAW;
+            cal.magic = CALIBRATION_MAGIC;
+            reset();
+            return true;
+        }
+
+    private:
+        TiltCalibration cal;
+        float deadZone;
+        float fullTilt;
+        float timeConstant;
+        float lastDt;
+        float accelWeight;
+        bool started;
+        float upX;
+        float upY;
+        float upZ;
+
+        int32_t accelSum[3];
+        int32_t gyroSum[3];
+        int32_t calibrationSamples;
+};
+
+#endif
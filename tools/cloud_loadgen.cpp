@@ -0,0 +1,423 @@
+//////////////////////////////////////////////////////////////////////
+// Load generator and latency benchmark for the Weather Program v3
+// cloud functions (upload and average). Simulates many M5 devices,
+// each uploading a batch of samples every --upload-every seconds and
+// asking for an average every --average-every seconds, with the same
+// encoders GCP.cpp uses (include/CloudProtocol.h).
+//
+// Build and run on a PC:
+//   g++ -O2 -std=gnu++11 -DHAL_LINUX -Iinclude tools/cloud_loadgen.cpp -o cloud_loadgen -pthread
+//   ./cloud_loadgen --upload=http://localhost:8081/ --average=http://localhost:8082/
+//       --devices=2000 --upload-every=30 --average-every=120 --seconds=120 --csv=run.csv
+//
+// HalHttp speaks plain HTTP, so point it at the functions framework
+// and the Firestore emulator on this machine, e.g. in
+// "Weather Program v3":
+//   gcloud emulators firestore start --host-port=localhost:8080
+//   export FIRESTORE_EMULATOR_HOST=localhost:8080
+//   npx @google-cloud/functions-framework --source=func1_index.js --target=upload --port=8081
+//   npx @google-cloud/functions-framework --source=func2_index.js --target=average --port=8082
+//
+// Options (all --name=value):
+//   --upload, --average   function URLs; leave one out to skip it
+//   --devices             virtual devices (default 100)
+//   --upload-every        seconds between a device's uploads (30)
+//   --average-every       seconds between a device's averages (60)
+//   --batch               samples per upload (30)
+//   --protocol            binary (what GCP.cpp sends), json (JSON batch
+//                         body) or header (one sample per GET in the
+//                         M5-Details header, as older clients did; use
+//                         a short --upload-every to match their rate)
+//   --seconds             how long to run (60)
+//   --threads             sending threads (32); devices are spread over
+//                         them, so this caps the requests in flight
+//   --warmup              GET <url>?warmup on each function first
+//   --csv                 where the results go (default stdout)
+//
+// Devices start evenly spread over one interval. Latency is timed from
+// when a request was due, not when it was sent, so a generator that
+// falls behind shows up in the percentiles instead of hiding it; the
+// lag column says how far behind it got.
+//
+// CSV, one row per endpoint:
+//   endpoint,protocol,devices,seconds,requests,errors,error_rate,
+//   throughput_rps,p50_ms,p95_ms,p99_ms,max_ms,payload_bytes,lag_p99_ms,
+//   cold_requests,cold_p50_ms,cold_p99_ms,warm_p50_ms,warm_p99_ms
+// payload_bytes is the mean request body (plus the JSON header for
+// the header protocol and for averages). Errors are transport errors
+// and HTTP statuses other than 200 (and 204, no data, for averages).
+// Cold is each thread's first request to the endpoint (a new
+// connection, and on a fresh deploy a new instance), warm the rest;
+// compare runs with and without --warmup.
+//////////////////////////////////////////////////////////////////////
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HalNet.h"
+#include "CloudProtocol.h"
+
+typedef std::chrono::steady_clock Clock;
+
+enum Endpoint
+{
+    UPLOAD,
+    AVERAGE,
+    NUM_ENDPOINTS
+};
+
+enum Protocol
+{
+    BINARY,
+    JSON,
+    HEADER
+};
+
+struct Options
+{
+    std::string url[NUM_ENDPOINTS];
+    int devices;
+    double every[NUM_ENDPOINTS];
+    int batch;
+    Protocol protocol;
+    double seconds;
+    int threads;
+    bool warmup;
+    std::string csv;
+};
+
+// What one sending thread measured, per endpoint
+struct Measurements
+{
+    std::vector<double> latencyMs[NUM_ENDPOINTS];
+    std::vector<double> coldMs[NUM_ENDPOINTS]; // first request per thread
+    std::vector<double> warmMs[NUM_ENDPOINTS];
+    std::vector<double> lagMs[NUM_ENDPOINTS];
+    uint64_t payloadBytes[NUM_ENDPOINTS];
+    int errors[NUM_ENDPOINTS];
+};
+
+// A request that is due
+struct Due
+{
+    Clock::time_point at;
+    int device;
+    Endpoint endpoint;
+
+    bool operator>(const Due &other) const { return at > other.at; }
+};
+
+static const char *protocolNames[] = {"binary", "json", "header"};
+static const char *endpointNames[] = {"upload", "average"};
+
+//////////////////////////////////////////////////////////////////////
+// A Core2 on a desk: a slow temperature and humidity swing, light and
+// proximity noise and gravity on the z axis
+//////////////////////////////////////////////////////////////////////
+static deviceDetails replayDetails(unsigned long time, int device)
+{
+    double phase = (time % 86400) * 2.0 * M_PI / 86400.0;
+    deviceDetails details;
+    details.timeCaptured = time;
+    details.prox = 2 + (time * 7 + device) % 5;
+    details.ambientLight = 300 + (time * 13) % 40;
+    details.whiteLight = 500 + (time * 11) % 60;
+    details.temp = 21.0 + 2.5 * sin(phase) + 0.01 * (device % 100);
+    details.rHum = 45.0 - 8.0 * sin(phase);
+    details.accX = 0.05 * ((time % 3) - 1.0);
+    details.accY = 0.05 * ((time % 5) - 2.0);
+    details.accZ = 9.8;
+    return details;
+}
+
+//////////////////////////////////////////////////////////////////////
+// One upload from device: returns the HTTP code and adds the payload
+// size to bytes
+//////////////////////////////////////////////////////////////////////
+static int sendUpload(const Options &options, int device, uint64_t *bytes)
+{
+    char userId[32];
+    snprintf(userId, sizeof(userId), "loadgen-%d", device);
+    unsigned long now = (unsigned long)time(nullptr);
+    char response[256];
+
+    if (options.protocol == BINARY)
+    {
+        std::vector<uint8_t> body(TelemetryEncoder::maxSize(options.batch, strlen(userId)));
+        TelemetryEncoder encoder(body.data(), body.size());
+        encoder.begin(userId);
+        for (int i = 0; i < options.batch; i++)
+            encoder.add(toTelemetrySample(replayDetails(now - options.batch + 1 + i, device)));
+        size_t length = encoder.finish();
+        *bytes += length;
+
+        const char *keys[1] = {"Content-Type"};
+        const char *vals[1] = {"application/octet-stream"};
+        return HalHttp::request("POST", options.url[UPLOAD].c_str(), keys, vals, 1, body.data(), length,
+                                response, sizeof(response));
+    }
+
+    char sample[512];
+    if (options.protocol == JSON)
+    {
+        std::string body = std::string("{\"userId\":\"") + userId + "\",\"samples\":[";
+        for (int i = 0; i < options.batch; i++)
+        {
+            formatM5Details(sample, sizeof(sample), userId, replayDetails(now - options.batch + 1 + i, device));
+            body += (i > 0 ? "," : "") + std::string(sample);
+        }
+        body += "]}";
+        *bytes += body.length();
+
+        const char *keys[1] = {"Content-Type"};
+        const char *vals[1] = {"application/json"};
+        return HalHttp::request("POST", options.url[UPLOAD].c_str(), keys, vals, 1, (const uint8_t *)body.data(),
+                                body.length(), response, sizeof(response));
+    }
+
+    // HEADER: one sample per request (--batch doesn't apply)
+    formatM5Details(sample, sizeof(sample), userId, replayDetails(now, device));
+    *bytes += strlen(sample);
+    const char *keys[1] = {"M5-Details"};
+    const char *vals[1] = {sample};
+    return HalHttp::get(options.url[UPLOAD].c_str(), keys, vals, 1, response, sizeof(response));
+}
+
+static int sendAverage(const Options &options, int device, int count, uint64_t *bytes)
+{
+    static const int durations[] = {5, 30, 120};
+    static const char *dataTypes[] = {"temp", "rHum", "prox"};
+
+    // Mostly the device's own data, sometimes everyone's
+    char userId[32];
+    if (count % 10 == 9)
+        snprintf(userId, sizeof(userId), "all");
+    else
+        snprintf(userId, sizeof(userId), "loadgen-%d", device);
+
+    char header[128];
+    formatReqDetails(header, sizeof(header), userId, durations[count % 3], dataTypes[(count / 3) % 3]);
+    *bytes += strlen(header);
+
+    const char *keys[1] = {"Req-Details"};
+    const char *vals[1] = {header};
+    char response[512];
+    int code = HalHttp::get(options.url[AVERAGE].c_str(), keys, vals, 1, response, sizeof(response));
+    return code == 204 ? 200 : code;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Sending thread: works through its devices' requests in the order
+// they are due
+//////////////////////////////////////////////////////////////////////
+static void runThread(const Options &options, int thread, Clock::time_point start, Measurements *out)
+{
+    Clock::time_point end = start + std::chrono::microseconds((int64_t)(options.seconds * 1e6));
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due> > queue;
+    std::vector<int> averagesSent(options.devices, 0);
+
+    for (int e = 0; e < NUM_ENDPOINTS; e++)
+    {
+        out->payloadBytes[e] = 0;
+        out->errors[e] = 0;
+        if (options.url[e].empty())
+            continue;
+        for (int device = thread; device < options.devices; device += options.threads)
+        {
+            double phase = options.every[e] * device / options.devices;
+            Due due = {start + std::chrono::microseconds((int64_t)(phase * 1e6)), device, (Endpoint)e};
+            queue.push(due);
+        }
+    }
+
+    while (!queue.empty())
+    {
+        Due due = queue.top();
+        queue.pop();
+        if (due.at >= end)
+            break;
+        std::this_thread::sleep_until(due.at);
+
+        Clock::time_point sent = Clock::now();
+        int code;
+        if (due.endpoint == UPLOAD)
+            code = sendUpload(options, due.device, &out->payloadBytes[UPLOAD]);
+        else
+            code = sendAverage(options, due.device, averagesSent[due.device]++, &out->payloadBytes[AVERAGE]);
+        Clock::time_point done = Clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(done - due.at).count();
+        out->latencyMs[due.endpoint].push_back(ms);
+        (out->coldMs[due.endpoint].empty() ? out->coldMs : out->warmMs)[due.endpoint].push_back(ms);
+        out->lagMs[due.endpoint].push_back(std::chrono::duration<double, std::milli>(sent - due.at).count());
+        if (code != 200)
+            out->errors[due.endpoint]++;
+
+        due.at += std::chrono::microseconds((int64_t)(options.every[due.endpoint] * 1e6));
+        queue.push(due);
+    }
+}
+
+static double percentile(std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t index = (size_t)ceil(p / 100.0 * sorted.size());
+    return sorted[index > 0 ? index - 1 : 0];
+}
+
+static bool parseOptions(int argc, char **argv, Options *options)
+{
+    options->devices = 100;
+    options->every[UPLOAD] = 30;
+    options->every[AVERAGE] = 60;
+    options->batch = 30;
+    options->protocol = BINARY;
+    options->seconds = 60;
+    options->threads = 32;
+    options->warmup = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *eq = strchr(arg, '=');
+        std::string name(arg, eq != nullptr ? eq - arg : strlen(arg));
+        const char *value = eq != nullptr ? eq + 1 : "";
+
+        if (name == "--upload")
+            options->url[UPLOAD] = value;
+        else if (name == "--average")
+            options->url[AVERAGE] = value;
+        else if (name == "--devices")
+            options->devices = atoi(value);
+        else if (name == "--upload-every")
+            options->every[UPLOAD] = atof(value);
+        else if (name == "--average-every")
+            options->every[AVERAGE] = atof(value);
+        else if (name == "--batch")
+            options->batch = atoi(value);
+        else if (name == "--seconds")
+            options->seconds = atof(value);
+        else if (name == "--threads")
+            options->threads = atoi(value);
+        else if (name == "--warmup")
+            options->warmup = true;
+        else if (name == "--csv")
+            options->csv = value;
+        else if (name == "--protocol")
+        {
+            int p = 0;
+            while (p < 3 && strcmp(value, protocolNames[p]) != 0)
+                p++;
+            if (p == 3)
+            {
+                fprintf(stderr, "unknown protocol %s\n", value);
+                return false;
+            }
+            options->protocol = (Protocol)p;
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return false;
+        }
+    }
+
+    if (options->url[UPLOAD].empty() && options->url[AVERAGE].empty())
+    {
+        fprintf(stderr, "give --upload=<url> and/or --average=<url>\n");
+        return false;
+    }
+    if (options->devices < 1 || options->threads < 1 || options->seconds <= 0 || options->every[UPLOAD] <= 0 ||
+        options->every[AVERAGE] <= 0 || options->batch < 1 || options->batch > 65535)
+    {
+        fprintf(stderr, "devices, threads, seconds, intervals and batch must be positive\n");
+        return false;
+    }
+    if (options->threads > options->devices)
+        options->threads = options->devices;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, &options))
+        return 2;
+
+    FILE *csv = stdout;
+    if (!options.csv.empty() && (csv = fopen(options.csv.c_str(), "w")) == nullptr)
+    {
+        fprintf(stderr, "can't write %s\n", options.csv.c_str());
+        return 2;
+    }
+
+    if (options.warmup)
+    {
+        for (int e = 0; e < NUM_ENDPOINTS; e++)
+        {
+            if (options.url[e].empty())
+                continue;
+            std::string url = options.url[e] + (options.url[e].find('?') != std::string::npos ? "&warmup" : "?warmup");
+            fprintf(stderr, "%s warm-up: HTTP %d\n", endpointNames[e], HalHttp::get(url.c_str(), nullptr, nullptr, 0, nullptr, 0));
+        }
+    }
+
+    std::vector<Measurements> measurements(options.threads);
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now() + std::chrono::milliseconds(100);
+    for (int i = 0; i < options.threads; i++)
+        threads.push_back(std::thread(runThread, std::cref(options), i, start, &measurements[i]));
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    fprintf(csv, "endpoint,protocol,devices,seconds,requests,errors,error_rate,throughput_rps,"
+                 "p50_ms,p95_ms,p99_ms,max_ms,payload_bytes,lag_p99_ms,"
+                 "cold_requests,cold_p50_ms,cold_p99_ms,warm_p50_ms,warm_p99_ms\n");
+    int errorsTotal = 0;
+    for (int e = 0; e < NUM_ENDPOINTS; e++)
+    {
+        if (options.url[e].empty())
+            continue;
+        std::vector<double> latency;
+        std::vector<double> cold;
+        std::vector<double> warm;
+        std::vector<double> lag;
+        uint64_t bytes = 0;
+        int errors = 0;
+        for (size_t i = 0; i < measurements.size(); i++)
+        {
+            latency.insert(latency.end(), measurements[i].latencyMs[e].begin(), measurements[i].latencyMs[e].end());
+            cold.insert(cold.end(), measurements[i].coldMs[e].begin(), measurements[i].coldMs[e].end());
+            warm.insert(warm.end(), measurements[i].warmMs[e].begin(), measurements[i].warmMs[e].end());
+            lag.insert(lag.end(), measurements[i].lagMs[e].begin(), measurements[i].lagMs[e].end());
+            bytes += measurements[i].payloadBytes[e];
+            errors += measurements[i].errors[e];
+        }
+        std::sort(latency.begin(), latency.end());
+        std::sort(cold.begin(), cold.end());
+        std::sort(warm.begin(), warm.end());
+        std::sort(lag.begin(), lag.end());
+        size_t requests = latency.size();
+        errorsTotal += errors;
+
+        fprintf(csv, "%s,%s,%d,%.1f,%zu,%d,%.4f,%.2f,%.1f,%.1f,%.1f,%.1f,%.0f,%.1f,%zu,%.1f,%.1f,%.1f,%.1f\n",
+                endpointNames[e], protocolNames[options.protocol], options.devices, seconds, requests, errors,
+                requests ? (double)errors / requests : 0.0, requests / seconds,
+                percentile(latency, 50), percentile(latency, 95), percentile(latency, 99),
+                requests ? latency.back() : 0.0, requests ? (double)bytes / requests : 0.0, percentile(lag, 99),
+                cold.size(), percentile(cold, 50), percentile(cold, 99), percentile(warm, 50), percentile(warm, 99));
+    }
+
+    if (csv != stdout)
+        fclose(csv);
+    return errorsTotal > 0 ? 1 : 0;
+}
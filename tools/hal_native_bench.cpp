@@ -0,0 +1,671 @@
+//////////////////////////////////////////////////////////////////////
+// Host-side benchmark for the code that goes through the HAL
+// (include/Hal.h, include/HalNet.h), using the Linux backend
+//
+// Build and run on a PC:
+//   g++ -O2 -g -std=gnu++11 -DHAL_LINUX -Iinclude tools/hal_native_bench.cpp -o hal_native_bench -pthread
+//   ./hal_native_bench [frame.ppm]
+// Add -fsanitize=address,undefined (or -fsanitize=thread) for a
+// sanitizer run, or run it under perf record.
+//
+// - ImuFifo + TiltFilter against a simulated MPU6886 for one second
+// - the Scheduler's timer wheel and a pin event from another thread,
+//   and after(0) queued before the first run() and from a handler
+// - GlyphCache drawing into the framebuffer (dumped as a PPM)
+// - the Whack-A-Mole roll exchange over a loopback BLE link
+// - HTTP GETs with headers to a server on localhost
+// - HttpWorker: a slow GET in the background while loop() keeps going,
+//   its body parsed into an AverageResult as it streams in
+// - FlashLog wrapping around a simulated flash partition, with resets
+// Prints timings and exits non-zero if anything fails.
+//////////////////////////////////////////////////////////////////////
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+#include "Hal.h"
+#include "HalNet.h"
+#include "ImuFifo.h"
+#include "TiltFilter.h"
+#include "Scheduler.h"
+#include "GlyphCache.h"
+#include "FlashLog.h"
+#include "HttpWorker.h"
+#include "AverageResult.h"
+#include "TelemetryRecord.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//////////////////////////////////////////////////////////////////////
+// MPU6886 that fills its FIFO at the configured rate while the
+// device is slowly rocked left and right
+//////////////////////////////////////////////////////////////////////
+class FakeMpu6886 : public HalRegisterDevice
+{
+    public:
+        FakeMpu6886() : lastUs(0), produced(0)
+        {
+            regs[0x75] = 0x19; // WHO_AM_I
+        }
+
+        uint8_t readRegister(uint8_t reg)
+        {
+            if (reg == 0x72 || reg == 0x73) // FIFO_COUNTH/L
+            {
+                fill();
+                int count = fifo.size();
+                return reg == 0x72 ? count >> 8 : count & 0xFF;
+            }
+            if (reg == 0x74) // FIFO_R_W
+            {
+                if (fifo.empty())
+                    return 0;
+                uint8_t value = fifo.front();
+                fifo.pop_front();
+                return value;
+            }
+            return regs[reg];
+        }
+
+        void writeRegister(uint8_t reg, uint8_t value)
+        {
+            regs[reg] = value;
+            if (reg == 0x6A && (value & 0x04)) // FIFO_RST
+            {
+                fifo.clear();
+                lastUs = halMicros();
+            }
+        }
+
+        bool autoIncrement(uint8_t reg) { return reg != 0x74; }
+
+        uint32_t samplesProduced() const { return produced; }
+
+    private:
+        std::deque<uint8_t> fifo;
+        uint32_t lastUs;
+        uint32_t produced;
+
+        void fill()
+        {
+            if (!(regs[0x6A] & 0x40)) // FIFO off
+                return;
+            uint32_t periodUs = 1000 * (regs[0x19] + 1);
+            uint32_t now = halMicros();
+            while ((int32_t)(now - lastUs) >= (int32_t)periodUs)
+            {
+                lastUs += periodUs;
+                float angle = 0.5f * sinf(produced * periodUs * 1e-6f * 2.0f);
+                int16_t packet[7] = {(int16_t)(4096 * sinf(angle)), 0, (int16_t)(4096 * cosf(angle)), 0, 0, 0, 0};
+                for (int i = 0; i < 7; i++)
+                {
+                    fifo.push_back(packet[i] >> 8);
+                    fifo.push_back(packet[i] & 0xFF);
+                }
+                while (fifo.size() > 1024)
+                    fifo.pop_front();
+                produced++;
+            }
+        }
+};
+
+void benchImu()
+{
+    static FakeMpu6886 mpu;
+    HalI2c &bus = HalI2c::internal();
+    bus.attach(ImuFifo::ADDRESS, &mpu);
+
+    ImuFifo fifo(bus);
+    TiltFilter tilt;
+    check(fifo.begin(500, 5), "ImuFifo::begin() finds the MPU6886");
+
+    uint32_t samples = 0;
+    float maxTilt = 0;
+    double busyS = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (secondsSince(start) < 1.0)
+    {
+        auto t = std::chrono::steady_clock::now();
+        fifo.poll();
+        ImuSample sample;
+        while (fifo.read(&sample))
+        {
+            tilt.update(sample, fifo.samplePeriodUs() * 1e-6f);
+            samples++;
+            if (fabsf(tilt.tiltX()) > maxTilt)
+                maxTilt = fabsf(tilt.tiltX());
+        }
+        busyS += secondsSince(t);
+        halDelay(1);
+    }
+
+    printf("imu: %u samples (%u produced), %u I2C transactions, %.1f ms on the bus, %.2f us CPU per sample, max tilt %.2f g\n",
+           samples, mpu.samplesProduced(), fifo.busTransactions(), bus.busTimeMicros() / 1000.0,
+           samples ? busyS * 1e6 / samples : 0.0, maxTilt);
+    check(samples + 10 >= mpu.samplesProduced(), "every FIFO sample is read");
+    check(fifo.droppedSamples() == 0 && fifo.fifoOverflows() == 0, "no samples lost");
+    check(maxTilt > 0.1f, "the tilt filter follows the rocking");
+}
+
+//////////////////////////////////////////////////////////////////////
+// Scheduler: a 10 ms task, a one-shot and a pin event
+//////////////////////////////////////////////////////////////////////
+static Scheduler scheduler;
+static int ticks = 0;
+static int oneShots = 0;
+static int pinEvents = 0;
+
+void benchScheduler()
+{
+    const int pin = 39;
+    const int EVENT_PIN = 3;
+    scheduler.every(10, [] { ticks++; });
+    scheduler.after(50, [] { oneShots++; });
+    scheduler.onEvent(EVENT_PIN, [] { pinEvents++; });
+    scheduler.attachPinEvent(pin, FALLING, EVENT_PIN, true, false);
+
+    halTriggerPin(pin, true);
+    std::thread edges([pin] {
+        for (int i = 0; i < 5; i++)
+        {
+            halDelay(20);
+            halTriggerPin(pin, false);
+            halTriggerPin(pin, true);
+        }
+    });
+
+    uint32_t runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (secondsSince(start) < 0.3)
+    {
+        scheduler.run();
+        runs++;
+    }
+    edges.join();
+    scheduler.run();
+
+    printf("scheduler: %d ticks, %d one-shot, %d pin events in %u run() calls\n", ticks, oneShots, pinEvents, runs);
+    check(ticks >= 25 && ticks <= 31, "10 ms task ran about 30 times in 300 ms");
+    check(oneShots == 1, "one-shot ran once");
+    check(pinEvents >= 1 && pinEvents <= 5, "pin events were dispatched");
+    check(runs < 1000, "run() waits instead of spinning");
+}
+
+//////////////////////////////////////////////////////////////////////
+// Scheduler: after(0) from before the first run() (as setup() does)
+// and from an event handler posted by a task, in the same millisecond
+// the wheel has just passed. Both must run right away, not a turn of
+// the wheel later.
+//////////////////////////////////////////////////////////////////////
+static Scheduler overdueScheduler;
+static uint32_t queuedAt = 0;
+static uint32_t ranAt = 0;
+static int kicks = 0;
+
+void benchSchedulerOverdue()
+{
+    const int EVENT_KICK = 0;
+    overdueScheduler.after(0, [] { ranAt = halMillis(); });
+    queuedAt = halMillis();
+    halDelay(5); // setup() finishing a few ms later
+
+    uint32_t runs = 0;
+    while (ranAt == 0 && halMillis() - queuedAt < 200)
+    {
+        overdueScheduler.run();
+        runs++;
+    }
+    uint32_t firstDelay = ranAt - queuedAt;
+
+    // a task posts an event; its handler (run in the same run() call,
+    // right after the tasks) queues after(0)
+    ranAt = 0;
+    int kicker = overdueScheduler.every(10, [] { overdueScheduler.post(EVENT_KICK); });
+    overdueScheduler.onEvent(EVENT_KICK, [] {
+        if (kicks++ == 0)
+        {
+            queuedAt = halMillis();
+            overdueScheduler.after(0, [] { ranAt = halMillis(); });
+        }
+    });
+    uint32_t start = halMillis();
+    uint32_t handlerRuns = 0;
+    while (ranAt == 0 && halMillis() - start < 200)
+    {
+        overdueScheduler.run();
+        handlerRuns++;
+    }
+    overdueScheduler.cancel(kicker);
+    uint32_t handlerDelay = ranAt - queuedAt;
+
+    printf("scheduler: after(0) ran %u ms after setup (%u run() calls), %u ms after a handler (%u calls)\n",
+           firstDelay, runs, handlerDelay, handlerRuns);
+    check(ranAt != 0 && firstDelay <= 7 && runs <= 3, "after(0) from before the first run() ran at once");
+    check(kicks >= 1 && handlerDelay <= 2, "after(0) from an event handler ran at once");
+    check(handlerRuns < 100, "run() waits for the wheel instead of spinning");
+}
+
+//////////////////////////////////////////////////////////////////////
+// Scheduler: a wake pin (the touch INT) still raises one event per
+// falling edge once the scheduler has light-slept, which makes its
+// interrupt level triggered for the sleep. A finger held down must
+// not keep firing it, nor keep waking the chip.
+//////////////////////////////////////////////////////////////////////
+static Scheduler sleepScheduler;
+static int touches = 0;
+
+void benchSchedulerSleep()
+{
+    const int pin = 36;
+    const int EVENT_TOUCH = 0;
+    sleepScheduler.every(10, [] {});
+    sleepScheduler.onEvent(EVENT_TOUCH, [] { touches++; });
+    halTriggerPin(pin, true);
+    sleepScheduler.attachPinEvent(pin, FALLING, EVENT_TOUCH, true);
+    sleepScheduler.setLightSleep(true);
+
+    uint32_t sleepsBefore = halLightSleepCount();
+    for (int i = 0; i < 3; i++)
+        sleepScheduler.run();
+    uint32_t sleeps = halLightSleepCount() - sleepsBefore;
+
+    // press, hold (the interrupt sees the low level a few more times),
+    // release; twice
+    uint32_t heldSleeps = 0;
+    for (int press = 0; press < 2; press++)
+    {
+        halTriggerPin(pin, false);
+        sleepScheduler.run();
+        uint32_t before = halLightSleepCount();
+        for (int i = 0; i < 3; i++)
+        {
+            halTriggerPin(pin, false);
+            sleepScheduler.run();
+        }
+        heldSleeps += halLightSleepCount() - before;
+        halTriggerPin(pin, true);
+        sleepScheduler.run();
+    }
+
+    printf("scheduler: %u light sleeps, then %d pin events for 2 presses (%u sleeps while held)\n", sleeps,
+           touches, heldSleeps);
+    check(sleeps >= 2, "the scheduler light-slept");
+    check(touches == 2, "one pin event per press after a light sleep");
+    check(heldSleeps == 0, "no light sleep while the wake pin is held");
+}
+
+//////////////////////////////////////////////////////////////////////
+// GlyphCache into the framebuffer
+//////////////////////////////////////////////////////////////////////
+void benchGlyphs(const char *ppmPath)
+{
+    HalDisplay &lcd = HalDisplay::lcd();
+    lcd.fillRect(0, 0, lcd.width(), lcd.height(), 0x0000);
+
+    const int repeats = 2000;
+    uint32_t before = lcd.pixelsWritten();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++)
+        GlyphCache::drawString(10, 10 + (i % 10) * 20, "0123456789", 2, 0xF81F, 0x0000);
+    double s = secondsSince(start);
+    uint32_t pixels = lcd.pixelsWritten() - before;
+
+    printf("glyphs: %.2f us per character, %u pixels per string\n", s * 1e6 / (repeats * 10), pixels / repeats);
+
+    int lit = 0;
+    for (int y = 10; y < 26; y++)
+        for (int x = 10; x < 22; x++)
+            lit += lcd.pixel(x, y) != 0;
+    check(lit > 20, "the '0' glyph was drawn");
+    check(lcd.dumpPpm(ppmPath), "frame dumped");
+}
+
+//////////////////////////////////////////////////////////////////////
+// Whack-A-Mole rolls over a loopback link, encoded as the apps do
+//////////////////////////////////////////////////////////////////////
+void benchBle()
+{
+    HalBleCharacteristic characteristic;
+    HalBleLink server;
+    HalBleLink client;
+    server.attach(&characteristic);
+    client.attach(&characteristic);
+
+    const int rounds = 100000;
+    int mismatches = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        char value[16];
+        snprintf(value, sizeof(value), "%d", i % 1000);
+        client.write(value);
+        server.read(value, sizeof(value));
+        mismatches += atoi(value) != i % 1000;
+    }
+    double s = secondsSince(start);
+
+    printf("ble: %.3f us per roll exchange\n", s * 1e6 / rounds);
+    check(mismatches == 0, "every roll arrived");
+    check(characteristic.writeCount() == (uint32_t)rounds, "one write per roll");
+}
+
+//////////////////////////////////////////////////////////////////////
+// HTTP GET with a header to a one-thread server on localhost, which
+// answers with the header it got (after delayMs). It stops after
+// requests or when the listener is shut down.
+//////////////////////////////////////////////////////////////////////
+void serveHttp(int listener, int requests, int delayMs)
+{
+    for (int i = 0; i < requests; i++)
+    {
+        int sock = accept(listener, nullptr, nullptr);
+        if (sock < 0)
+            return;
+        char request[2048];
+        int length = 0;
+        while (length < (int)sizeof(request) - 1)
+        {
+            ssize_t n = recv(sock, request + length, sizeof(request) - 1 - length, 0);
+            if (n <= 0)
+                break;
+            length += n;
+            request[length] = '\0';
+            if (strstr(request, "\r\n\r\n") != nullptr)
+                break;
+        }
+        request[length] = '\0';
+
+        halDelay(delayMs);
+        const char *details = strstr(request, "M5-Details: ");
+        std::string body = details != nullptr ? std::string(details + 12, strcspn(details + 12, "\r")) : "missing";
+        std::string reply = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n\r\n" + body;
+        send(sock, reply.data(), reply.length(), MSG_NOSIGNAL);
+        close(sock);
+    }
+}
+
+// Listening socket on a free localhost port; -1 on failure
+int openListener(int *port)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t addressLength = sizeof(address);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0 ||
+        getsockname(listener, (struct sockaddr *)&address, &addressLength) != 0)
+    {
+        close(listener);
+        return -1;
+    }
+    *port = ntohs(address.sin_port);
+    return listener;
+}
+
+void benchHttp()
+{
+    int port;
+    int listener = openListener(&port);
+    if (listener < 0)
+    {
+        check(false, "localhost server started");
+        return;
+    }
+
+    const int requests = 200;
+    std::thread server(serveHttp, listener, requests, 0);
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/upload", port);
+    const char *keys[1] = {"M5-Details"};
+    const char *vals[1] = {"{\"userId\":\"raz\",\"temp\":21.5}"};
+    char response[256];
+    int ok = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < requests; i++)
+    {
+        int code = HalHttp::get(url, keys, vals, 1, response, sizeof(response));
+        ok += code == 200 && strcmp(response, vals[0]) == 0;
+    }
+    double s = secondsSince(start);
+    server.join();
+    close(listener);
+
+    printf("http: %.1f us per GET on localhost\n", s * 1e6 / requests);
+    check(ok == requests, "every GET returned 200 with the header echoed");
+    check(HalHttp::get("https://example.com/", keys, vals, 1, response, sizeof(response)) == HalHttp::ERROR_URL,
+          "https is refused natively");
+}
+
+//////////////////////////////////////////////////////////////////////
+// HttpWorker against a server that takes 200 ms per answer: the loop
+// thread keeps running a 10 ms task meanwhile, a cancelled request's
+// answer is dropped in favour of the one after it, and an average
+// response is parsed as it comes off the socket
+//////////////////////////////////////////////////////////////////////
+static Scheduler workerScheduler;
+// never destroyed: its thread keeps waiting on it until the process exits
+static HttpWorker &worker = *new HttpWorker(workerScheduler, 0);
+static int workerTicks = 0;
+static int workerAnswers = 0;
+
+// Run the loop until an answer is in or ms have passed
+static void runUntilAnswered(uint32_t ms)
+{
+    int answers = workerAnswers;
+    uint32_t start = halMillis();
+    while (workerAnswers == answers && halMillis() - start < ms)
+        workerScheduler.run();
+}
+
+void benchHttpWorker()
+{
+    int port;
+    int listener = openListener(&port);
+    if (listener < 0)
+    {
+        check(false, "localhost server started");
+        return;
+    }
+    const int delayMs = 200;
+    std::thread server(serveHttp, listener, 10, delayMs);
+
+    workerScheduler.every(10, [] { workerTicks++; });
+    workerScheduler.onEvent(0, [] {
+        if (worker.done())
+            workerAnswers++;
+    });
+    check(worker.begin(), "worker task started");
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/average", port);
+    const char *keys[1] = {"M5-Details"};
+    const char *first[1] = {"first"};
+    const char *second[1] = {"second"};
+    char response[64];
+    HalHttpBuffer body(response, sizeof(response));
+
+    // One request; the loop doesn't stop for it
+    uint32_t start = halMillis();
+    check(worker.get(url, keys, first, 1, &body), "request queued");
+    uint32_t queueMs = halMillis() - start;
+    check(worker.pending(), "request pending");
+    runUntilAnswered(2000);
+    printf("http worker: get() returned in %u ms, answer after %u ms, %d loop ticks meanwhile\n", queueMs,
+           worker.elapsedMs(), workerTicks);
+    check(queueMs < 20, "get() doesn't wait for the answer");
+    check(workerAnswers == 1 && worker.code() == 200 && strcmp(response, "first") == 0,
+          "the answer came back through the event");
+    check(workerTicks >= delayMs / 10 - 5, "the 10 ms task kept running during the request");
+
+    // Cancel one mid-flight and ask again at once
+    check(worker.get(url, keys, first, 1, &body), "request queued");
+    halDelay(50);
+    worker.cancel();
+    check(!worker.pending() && !worker.done(), "nothing pending after cancel()");
+    check(worker.get(url, keys, second, 1, &body), "request queued behind the cancelled one");
+    runUntilAnswered(2000);
+    runUntilAnswered(delayMs); // a stray answer would show up here
+    check(workerAnswers == 2 && strcmp(response, "second") == 0, "only the second answer arrived");
+
+    // An average answer, straight into the parser
+    const char *average[1] = {"{\"dataType\":\"temp\",\"averageData\":21.35,\"minData\":20.9,\"maxData\":21.8,"
+                              "\"timeRange\":\"10:00 - 10:05\",\"numDataPoints\":300,\"rateDataCollect\":1,"
+                              "\"x\":{\"a\":[1,null]}}"};
+    AverageResultParser parser;
+    AverageResult result;
+    check(worker.get(url, keys, average, 1, &parser), "request queued");
+    runUntilAnswered(2000);
+    check(workerAnswers == 3 && parser.result(&result) && result.dataType == DATA_TEMP &&
+          fabsf(result.average - 21.35f) < 1e-4f && result.min == 20.9f && result.max == 21.8f &&
+          result.count == 300 && result.rate == 1.0f && strcmp(result.timeRange, "10:00 - 10:05") == 0,
+          "the average answer was parsed into an AverageResult");
+
+    // The same answer one byte at a time, and some that aren't one
+    parser.begin();
+    for (const char *c = average[0]; *c != '\0'; c++)
+        parser.write(c, 1);
+    AverageResult bytewise;
+    check(parser.result(&bytewise) && memcmp(&bytewise, &result, sizeof(result)) == 0,
+          "byte by byte parses the same");
+    const char *bad[] = {"No matching documents", "{\"dataType\":\"temp\",\"averageData\":1}",
+                         "{\"dataType\":\"temp\",\"averageData\":1,\"numDataPoints\":2"};
+    int rejected = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        parser.begin();
+        parser.write(bad[i], strlen(bad[i]));
+        rejected += !parser.result(&bytewise);
+    }
+    check(rejected == 3, "text, missing fields and a cut-off object are rejected");
+
+    shutdown(listener, SHUT_RDWR);
+    server.join();
+    close(listener);
+}
+
+//////////////////////////////////////////////////////////////////////
+// FlashLog: fill a 16 sector partition several times over while
+// uploading in batches, remount it as a reset would, corrupt a slot
+//////////////////////////////////////////////////////////////////////
+void benchFlashLog()
+{
+    typedef FlashLog<TelemetrySample> Log;
+    HalFlash flash(16);
+    Log log(flash);
+    check(log.begin(), "FlashLog formats an empty partition");
+
+    // Append 3 records per consumed 2 until it has wrapped 3 times
+    const int perSegment = Log::SLOTS_PER_SEGMENT;
+    const int total = perSegment * 16 * 3;
+    uint32_t nextRead = 0;
+    int outOfOrder = 0;
+    TelemetrySample batch[30];
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < total; i++)
+    {
+        TelemetrySample sample = {(uint32_t)i, (uint16_t)i, 0, 0, 20.0f, 50.0f, {0, 0, 9.8f}};
+        log.append(sample);
+        if (i % 45 == 44)
+        {
+            int n = log.read(batch, 30);
+            for (int j = 0; j < n; j++)
+            {
+                outOfOrder += batch[j].timeCaptured < nextRead;
+                nextRead = batch[j].timeCaptured + 1;
+            }
+            log.consume(n);
+        }
+    }
+    double s = secondsSince(start);
+    int pending = log.pending();
+
+    // A reset: mount again and check the cursor and count came back
+    Log remounted(flash);
+    check(remounted.begin(), "FlashLog mounts again");
+    int n = remounted.read(batch, 1);
+    check(remounted.pending() == pending, "pending count survives a reset");
+    check(n == 1 && batch[0].timeCaptured >= nextRead, "read cursor survives a reset");
+
+    // Corrupt the next record, as a reset in the middle of writing
+    // it would: it is skipped after the next mount
+    TelemetrySample torn = {999999, 1, 2, 3, 4, 5, {6, 7, 8}};
+    remounted.append(torn);
+    int after = remounted.pending();
+    bool tore = false;
+    for (uint32_t sector = 0; sector < 16 && !tore; sector++)
+    {
+        for (int slot = 0; slot < perSegment && !tore; slot++)
+        {
+            uint32_t at = sector * HalFlash::SECTOR_SIZE + Log::HEADER_SIZE + slot * Log::SLOT_SIZE;
+            TelemetrySample stored;
+            flash.read(at + 4, &stored, sizeof(stored));
+            if (stored.timeCaptured == torn.timeCaptured)
+            {
+                uint8_t zero = 0;
+                flash.write(at + 2, &zero, 1); // its CRC
+                tore = true;
+            }
+        }
+    }
+    Log afterReset(flash);
+    afterReset.begin();
+    check(tore && afterReset.pending() == after - 1, "a torn record is skipped after a reset");
+
+    uint32_t minErases = 0xFFFFFFFF;
+    uint32_t maxErases = 0;
+    for (int sector = 0; sector < 16; sector++)
+    {
+        minErases = flash.eraseCount(sector) < minErases ? flash.eraseCount(sector) : minErases;
+        maxErases = flash.eraseCount(sector) > maxErases ? flash.eraseCount(sector) : maxErases;
+    }
+
+    printf("flash log: %d records of %d bytes, %.2f us per append, %u dropped, %d pending, %u-%u erases per sector\n",
+           total, Log::SLOT_SIZE, s * 1e6 / total, log.droppedRecords(), pending, minErases, maxErases);
+    check(outOfOrder == 0, "records are read back in order");
+    check(log.droppedRecords() > 0, "a full log drops its oldest records");
+    check(maxErases - minErases <= 1, "erases are spread evenly over the sectors");
+}
+
+int main(int argc, char **argv)
+{
+    const char *ppmPath = argc > 1 ? argv[1] : "hal_frame.ppm";
+
+    benchImu();
+    benchScheduler();
+    benchSchedulerOverdue();
+    benchSchedulerSleep();
+    benchGlyphs(ppmPath);
+    benchBle();
+    benchHttp();
+    benchHttpWorker();
+    benchFlashLog();
+
+    if (failures > 0)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
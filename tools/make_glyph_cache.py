@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+Generates include/GlyphCacheData.h: anti-aliased glyphs for the large
+numeric text on the weather screens, stored as 4-bit alpha.
+
+Each glyph is rendered into the same 6x8 cell (times the text size) as
+the built-in GLCD font, so cached and uncached text line up and
+TextField can mix them freely.
+
+Usage: python3 tools/make_glyph_cache.py [path/to/font.ttf]
+Requires Pillow.
+"""
+import sys
+from pathlib import Path
+from PIL import Image, ImageDraw, ImageFont
+
+FONT = sys.argv[1] if len(sys.argv) > 1 else "/usr/share/fonts/truetype/dejavu/DejaVuSansMono-Bold.ttf"
+OUT = Path(__file__).resolve().parent.parent / "include" / "GlyphCacheData.h"
+SUPERSAMPLE = 8
+
+# text size -> characters cached at that size (what the screens print)
+SETS = {
+    2: "0123456789-.",
+    3: "0123456789-:CFHILO",
+    4: "0123456789-%CF",
+    10: "0123456789-CF",
+}
+
+
+def render(ch, size):
+    cw, ch_h = 6 * size * SUPERSAMPLE, 8 * size * SUPERSAMPLE
+    # GLCD glyphs use the top 7 rows and left 5 columns of the cell
+    box_w, baseline = 5 * size * SUPERSAMPLE, 7 * size * SUPERSAMPLE
+
+    # pick the font size that makes a digit exactly as tall as a GLCD digit
+    probe = ImageFont.truetype(FONT, 100)
+    x0, y0, x1, y1 = probe.getbbox("0", anchor="ls")
+    font = ImageFont.truetype(FONT, int(100 * baseline * 0.97 / (y1 - y0)))
+
+    img = Image.new("L", (cw, ch_h), 0)
+    draw = ImageDraw.Draw(img)
+    x0, y0, x1, y1 = font.getbbox(ch, anchor="ls")
+    ink_w = x1 - x0
+    if ink_w > cw:
+        # squeeze wide glyphs (e.g. '%') into the cell
+        wide = Image.new("L", (ink_w, ch_h), 0)
+        ImageDraw.Draw(wide).text((-x0, baseline), ch, font=font, fill=255, anchor="ls")
+        img.paste(wide.resize((cw, ch_h), Image.LANCZOS), (0, 0))
+    else:
+        x = (box_w - ink_w) // 2 - x0 if ink_w <= box_w else (cw - ink_w) // 2 - x0
+        draw.text((x, baseline), ch, font=font, fill=255, anchor="ls")
+
+    small = img.resize((6 * size, 8 * size), Image.BOX)
+    return [min(15, (p + 8) // 17) for p in small.tobytes()]
+
+
+def pack(alpha):
+    out = []
+    for i in range(0, len(alpha), 2):
+        out.append((alpha[i] << 4) | alpha[i + 1])
+    return out
+
+
+def ident(ch):
+    return "x%02X" % ord(ch)
+
+
+def main():
+    lines = []
+    lines.append("#ifndef GLYPH_CACHE_DATA_H")
+    lines.append("#define GLYPH_CACHE_DATA_H")
+    lines.append("")
+    lines.append("// Generated by tools/make_glyph_cache.py - do not edit by hand.")
+    lines.append("// 4-bit alpha, two pixels per byte (high nibble first), row major.")
+    lines.append("")
+    lines.append("#include <stdint.h>")
+    lines.append("")
+    total = 0
+    for size, chars in SETS.items():
+        for ch in chars:
+            data = pack(render(ch, size))
+            total += len(data)
+            lines.append("const uint8_t glyph%d_%s[%d] = { // '%s'" % (size, ident(ch), len(data), ch))
+            for i in range(0, len(data), 24):
+                lines.append("    " + ", ".join("0x%02X" % b for b in data[i:i + 24]) + ",")
+            lines.append("};")
+        lines.append("const uint8_t *const glyphs%d[%d] = { %s };" % (
+            size, len(chars), ", ".join("glyph%d_%s" % (size, ident(c)) for c in chars)))
+        lines.append("")
+
+    lines.append("struct GlyphSet")
+    lines.append("{")
+    lines.append("    uint8_t textSize;")
+    lines.append("    const char *chars;")
+    lines.append("    const uint8_t *const *glyphs;")
+    lines.append("};")
+    lines.append("")
+    lines.append("const GlyphSet glyphSets[%d] = {" % len(SETS))
+    for size, chars in SETS.items():
+        lines.append('    {%d, "%s", glyphs%d},' % (size, chars, size))
+    lines.append("};")
+    lines.append("const int NUM_GLYPH_SETS = %d;" % len(SETS))
+    lines.append("")
+    lines.append("#endif")
+    OUT.write_text("\n".join(lines) + "\n")
+    print("wrote %s (%d bytes of glyph data)" % (OUT, total))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""
+Generates include/MazeLevels.h: the a-MAZE-ing levels in the binary
+maze format described in include/Maze.h.
+
+Levels are drawn below as ASCII art, two characters per cell:
+    +--+    wall above/below       |   wall left/right
+    S E     start / end tile       F I flower bud / ice block
+The number of flowers to bloom is the number of F tiles.
+
+Usage: python3 tools/make_maze_levels.py [--bin DIR]
+    --bin DIR   also write DIR/<level>.maze files, e.g. for uploading
+                to LittleFS as /levels/<level>.maze
+"""
+import sys
+from pathlib import Path
+
+OUT = Path(__file__).resolve().parent.parent / "include" / "MazeLevels.h"
+
+MAGIC = b"MZ"
+VERSION = 1
+
+# keep in sync with include/Maze.h
+OPEN_LEFT, OPEN_RIGHT, OPEN_ABOVE, OPEN_BELOW = 0x01, 0x02, 0x04, 0x08
+FLOOR = {" ": 2, "S": 2, "E": 2, "F": 0, "I": 1}  # FloorType: WALKABLE, FLOWER, ICE
+
+LEVELS = {
+    "easy": """
++--+--+--+--+--+--+--+--+
+|F       |S |I       |F |
++--+  +  +  +  +--+  +  +
+|     |  |  |     |  |  |
++  +--+  +  +--+  +  +  +
+|     |  |        |     |
++--+  +  +--+--+--+  +--+
+|  |I |                 |
++  +  +--+--+--+  +--+--+
+|F |     |F    |  |     |
++  +  +  +--+  +  +  +  +
+|     |      E |I    |F |
++--+--+--+--+--+--+--+--+
+""",
+    "medium": """
++--+--+--+--+--+--+--+--+
+|      F |S |F          |
++  +  +--+  +--+--+  +  +
+|  |I |     |     |F |  |
++  +  +  +--+  +  +--+  +
+|  |  |I       |        |
++  +  +--+--+--+--+--+  +
+|  |F |              |  |
++  +--+  +--+--+  +  +  +
+|I |   F |     |  |F |I |
++  +  +--+  +  +  +--+  +
+|           |E |        |
++--+--+--+--+--+--+--+--+
+""",
+    "hard": """
++--+--+--+--+--+--+--+--+
+|   I |F  S |           |
++  +  +--+  +  +--+--+  +
+|  |  |     |   I |F    |
++  +  +  +--+--+  +--+--+
+|  |     |        |     |
++  +--+--+  +--+  +  +  +
+|  |F     I |     |  |  |
++  +--+--+--+  +--+  +  +
+|I    |     |      F |  |
++  +  +  +  +--+--+--+  +
+|F |     |   E  I     F |
++--+--+--+--+--+--+--+--+
+""",
+    "extreme": """
++--+--+--+--+--+--+--+--+
+|F |      S |   I |     |
++  +  +  +--+  +  +  +  +
+|   I |     |  |   I |F |
++--+--+--+  +  +--+  +--+
+|   I |F |  |   F |     |
++  +  +  +  +--+--+--+  +
+|  |  |  |I       |     |
++  +  +  +--+--+  +  +--+
+|  |     |F |     |     |
++  +--+--+  +  +--+--+  +
+|F        I  E        F |
++--+--+--+--+--+--+--+--+
+""",
+}
+
+
+def parse(name, art):
+    lines = art.strip("\n").split("\n")
+    height = (len(lines) - 1) // 2
+    width = (len(lines[0]) - 1) // 3
+    if len(lines) != 2 * height + 1 or any(len(line) != 3 * width + 1 for line in lines):
+        sys.exit(f"{name}: ragged maze drawing")
+
+    start = end = None
+    flowers = 0
+    cells = []
+    for r in range(height):
+        top, mid, bottom = lines[2 * r], lines[2 * r + 1], lines[2 * r + 2]
+        for c in range(width):
+            x = 3 * c
+            tile = mid[x + 1]
+            if tile not in FLOOR:
+                sys.exit(f"{name}: unknown tile {tile!r} at row {r}, col {c}")
+            if tile == "S":
+                start = (c, r)
+            elif tile == "E":
+                end = (c, r)
+            elif tile == "F":
+                flowers += 1
+
+            walls = 0
+            if mid[x] == " ":
+                walls |= OPEN_LEFT
+            if mid[x + 3] == " ":
+                walls |= OPEN_RIGHT
+            if top[x + 1] == " ":
+                walls |= OPEN_ABOVE
+            if bottom[x + 1] == " ":
+                walls |= OPEN_BELOW
+            cells.append(walls | (FLOOR[tile] << 4))
+
+    if start is None or end is None:
+        sys.exit(f"{name}: needs an S and an E tile")
+
+    header = MAGIC + bytes([VERSION, width, height, start[0], start[1], end[0], end[1], flowers])
+    return header + bytes(cells)
+
+
+def main():
+    bin_dir = None
+    if len(sys.argv) == 3 and sys.argv[1] == "--bin":
+        bin_dir = Path(sys.argv[2])
+        bin_dir.mkdir(parents=True, exist_ok=True)
+
+    lines = []
+    lines.append("#ifndef MAZE_LEVELS_H")
+    lines.append("#define MAZE_LEVELS_H")
+    lines.append("")
+    lines.append("// Generated by tools/make_maze_levels.py - do not edit by hand.")
+    lines.append("// Binary maze format, see include/Maze.h.")
+    lines.append("")
+    lines.append("#include <stdint.h>")
+    lines.append("")
+
+    names = []
+    for name, art in LEVELS.items():
+        data = parse(name, art)
+        names.append(name)
+        if bin_dir is not None:
+            (bin_dir / f"{name}.maze").write_bytes(data)
+
+        ident = "MAZE_LEVEL_" + name.upper()
+        lines.append(f"constexpr uint8_t {ident}[{len(data)}] = {{")
+        lines.append("    " + ", ".join(f"0x{b:02X}" for b in data[:10]) + ", // header")
+        width = data[3]
+        for r in range(data[4]):
+            row = data[10 + r * width:10 + (r + 1) * width]
+            lines.append("    " + ", ".join(f"0x{b:02X}" for b in row) + ",")
+        lines.append("};")
+        lines.append("")
+
+    # indexed by MazeLevel
+    lines.append(f"constexpr int NUM_MAZE_LEVELS = {len(names)};")
+    lines.append("constexpr const uint8_t *MAZE_LEVEL_DATA[NUM_MAZE_LEVELS] = {")
+    lines.append("    " + ", ".join("MAZE_LEVEL_" + n.upper() for n in names) + ",")
+    lines.append("};")
+    lines.append("constexpr int MAZE_LEVEL_SIZE[NUM_MAZE_LEVELS] = {")
+    lines.append("    " + ", ".join(f"sizeof(MAZE_LEVEL_{n.upper()})" for n in names) + ",")
+    lines.append("};")
+    lines.append("constexpr const char *MAZE_LEVEL_NAME[NUM_MAZE_LEVELS] = {")
+    lines.append("    " + ", ".join(f'"{n}"' for n in names) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif")
+
+    OUT.write_text("\n".join(lines) + "\n")
+    print(f"wrote {OUT}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,129 @@
+//////////////////////////////////////////////////////////////////////
+// Host-side benchmark and validator for include/MazeGenerator.h
+//
+// Build and run on a PC:
+//   g++ -O2 -std=gnu++11 -Iinclude tools/maze_gen_bench.cpp -o maze_gen_bench
+//   ./maze_gen_bench [count] [width] [height]
+//
+// Generates count mazes from consecutive seeds, checks every one with
+// MazeGenerator::validate(), checks that a seed always gives the same
+// maze, and prints the generation time. Also validates the built-in
+// levels. Exits non-zero if anything fails.
+//////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "MazeGenerator.h"
+#include "MazeLevels.h"
+
+static MazeGenerator generator;
+static MazeGrid grid;
+static MazeGrid again;
+
+// Print a small maze the same way tools/make_maze_levels.py draws them
+void printMaze(const MazeGrid &maze, const MazeHeader &header)
+{
+    for (int y = 0; y < maze.height(); y++)
+    {
+        printf("+");
+        for (int x = 0; x < maze.width(); x++)
+            printf("%s+", maze.canMove(x, y, OPEN_ABOVE) ? "  " : "--");
+        printf("\n|");
+        for (int x = 0; x < maze.width(); x++)
+        {
+            char tile = ' ';
+            if (x == header.startX && y == header.startY)
+                tile = 'S';
+            else if (x == header.endX && y == header.endY)
+                tile = 'E';
+            else if (maze.floor(x, y) == FLOWER)
+                tile = 'F';
+            else if (maze.floor(x, y) == ICE)
+                tile = 'I';
+            printf("%c %c", tile, maze.canMove(x, y, OPEN_RIGHT) ? ' ' : '|');
+        }
+        printf("\n");
+    }
+    printf("+");
+    for (int x = 0; x < maze.width(); x++)
+        printf("--+");
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000;
+    MazeGenParams params;
+    params.width = argc > 2 ? atoi(argv[2]) : MazeGrid::MAX_WIDTH;
+    params.height = argc > 3 ? atoi(argv[3]) : MazeGrid::MAX_HEIGHT;
+    params.flowers = 7;
+    params.ice = 6;
+    params.minDistance = (params.width + params.height) / 2;
+
+    int failures = 0;
+    const char *reason;
+    MazeHeader header;
+
+    // built-in levels
+    for (int i = 0; i < NUM_MAZE_LEVELS; i++)
+    {
+        if (!grid.load(MAZE_LEVEL_DATA[i], MAZE_LEVEL_SIZE[i], &header) || !generator.validate(grid, header, &reason))
+        {
+            printf("level %s: %s\n", MAZE_LEVEL_NAME[i], reason);
+            failures++;
+        }
+    }
+
+    double totalUs = 0;
+    double worstUs = 0;
+    for (int seed = 1; seed <= count; seed++)
+    {
+        generator.setSeed(seed);
+        auto begin = std::chrono::steady_clock::now();
+        bool ok = generator.generate(params, grid, &header);
+        auto end = std::chrono::steady_clock::now();
+
+        double us = std::chrono::duration<double, std::micro>(end - begin).count();
+        totalUs += us;
+        if (us > worstUs)
+            worstUs = us;
+
+        if (!ok || !generator.validate(grid, header, &reason))
+        {
+            printf("seed %d: %s\n", seed, ok ? reason : "generate() failed");
+            failures++;
+            continue;
+        }
+        if (header.flowersToBloom != params.flowers)
+        {
+            printf("seed %d: only %d flowers placed\n", seed, header.flowersToBloom);
+            failures++;
+        }
+
+        // same seed, same maze
+        MazeHeader againHeader;
+        generator.setSeed(seed);
+        generator.generate(params, again, &againHeader);
+        for (int y = 0; y < grid.height(); y++)
+        {
+            for (int x = 0; x < grid.width(); x++)
+            {
+                if (grid.cell(x, y) != again.cell(x, y))
+                {
+                    printf("seed %d: not reproducible at (%d, %d)\n", seed, x, y);
+                    failures++;
+                    y = grid.height();
+                    break;
+                }
+            }
+        }
+    }
+
+    if (params.width <= 16 && params.height <= 16)
+        printMaze(grid, header);
+
+    printf("%d mazes %dx%d: avg %.1f us, worst %.1f us, %d failures\n",
+           count, params.width, params.height, totalUs / count, worstUs, failures);
+    return failures == 0 ? 0 : 1;
+}